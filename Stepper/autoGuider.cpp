@@ -0,0 +1,359 @@
+/*************************************************************
+* Filename:			autoGuider.cpp
+* Purpose:			Measure a guide star in each camera frame and correct the tracking from it
+**************************************************************/
+#include "autoGuider.h"
+#include "eventLoop.h"			//eventLoop::now()
+#include "sidereal.h"			//DEG_TO_RAD
+
+#include <iostream>				//cout, endl
+#include <algorithm>			//std::sort(), std::nth_element()
+#include <math.h>				//sqrt(), sin(), cos()
+
+using std::cout;
+using std::endl;
+
+/************************************************************************
+* Struct: 		windowSums
+* Purpose:		First moments of the pixels above the threshold in a window
+* Data members:	sum				- Sum of (pixel - threshold) over pixels above it
+*				sumX / sumY		- Same, weighted by column and row inside the window
+*************************************************************************/
+typedef struct windowSums
+{
+	int64_t sum;
+	int64_t sumX;
+	int64_t sumY;
+} windowSums;
+
+/**********************************************************************
+* Function:			windowMoments
+* Purpose: 			Thresholded moments of one window, the inner loop of every centroid
+* Precondition:		Pass in the first pixel of the window, the frame width, the window size and the threshold.
+*					The window is at most 2 * GUIDE_WINDOW_HALF + 1 wide so the row sums fit in 32 bits.
+* Postcondition:	Returns the sums. The inner loop has no branches, a clamp and two multiply-adds on
+*					integers, so the compiler vectorizes it for NEON or SSE without hand written intrinsics.
+*					GCC only does so at -O2 with -fvect-cost-model=cheap, which the project sets.
+************************************************************************/
+template <typename Pixel>
+static windowSums windowMoments(const Pixel *first, int stride, int width, int height, int threshold)
+{
+	windowSums sums = { 0, 0, 0 };
+
+	for (int row = 0; row < height; row++)
+	{
+		const Pixel *pixels = first + (size_t)row * stride;
+		int32_t rowSum = 0;
+		int32_t rowX = 0;
+		for (int column = 0; column < width; column++)
+		{
+			int32_t value = (int32_t)pixels[column] - threshold;
+			value = (value > 0) ? value : 0;
+			rowSum += value;
+			rowX += value * column;
+		}
+		sums.sum += rowSum;
+		sums.sumX += rowX;
+		sums.sumY += (int64_t)rowSum * row;
+	}
+
+	return sums;
+}
+
+/**********************************************************************
+* Function:			borderLevel
+* Purpose: 			Sky level and noise from the ring of pixels around a window
+* Precondition:		Pass in the window as in windowMoments(), at least 3 x 3
+* Postcondition:	background is the median of the ring and noise its median absolute deviation scaled to a
+*					standard deviation, so the edge of a star or a hot pixel on the ring barely moves either
+************************************************************************/
+template <typename Pixel>
+static void borderLevel(const Pixel *first, int stride, int width, int height, double &background, double &noise)
+{
+	std::vector<int32_t> ring;
+	ring.reserve(2 * (width + height));
+	for (int column = 0; column < width; column++)
+	{
+		ring.push_back(first[column]);
+		ring.push_back(first[(size_t)(height - 1) * stride + column]);
+	}
+	for (int row = 1; row < height - 1; row++)
+	{
+		ring.push_back(first[(size_t)row * stride]);
+		ring.push_back(first[(size_t)row * stride + width - 1]);
+	}
+
+	size_t middle = ring.size() / 2;
+	std::nth_element(ring.begin(), ring.begin() + middle, ring.end());
+	int32_t median = ring[middle];
+	for (size_t i = 0; i < ring.size(); i++)
+	{
+		ring[i] = (ring[i] > median) ? ring[i] - median : median - ring[i];
+	}
+	std::nth_element(ring.begin(), ring.begin() + middle, ring.end());
+
+	background = median;
+	//A deviation of zero happens on clean synthetic or clipped frames, one count keeps the threshold above the sky
+	noise = (ring[middle] > 0) ? 1.4826 * ring[middle] : 1.0;
+}
+
+/**********************************************************************
+* Function:			measureWindow
+* Purpose: 			Centroid of the star in one window of a frame
+* Precondition:		Pass in the frame pixels, the frame size and the window, clipped to the frame
+* Postcondition:	Returns the centroid in frame pixels, found is false if nothing was above the threshold
+************************************************************************/
+template <typename Pixel>
+static starCentroid measureWindow(const Pixel *pixels, int stride, int left, int top, int width, int height)
+{
+	starCentroid star = { false, 0, 0, 0, 0, 0, 0 };
+	const Pixel *first = pixels + (size_t)top * stride + left;
+
+	borderLevel(first, stride, width, height, star.background, star.noise);
+	int threshold = (int)(star.background + GUIDE_THRESHOLD_SIGMA * star.noise + 0.5);
+	windowSums sums = windowMoments(first, stride, width, height, threshold);
+	if (sums.sum <= 0)
+	{
+		return star;
+	}
+
+	star.found = true;
+	star.x = left + (double)sums.sumX / sums.sum;
+	star.y = top + (double)sums.sumY / sums.sum;
+	star.flux = (double)sums.sum;
+	star.snr = star.flux / (star.noise * sqrt((double)width * height));
+	return star;
+}
+
+/**********************************************************************
+* Function:			brightestSpot
+* Purpose: 			Finds the pixel with the brightest 3 x 3 neighbourhood in a whole frame
+* Precondition:		Pass in the frame pixels and size, at least 3 x 3
+* Postcondition:	x and y hold the center of the brightest neighbourhood. Summing 3 x 3 keeps a single hot
+*					pixel from winning over a real star.
+************************************************************************/
+template <typename Pixel>
+static void brightestSpot(const Pixel *pixels, int width, int height, int &x, int &y)
+{
+	std::vector<int32_t> columnSums((size_t)width * 3);
+	int64_t best = -1;
+	x = width / 2;
+	y = height / 2;
+
+	for (int row = 0; row < height; row++)
+	{
+		//Three row buffers of horizontal sums, reused in turn
+		int32_t *sums = columnSums.data() + (size_t)(row % 3) * width;
+		const Pixel *line = pixels + (size_t)row * width;
+		for (int column = 1; column < width - 1; column++)
+		{
+			sums[column] = (int32_t)line[column - 1] + line[column] + line[column + 1];
+		}
+		if (row < 2)
+		{
+			continue;
+		}
+
+		const int32_t *a = columnSums.data();
+		const int32_t *b = a + width;
+		const int32_t *c = b + width;
+		for (int column = 1; column < width - 1; column++)
+		{
+			int64_t total = (int64_t)a[column] + b[column] + c[column];
+			if (total > best)
+			{
+				best = total;
+				x = column;
+				y = row - 1;
+			}
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			autoGuider (constructor)
+* Purpose: 			Sets up a guider with nothing locked
+* Precondition:		Pass in the camera geometry and gains
+* Postcondition:	The first frame given to processFrame() picks the guide star
+************************************************************************/
+autoGuider::autoGuider(guideConfig config) : config(config)
+{
+	reset();
+}
+
+/**********************************************************************
+* Function:			reset
+* Purpose: 			Drops the guide star and the learned rate
+* Precondition:		None
+* Postcondition:	The next frame picks a new star. The latency history is kept.
+************************************************************************/
+void autoGuider::reset()
+{
+	locked = false;
+	lockX = 0;
+	lockY = 0;
+	lastX = 0;
+	lastY = 0;
+	altRate = 0;
+	azRate = 0;
+}
+
+/**********************************************************************
+* Function:			findStar
+* Purpose: 			Finds the brightest star anywhere in a frame
+* Precondition:		Pass in the frame
+* Postcondition:	Returns its centroid measured in a window around the brightest spot
+************************************************************************/
+starCentroid autoGuider::findStar(const guideFrame &frame)
+{
+	int x, y;
+	if (frame.format.bytesPerPixel == 2)
+	{
+		brightestSpot((const uint16_t *)frame.pixels, frame.format.width, frame.format.height, x, y);
+	}
+	else
+	{
+		brightestSpot(frame.pixels, frame.format.width, frame.format.height, x, y);
+	}
+
+	return measureStar(frame, x, y, GUIDE_WINDOW_HALF);
+}
+
+/**********************************************************************
+* Function:			measureStar
+* Purpose: 			Centroid of a star near a known position
+* Precondition:		Pass in the frame, where the star should be and half the window size, no more than
+*					GUIDE_WINDOW_HALF
+* Postcondition:	Returns the centroid. The window is measured once where the star should be and again
+*					centered on that first result, which takes out most of the pull toward the window center
+*					that noise above the threshold causes.
+************************************************************************/
+starCentroid autoGuider::measureStar(const guideFrame &frame, double x, double y, int halfWindow)
+{
+	starCentroid star = { false, 0, 0, 0, 0, 0, 0 };
+	int width = frame.format.width;
+	int height = frame.format.height;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int left = (int)lround(x) - halfWindow;
+		int top = (int)lround(y) - halfWindow;
+		int right = left + 2 * halfWindow + 1;
+		int bottom = top + 2 * halfWindow + 1;
+		left = (left < 0) ? 0 : left;
+		top = (top < 0) ? 0 : top;
+		right = (right > width) ? width : right;
+		bottom = (bottom > height) ? height : bottom;
+		if (right - left < 3 || bottom - top < 3)
+		{
+			star.found = false;
+			return star;
+		}
+
+		if (frame.format.bytesPerPixel == 2)
+		{
+			star = measureWindow((const uint16_t *)frame.pixels, width, left, top, right - left, bottom - top);
+		}
+		else
+		{
+			star = measureWindow(frame.pixels, width, left, top, right - left, bottom - top);
+		}
+		if (!star.found)
+		{
+			return star;
+		}
+		x = star.x;
+		y = star.y;
+	}
+
+	return star;
+}
+
+/**********************************************************************
+* Function:			processFrame
+* Purpose: 			Measures the guide star in one frame and corrects the mount
+* Precondition:		Pass in the frame and the mount, or nullptr to only measure
+* Postcondition:	The first frame with a bright enough star locks on it. Later frames send the mount an offset
+*					of aggressiveness times the error on each axis where it is over minMoveArcsec, and add
+*					rateGain times the drift the error implies to the rate. Frames where the star is lost
+*					change nothing, the mount keeps the last rate.
+************************************************************************/
+guideResult autoGuider::processFrame(const guideFrame &frame, coordinate *mount)
+{
+	guideResult result = {};
+
+	if (!locked)
+	{
+		result.star = findStar(frame);
+		if (result.star.found && result.star.snr >= GUIDE_MIN_SNR)
+		{
+			locked = true;
+			lockX = lastX = result.star.x;
+			lockY = lastY = result.star.y;
+		}
+	}
+	else
+	{
+		result.star = measureStar(frame, lastX, lastY, GUIDE_WINDOW_HALF);
+		if (result.star.found && result.star.snr >= GUIDE_MIN_SNR)
+		{
+			lastX = result.star.x;
+			lastY = result.star.y;
+
+			//Camera pixels to sky, the az axis is along angleDeg and alt a quarter turn from it
+			double dx = result.star.x - lockX;
+			double dy = (config.flipped) ? lockY - result.star.y : result.star.y - lockY;
+			double angle = config.angleDeg * DEG_TO_RAD;
+			result.azArcsec = (dx * cos(angle) + dy * sin(angle)) * config.arcsecPerPixel;
+			result.altArcsec = (dy * cos(angle) - dx * sin(angle)) * config.arcsecPerPixel;
+
+			if (fabs(result.altArcsec) >= config.minMoveArcsec)
+			{
+				result.altMoveArcsec = config.aggressiveness * result.altArcsec;
+			}
+			if (fabs(result.azArcsec) >= config.minMoveArcsec)
+			{
+				result.azMoveArcsec = config.aggressiveness * result.azArcsec;
+			}
+			altRate += config.rateGain * result.altArcsec / config.frameSeconds;
+			azRate += config.rateGain * result.azArcsec / config.frameSeconds;
+			result.altRateArcsec = altRate;
+			result.azRateArcsec = azRate;
+
+			if (mount != nullptr)
+			{
+				mount->guide(result.altMoveArcsec, result.azMoveArcsec, altRate, azRate);
+			}
+		}
+	}
+
+	result.latencySeconds = (eventLoop::now() - frame.arrivalNanos) / 1e9;
+	latencies.push_back(result.latencySeconds);
+	return result;
+}
+
+/**********************************************************************
+* Function:			printLatency
+* Purpose: 			Prints how long frames took from arrival to correction
+* Precondition:		None
+* Postcondition:	Prints the frame count, mean, 99th percentile and worst latency
+************************************************************************/
+void autoGuider::printLatency()
+{
+	if (latencies.empty())
+	{
+		cout << "No frames guided" << endl;
+		return;
+	}
+
+	std::vector<double> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0;
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		total += sorted[i];
+	}
+
+	cout << "Latency over " << sorted.size() << " frames: mean " << total / sorted.size() * 1e6 << " us, p99 "
+		<< sorted[(sorted.size() - 1) * 99 / 100] * 1e6 << " us, worst " << sorted.back() * 1e6 << " us" << endl;
+}
@@ -0,0 +1,149 @@
+/*************************************************************
+* Filename:			autoGuider.h
+* Purpose:			Measure a guide star in each camera frame and correct the tracking from it
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//int64_t, uint64_t
+#include <vector>			//std::vector
+#include "guideCamera.h"	//guideFrame, frameSource
+#include "coordinate.h"		//coordinate::guide()
+
+#define GUIDE_WINDOW_HALF 16				//Star is measured in a 33 x 33 window around its last position
+#define GUIDE_THRESHOLD_SIGMA 3.0			//Pixels this far above the background noise count toward the centroid
+#define GUIDE_MIN_SNR 10.0					//Below this the star is treated as lost
+#define GUIDE_DEFAULT_ARCSEC_PER_PIXEL 2.0
+#define GUIDE_DEFAULT_FRAME_SECONDS 1.0
+#define GUIDE_DEFAULT_AGGRESSIVENESS 0.7	//Fraction of each error taken out at once
+#define GUIDE_DEFAULT_RATE_GAIN 0.05		//Fraction of the drift each error implies that is added to the rate
+#define GUIDE_DEFAULT_MIN_MOVE_ARCSEC 0.1	//Smaller errors are left to the rate, they are mostly seeing
+
+/************************************************************************
+* Struct: 		guideConfig
+* Purpose:		How the guide camera sits on the mount and how hard to correct
+* Data members:	arcsecPerPixel	- Guide camera plate scale
+*				angleDeg		- Angle from the camera's x axis to the way stars move when the mount turns
+*								  toward lower azimuth
+*				flipped			- True if the optics mirror the frame
+*				frameSeconds	- Time between frames, used to turn errors into rates
+*				aggressiveness	- Fraction of each error corrected with an offset
+*				rateGain		- Fraction of the drift each error implies, error / frameSeconds, that is
+*								  added to the drift rate
+*				minMoveArcsec	- Errors below this only adjust the rate
+*************************************************************************/
+typedef struct guideConfig
+{
+	double arcsecPerPixel;
+	double angleDeg;
+	bool flipped;
+	double frameSeconds;
+	double aggressiveness;
+	double rateGain;
+	double minMoveArcsec;
+} guideConfig;
+
+/**********************************************************************
+* Function:			defaultGuideConfig
+* Purpose: 			Guide settings for a small guide scope with the camera square to the axes
+* Precondition:		None
+* Postcondition:	Returns the guideConfig
+************************************************************************/
+inline guideConfig defaultGuideConfig()
+{
+	guideConfig config;
+	config.arcsecPerPixel = GUIDE_DEFAULT_ARCSEC_PER_PIXEL;
+	config.angleDeg = 0;
+	config.flipped = false;
+	config.frameSeconds = GUIDE_DEFAULT_FRAME_SECONDS;
+	config.aggressiveness = GUIDE_DEFAULT_AGGRESSIVENESS;
+	config.rateGain = GUIDE_DEFAULT_RATE_GAIN;
+	config.minMoveArcsec = GUIDE_DEFAULT_MIN_MOVE_ARCSEC;
+	return config;
+}
+
+/************************************************************************
+* Struct: 		starCentroid
+* Purpose:		A measured guide star
+* Data members:	found		- False if nothing stood far enough above the noise
+*				x / y		- Centroid in pixels
+*				flux		- Sum above the threshold
+*				background	- Sky level around the star
+*				noise		- Standard deviation of the sky
+*				snr			- Flux over the noise of the window
+*************************************************************************/
+typedef struct starCentroid
+{
+	bool found;
+	double x;
+	double y;
+	double flux;
+	double background;
+	double noise;
+	double snr;
+} starCentroid;
+
+/************************************************************************
+* Struct: 		guideResult
+* Purpose:		What one frame did
+* Data members:	star			- The measurement
+*				altArcsec / azArcsec	- How far the mount should move to put the star back on the lock position
+*				altMoveArcsec / azMoveArcsec	- Offset sent to the mount
+*				altRateArcsec / azRateArcsec	- Drift rate sent to the mount, arcseconds per second
+*				latencySeconds	- From the frame arriving to the correction reaching the mount
+*************************************************************************/
+typedef struct guideResult
+{
+	starCentroid star;
+	double altArcsec;
+	double azArcsec;
+	double altMoveArcsec;
+	double azMoveArcsec;
+	double altRateArcsec;
+	double azRateArcsec;
+	double latencySeconds;
+} guideResult;
+
+/************************************************************************
+* Class: 		autoGuider
+* Purpose:		Closes the tracking loop on a guide star. The first frame finds the brightest star and locks
+*				its position, every later frame measures it in a small window and sends the mount an offset
+*				for most of the error plus a drift rate that learns whatever the open loop keeps missing.
+* Data members:	config		- Camera geometry and gains
+*				locked		- True once a star has been found
+*				lockX / lockY	- Where the star is held
+*				lastX / lastY	- Where it was last seen, the next window is centered here
+*				altRate / azRate	- Drift rate sent so far, arcseconds per second
+*				latencies	- Seconds from arrival to correction of every frame
+*
+* Methods:		processFrame
+*				reset
+*				isLocked
+*				printLatency
+*				findStar
+*				measureStar
+*************************************************************************/
+class autoGuider
+{
+	public:
+		autoGuider(guideConfig config);
+
+		//Measures the frame and, if mount is not nullptr, corrects it
+		guideResult processFrame(const guideFrame &frame, coordinate *mount);
+		void reset();
+		bool isLocked() { return locked; }
+		void printLatency();
+
+		static starCentroid findStar(const guideFrame &frame);
+		static starCentroid measureStar(const guideFrame &frame, double x, double y, int halfWindow);
+
+	private:
+		guideConfig config;
+		bool locked;
+		double lockX;
+		double lockY;
+		double lastX;
+		double lastY;
+		double altRate;
+		double azRate;
+		std::vector<double> latencies;
+};
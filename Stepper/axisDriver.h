@@ -0,0 +1,187 @@
+/*************************************************************
+* Filename:			axisDriver.h
+* Purpose:			Pulse one stepper driver, taking up backlash and switching microstep modes
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//int64_t
+#include "axisKinematics.h"	//Drivetrain of each axis
+#include "mountConfig.h"	//axisPins, NO_PIN
+#include "gpioDriver.h"		//Real or software gpio pins
+#include "stepScheduler.h"	//Absolute pulse deadlines
+
+//A slew only switches to coarse mode with at least this many coarse pulses left, tracking stays fine
+#define COARSE_MIN_PULSES 16
+
+/************************************************************************
+* Class: 		axisDriver
+* Purpose:		Drives one axis for axisPosition. Every call moves the output by a whole number of fine
+*				microsteps and returns it, so the position counter stays exact whatever mode was used.
+*				Reversals first pulse the slack out of the gears without moving the output. Coarse mode is
+*				only entered on a coarse step boundary of the driver, so its phase never slips.
+* Data members:	gpio			- Driver used to reach the pins
+*				scheduler		- Times every edge, shared with the other axis of the mount
+*				pins			- Pins and backlash of this axis
+*				hasModePins		- True if at least one microstep mode pin is wired
+*				coarse			- True while the driver is in coarse mode
+*				direction		- Direction of the last move, 1, -1 or 0 before the first one
+*				motorSteps		- Fine microsteps the motor has turned, backlash pulses included. This is the
+*								  motor shaft phase that PEC tables are recorded against.
+*
+* Methods:		step
+*				takeUpBacklash
+*				setCoarse
+*				isCoarse
+*				getMotorSteps
+*				setMotorSteps
+*				estimateSeconds
+*************************************************************************/
+template <class Kinematics>
+class axisDriver
+{
+	public:
+		/**********************************************************************
+		* Function:			axisDriver (constructor)
+		* Purpose: 			Sets up the mode pins of one driver
+		* Precondition:		Pass in the gpio driver, the axis pins and the mount's scheduler, both must outlive this
+		* Postcondition:	Mode pins are outputs set to fine mode, the direction is not known yet
+		************************************************************************/
+		axisDriver(gpioDriver *gpio, axisPins pins, stepScheduler *scheduler) : gpio(gpio), scheduler(scheduler), pins(pins)
+		{
+			hasModePins = false;
+			for (int i = 0; i < 3; i++)
+			{
+				if (pins.mode[i] != NO_PIN)
+				{
+					hasModePins = true;
+					gpio->setMode((unsigned)pins.mode[i], PI_OUTPUT);
+				}
+			}
+
+			coarse = true;
+			setCoarse(false);
+			direction = 0;
+			motorSteps = 0;
+		}
+
+		/**********************************************************************
+		* Function:			step
+		* Purpose: 			Makes one pulse toward a target
+		* Precondition:		Pass in signed fine microsteps still to go, not 0
+		* Postcondition:	Returns the signed fine microsteps the output moved, 1 or coarseRatio. A coarse step
+		*					is never larger than remaining, so the target is never overshot.
+		************************************************************************/
+		int64_t step(int64_t remaining)
+		{
+			int sign = (remaining > 0) ? 1 : -1;
+			if (sign != direction)
+			{
+				takeUpBacklash(sign);
+			}
+
+			int64_t distance = (remaining > 0) ? remaining : -remaining;
+			setCoarse(hasModePins && distance >= Kinematics::coarseRatio * COARSE_MIN_PULSES &&
+				motorSteps % Kinematics::coarseRatio == 0);
+
+			int64_t moved = coarse ? Kinematics::coarseRatio : 1;
+			pulse(coarse ? Kinematics::coarsePulseDelayMicros : Kinematics::pulseDelayMicros);
+			motorSteps += sign * moved;
+
+			return sign * moved;
+		}
+
+		/**********************************************************************
+		* Function:			takeUpBacklash
+		* Purpose: 			Turns the motor through the gear slack when the axis reverses
+		* Precondition:		Pass in the new direction, 1 or -1
+		* Postcondition:	The direction pin is set and the gears are loaded the new way. Nothing is taken up on
+		*					the first move, the slack is unknown until the axis has moved once.
+		************************************************************************/
+		void takeUpBacklash(int sign)
+		{
+			gpio->write(pins.dir, (sign > 0) ? Kinematics::forwardLevel : Kinematics::backwardLevel);
+
+			if (direction != 0)
+			{
+				setCoarse(false);
+				for (int64_t i = 0; i < pins.backlashSteps; i++)
+				{
+					pulse(Kinematics::pulseDelayMicros);
+					motorSteps += sign;
+				}
+			}
+
+			direction = sign;
+		}
+
+		/**********************************************************************
+		* Function:			setCoarse
+		* Purpose: 			Switches the driver between fine and coarse microstepping
+		* Precondition:		Only switch to coarse on a coarse step boundary
+		* Postcondition:	Mode pins are only written on a change, then the driver is given one pulse to settle
+		************************************************************************/
+		void setCoarse(bool coarse)
+		{
+			if (coarse == this->coarse)
+			{
+				return;
+			}
+			this->coarse = coarse;
+
+			if (!hasModePins)
+			{
+				return;
+			}
+
+			unsigned bits = coarse ? pins.coarseModeBits : pins.fineModeBits;
+			for (int i = 0; i < 3; i++)
+			{
+				if (pins.mode[i] != NO_PIN)
+				{
+					gpio->write((unsigned)pins.mode[i], ((bits >> i) & 1) ? PI_HIGH : PI_LOW);
+				}
+			}
+			scheduler->edge(Kinematics::pulseDelayMicros);
+		}
+
+		bool isCoarse() { return coarse; }
+		int64_t getMotorSteps() { return motorSteps; }
+		void setMotorSteps(int64_t steps) { motorSteps = steps; }
+
+		/**********************************************************************
+		* Function:			estimateSeconds
+		* Purpose: 			Estimates how long step() takes to cover a distance
+		* Precondition:		Pass in fine microsteps, either sign
+		* Postcondition:	Returns seconds, coarse pulses for the bulk of a long slew and fine for the rest
+		************************************************************************/
+		double estimateSeconds(int64_t steps)
+		{
+			int64_t distance = (steps > 0) ? steps : -steps;
+			int64_t coarsePulses = 0;
+			if (hasModePins && distance >= Kinematics::coarseRatio * COARSE_MIN_PULSES)
+			{
+				coarsePulses = (distance - Kinematics::coarseRatio * COARSE_MIN_PULSES) / Kinematics::coarseRatio + 1;
+			}
+			int64_t finePulses = distance - coarsePulses * Kinematics::coarseRatio;
+
+			return (double)coarsePulses * Kinematics::coarseSecondsPerStep + (double)finePulses * Kinematics::secondsPerStep;
+		}
+
+	private:
+		//One high and one low half of delayMicros each, timed from the end of the last pulse
+		void pulse(unsigned delayMicros)
+		{
+			gpio->write(pins.pul, PI_HIGH);
+			scheduler->edge(delayMicros);
+			gpio->write(pins.pul, PI_LOW);
+			scheduler->edge(delayMicros);
+		}
+
+		gpioDriver *gpio;
+		stepScheduler *scheduler;
+		axisPins pins;
+		bool hasModePins;
+		bool coarse;
+		int direction;
+		int64_t motorSteps;
+};
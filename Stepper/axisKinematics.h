@@ -0,0 +1,143 @@
+/*************************************************************
+* Filename:			axisKinematics.h
+* Purpose:			Compile-time drivetrain of one axis, step / angle conversion with folded constants
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t
+#include <math.h>		//floor(), llround()
+#include <array>		//std::array
+#include <pigpio.h>		//PI_LOW, PI_HIGH
+
+/**********************************************************************
+* Function:			makeWholeDegreeSteps
+* Purpose: 			Builds the table of microsteps at each whole degree at compile time
+* Precondition:		StepsPerRev is the number of microsteps in one output revolution
+* Postcondition:	Returns floor(degree * StepsPerRev / 360) for 0 - 359 degrees
+************************************************************************/
+template <int64_t StepsPerRev>
+constexpr std::array<int64_t, 360> makeWholeDegreeSteps()
+{
+	std::array<int64_t, 360> table = {};
+	for (int i = 0; i < 360; i++)
+	{
+		table[i] = (int64_t)i * StepsPerRev / 360;
+	}
+	return table;
+}
+
+/**********************************************************************
+* Function:			makeWholeDegreeRemainder
+* Purpose: 			Builds the table of partial microsteps dropped by makeWholeDegreeSteps
+* Precondition:		StepsPerRev is the number of microsteps in one output revolution
+* Postcondition:	Returns the fraction of a microstep (0 - 1) left at each whole degree
+************************************************************************/
+template <int64_t StepsPerRev>
+constexpr std::array<double, 360> makeWholeDegreeRemainder()
+{
+	std::array<double, 360> table = {};
+	for (int i = 0; i < 360; i++)
+	{
+		table[i] = (double)(((int64_t)i * StepsPerRev) % 360) / 360.0;
+	}
+	return table;
+}
+
+/************************************************************************
+* Class: 		axisKinematics
+* Purpose:		Describes one axis drivetrain as template parameters so every conversion is built from
+*				constants. Each physical axis gets its own instantiation.
+* Parameters:	Microsteps		- Driver microsteps per motor revolution
+*				GearNum			- Gear ratio numerator, Ex: 100:1 * 2.5:1 = 500 / 2
+*				GearDen			- Gear ratio denominator
+*				Polarity		- 1 if a low DIR pin turns the axis forward, -1 if high does
+*				MaxStepRateHz	- Fastest the driver and motor can be pulsed
+*				CoarseRatio		- Fine microsteps per pulse in the driver's coarse mode, used for fast slews
+*
+* Methods:		degToSteps
+*				stepsToDeg
+*************************************************************************/
+template <int64_t Microsteps, int64_t GearNum, int64_t GearDen, int Polarity, unsigned MaxStepRateHz, int64_t CoarseRatio = 8>
+class axisKinematics
+{
+	static_assert(Microsteps > 0 && GearNum > 0 && GearDen > 0, "Drivetrain values must be positive");
+	static_assert((Microsteps * GearNum) % GearDen == 0, "One output revolution must be a whole number of microsteps");
+	static_assert(Polarity == 1 || Polarity == -1, "Polarity must be 1 or -1");
+	static_assert(MaxStepRateHz > 0, "Step rate must be positive");
+	static_assert(CoarseRatio > 0 && Microsteps % CoarseRatio == 0, "Coarse mode must be a whole number of fine microsteps");
+
+	public:
+		static constexpr int64_t microsteps = Microsteps;
+		static constexpr int64_t stepsPerRev = Microsteps * GearNum / GearDen;
+		static constexpr double stepsPerDeg = (double)stepsPerRev / 360.0;
+		static constexpr double degPerStep = 360.0 / (double)stepsPerRev;
+
+		//Direction pin levels
+		static constexpr unsigned forwardLevel = (Polarity > 0) ? PI_LOW : PI_HIGH;
+		static constexpr unsigned backwardLevel = (Polarity > 0) ? PI_HIGH : PI_LOW;
+
+		//Rate limits, a step is a high and a low half of pulseDelayMicros each
+		static constexpr unsigned maxStepRate = MaxStepRateHz;
+		static constexpr unsigned pulseDelayMicros = 1000000 / (2 * MaxStepRateHz);
+		static constexpr double secondsPerStep = 1.0 / (double)MaxStepRateHz;
+
+		//Coarse microstepping, one coarse pulse moves coarseRatio fine microsteps. Coarse pulses are sent at half
+		//the fine rate to keep the motor inside its torque curve, a slew is still coarseRatio / 2 times faster.
+		static constexpr int64_t coarseRatio = CoarseRatio;
+		static constexpr unsigned coarsePulseDelayMicros = (CoarseRatio > 1) ? 2 * pulseDelayMicros : pulseDelayMicros;
+		static constexpr double coarseSecondsPerStep = 2.0 * coarsePulseDelayMicros / 1000000.0;
+
+		/**********************************************************************
+		* Function:			degToSteps
+		* Purpose: 			Converts an angle to the nearest whole microstep
+		* Precondition:		Pass in the angle in degrees
+		* Postcondition:	Returns signed microsteps. Whole turns and whole degrees come from exact integer
+		*					tables, only the part below one degree is rounded in floating point.
+		************************************************************************/
+		static int64_t degToSteps(double deg)
+		{
+			double turns = floor(deg / 360.0);
+			double rest = deg - turns * 360.0;
+			int whole = (int)rest;
+			if (whole > 359)
+			{
+				whole = 359;
+			}
+
+			return (int64_t)turns * stepsPerRev + wholeDegreeSteps[whole] +
+				llround(wholeDegreeRemainder[whole] + (rest - whole) * stepsPerDeg);
+		}
+
+		/**********************************************************************
+		* Function:			stepsToDeg
+		* Purpose: 			Converts microsteps to an angle
+		* Precondition:		Pass in signed microsteps
+		* Postcondition:	Returns degrees, whole turns are split off first so large counts keep their precision
+		************************************************************************/
+		static double stepsToDeg(int64_t steps)
+		{
+			int64_t turns = steps / stepsPerRev;
+			int64_t rest = steps % stepsPerRev;
+			if (rest < 0)
+			{
+				rest += stepsPerRev;
+				turns--;
+			}
+
+			return (double)turns * 360.0 + (double)rest * degPerStep;
+		}
+
+	private:
+		//Microsteps at each whole degree, rounded down, and the fraction of a step left over
+		static constexpr std::array<int64_t, 360> wholeDegreeSteps = makeWholeDegreeSteps<Microsteps * GearNum / GearDen>();
+		static constexpr std::array<double, 360> wholeDegreeRemainder = makeWholeDegreeRemainder<Microsteps * GearNum / GearDen>();
+};
+
+//Drivetrain of each axis. Build with -DMOUNT_HARDWARE_HEADER="\"myMount.h\"" to use a header that typedefs
+//altKinematics and azKinematics for other hardware instead of editing this one.
+#ifdef MOUNT_HARDWARE_HEADER
+#include MOUNT_HARDWARE_HEADER
+#else
+typedef axisKinematics<1600, 500, 2, 1, 5000, 8> altKinematics;		//1600 microsteps, 100:1 gearbox * 2.5:1, 100us half pulses, full steps when coarse
+typedef axisKinematics<1600, 500, 2, 1, 5000, 8> azKinematics;
+#endif
@@ -0,0 +1,47 @@
+/*************************************************************
+* Filename:			axisPosition.h
+* Purpose:			Track the position of one mount axis as an exact count of microsteps
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//int64_t
+#include "axisKinematics.h"	//Drivetrain of each axis
+
+/************************************************************************
+* Class: 		axisPosition
+* Purpose:		Counts signed microsteps for one axis so the position never drifts. Angles are only used at
+*				the boundaries, converted with the axis' compile-time Kinematics.
+* Data members:	steps	- Signed microsteps from 0 degrees
+*
+* Methods:		stepForward
+*				stepBackward
+*				move
+*				getSteps
+*				setSteps
+*				getDeg
+*				setDeg
+*				degToSteps
+*				stepsToDeg
+*************************************************************************/
+template <class Kinematics>
+class axisPosition
+{
+	public:
+		axisPosition() { steps = 0; }
+
+		//Hot path - one microstep either way
+		void stepForward() { steps++; }
+		void stepBackward() { steps--; }
+		void move(int64_t microsteps) { steps += microsteps; }
+		int64_t getSteps() { return steps; }
+		void setSteps(int64_t steps) { this->steps = steps; }
+
+		//Boundary conversions
+		double getDeg() { return Kinematics::stepsToDeg(steps); }
+		void setDeg(double deg) { steps = Kinematics::degToSteps(deg); }
+		int64_t degToSteps(double deg) { return Kinematics::degToSteps(deg); }
+		double stepsToDeg(int64_t steps) { return Kinematics::stepsToDeg(steps); }
+
+	private:
+		int64_t steps;
+};
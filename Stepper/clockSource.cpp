@@ -0,0 +1,75 @@
+/*************************************************************
+* Filename:			clockSource.cpp
+* Purpose:			Where the time of day comes from, the system clock or a virtual one for simulations
+**************************************************************/
+#include "clockSource.h"
+
+#include <time.h>		//clock_gettime(), CLOCK_REALTIME
+
+/**********************************************************************
+* Function:			instance
+* Purpose: 			Returns the one system clock
+* Precondition:		None
+* Postcondition:	Returns a pointer that stays valid for the whole program
+************************************************************************/
+systemClock *systemClock::instance()
+{
+	static systemClock clock;
+	return &clock;
+}
+
+/**********************************************************************
+* Function:			unixSeconds
+* Purpose: 			Reads the real time of day
+* Precondition:		None
+* Postcondition:	Returns UTC seconds since 1970 with nanosecond resolution
+************************************************************************/
+double systemClock::unixSeconds()
+{
+	timespec time;
+	clock_gettime(CLOCK_REALTIME, &time);
+	return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**********************************************************************
+* Function:			virtualClock (constructor)
+* Purpose: 			Creates a stopped clock
+* Precondition:		Pass in the UTC seconds since 1970 to start at
+* Postcondition:	The clock reads the start time until set() or advance() is called
+************************************************************************/
+virtualClock::virtualClock(double startUnixSeconds) : seconds(startUnixSeconds)
+{
+}
+
+/**********************************************************************
+* Function:			unixSeconds
+* Purpose: 			Reads the virtual time
+* Precondition:		None
+* Postcondition:	Returns UTC seconds since 1970
+************************************************************************/
+double virtualClock::unixSeconds()
+{
+	return seconds.load(std::memory_order_relaxed);
+}
+
+/**********************************************************************
+* Function:			set
+* Purpose: 			Jumps to a time
+* Precondition:		Pass in UTC seconds since 1970
+* Postcondition:	Every later read returns the new time
+************************************************************************/
+void virtualClock::set(double unixSeconds)
+{
+	seconds.store(unixSeconds, std::memory_order_relaxed);
+}
+
+/**********************************************************************
+* Function:			advance
+* Purpose: 			Moves the time forward
+* Precondition:		Pass in seconds, only one thread should advance the clock
+* Postcondition:	Every later read is that much later
+************************************************************************/
+void virtualClock::advance(double seconds)
+{
+	this->seconds.store(this->seconds.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+}
@@ -0,0 +1,57 @@
+/*************************************************************
+* Filename:			clockSource.h
+* Purpose:			Where the time of day comes from, the system clock or a virtual one for simulations
+**************************************************************/
+#pragma once
+
+#include <atomic>		//std::atomic
+
+/************************************************************************
+* Class: 		clockSource
+* Purpose:		Interface every sidereal time read goes through
+* Data members:	none
+* Methods:		unixSeconds
+*************************************************************************/
+class clockSource
+{
+	public:
+		virtual ~clockSource() {}
+
+		//UTC seconds since 1970, with the fraction of the current second
+		virtual double unixSeconds() = 0;
+};
+
+/************************************************************************
+* Class: 		systemClock
+* Purpose:		The real time of day from CLOCK_REALTIME
+* Data members:	none
+* Methods:		instance
+*************************************************************************/
+class systemClock : public clockSource
+{
+	public:
+		static systemClock *instance();
+		double unixSeconds();
+};
+
+/************************************************************************
+* Class: 		virtualClock
+* Purpose:		A time of day that only moves when told to, so a whole night can be replayed as fast as the
+*				code runs. Reads and advances may come from different threads.
+* Data members:	seconds	- Current UTC seconds since 1970
+*
+* Methods:		set
+*				advance
+*************************************************************************/
+class virtualClock : public clockSource
+{
+	public:
+		virtualClock(double startUnixSeconds);
+
+		double unixSeconds();
+		void set(double unixSeconds);
+		void advance(double seconds);
+
+	private:
+		std::atomic<double> seconds;
+};
@@ -6,6 +6,63 @@
 * Purpose:			Insert description
 **************************************************************/
 #include "coordinate.h"
+#include "fastTrig.h"		//trigSinCos(), trigAtan2()
+
+/**********************************************************************
+* Function:			coordinate (constructor)
+* Purpose: 			Sets up the original telescope on the default pins through pigpio
+* Precondition:		None
+* Postcondition:	Both axes count exact microsteps from 0 degrees
+************************************************************************/
+coordinate::coordinate() : coordinate(defaultMountConfig(), pigpioDriver::instance())
+{
+}
+
+/**********************************************************************
+* Function:			coordinate (constructor override)
+* Purpose: 			Sets up a mount on its own pins
+* Precondition:		Pass in the mount's pins and the gpio driver to use, the driver must outlive the mount
+* Postcondition:	Both axes count exact microsteps from 0 degrees, the pins are set to outputs
+************************************************************************/
+coordinate::coordinate(mountConfig config, gpioDriver *gpio) : config(config), gpio(gpio), scheduler(gpio), stopRequested(false),
+	altDriver(gpio, config.altPins, &scheduler), azDriver(gpio, config.azPins, &scheduler),
+	altPec(config.pecPeriodSteps), azPec(config.pecPeriodSteps)
+{
+	gpio->setMode(config.azPins.ena, PI_OUTPUT);
+	gpio->setMode(config.azPins.dir, PI_OUTPUT);
+	gpio->setMode(config.azPins.pul, PI_OUTPUT);
+	gpio->setMode(config.altPins.ena, PI_OUTPUT);
+	gpio->setMode(config.altPins.dir, PI_OUTPUT);
+	gpio->setMode(config.altPins.pul, PI_OUTPUT);
+
+	//Start at 0
+	gpio->write(config.azPins.dir, PI_LOW);
+	gpio->write(config.azPins.pul, PI_LOW);
+	gpio->write(config.altPins.dir, PI_LOW);
+	gpio->write(config.altPins.pul, PI_LOW);
+
+	currentLatLongDeg.x = 0;
+	currentLatLongDeg.y = 0;
+	currentCelestialPosDeg.x = 0;
+	currentCelestialPosDeg.y = 0;
+	trackPlan = planner.plan(0, 0, 0);
+	trackUntilJulianDate = -1;
+	clearGuide();
+	state = nullptr;
+	calibrated = false;
+	tracking = false;
+	motorsEnabled = true;
+
+	//Tables recorded in an earlier run are only played back once attachStateFile() restores the motor phase
+	//they were recorded against, the motor step counters start at 0 until then
+	pec = PEC_OFF;
+	pecPhaseKnown = false;
+	if (config.altPecPath != nullptr && config.azPecPath != nullptr)
+	{
+		altPec.load(config.altPecPath);
+		azPec.load(config.azPecPath);
+	}
+}
 
 /**********************************************************************
 * Function:			equatorialToLocal
@@ -15,6 +72,17 @@
 * Postcondition:	An instance of twoAxisDeg is returned containing the Alt/Az coordinates of the target in degrees.
 ************************************************************************/
 twoAxisDeg coordinate::equatorialToLocal(double Ra, double Dec, twoAxisDeg myPositionDeg)
+{
+	return equatorialToLocal(Ra, Dec, myPositionDeg, sidereal::getJulianDate());
+}
+
+/**********************************************************************
+* Function:			equatorialToLocal (override)
+* Purpose: 			Converts Equatorial / Celestial coordinates (RA, Dec) to Local (Alt, Az) coordinates at a given time.
+* Precondition:		Same as equatorialToLocal, plus the julian date the position is wanted for
+* Postcondition:	An instance of twoAxisDeg is returned containing the Alt/Az coordinates of the target in degrees.
+************************************************************************/
+twoAxisDeg coordinate::equatorialToLocal(double Ra, double Dec, twoAxisDeg myPositionDeg, double julianDate)
 {
 	//Create struct for Alt/Az and Lat/Long
 	twoAxisDeg AltAz;
@@ -30,7 +98,7 @@ twoAxisDeg coordinate::equatorialToLocal(double Ra, double Dec, twoAxisDeg myPos
 	RaDec.y = Dec * (M_PI / 180.0);
 
 	//Get Local Mean Sidereal Time using getGMSTinRads and inputing longitude through myPosition (note west needs negative number, east needs positive)
-	double LMST = sidereal::getLMST(sidereal::getGMSTinRads(), myPositionDeg.y);
+	double LMST = sidereal::getLMST(sidereal::getGMSTinRads(julianDate), myPositionDeg.y);
 
 	//Convert and store LMST decimal degrees to Radians
 	LMST = LMST*(M_PI / 180.0);
@@ -48,10 +116,22 @@ twoAxisDeg coordinate::equatorialToLocal(double Ra, double Dec, twoAxisDeg myPos
 		hourAngle -= 2 * M_PI;
 	}
 
+	double sinHourAngle, cosHourAngle, sinLat, cosLat, sinDec, cosDec;
+	trigSinCos(hourAngle, sinHourAngle, cosHourAngle);
+	trigSinCos(latLong.x, sinLat, cosLat);
+	trigSinCos(RaDec.y, sinDec, cosDec);
+
+	//Target direction projected on the horizon, cos(Alt) long, and its height above it. Multiplying through by
+	//cos(Dec) instead of dividing by it leaves out tan(Dec), and the altitude from atan2 stays exact at the
+	//zenith where asin() loses half its digits.
+	double horizonY = sinHourAngle * cosDec;
+	double horizonX = cosHourAngle * sinLat * cosDec - sinDec * cosLat;
+	double height = sinLat * sinDec + cosLat * cosDec * cosHourAngle;
+
 	//Set Azimuth
-	AltAz.y = (atan2(sin(hourAngle), cos(hourAngle) * sin(latLong.x) - tan(RaDec.y) * cos(latLong.x)));
+	AltAz.y = trigAtan2(horizonY, horizonX);
 	//Set Altitude
-	AltAz.x = (asin(sin(latLong.x) * sin(RaDec.y) + cos(latLong.x) * cos(RaDec.y) * cos(hourAngle)));
+	AltAz.x = trigAtan2(height, sqrt(horizonY * horizonY + horizonX * horizonX));
 
 	
 	AltAz.y -= M_PI;
@@ -117,6 +197,17 @@ void coordinate::calibrate(twoAxisDeg latLong)
 	RaDecInput.x = sidereal::hmsToDeg(1, 23, 14.6);
 	RaDecInput.y = sidereal::dmsToDeg(50, 14, 23.3);
 
+	calibrate(latLong, RaDecInput);
+}
+
+/**********************************************************************
+* Function:			calibrate (override)
+* Purpose: 			Aligns coordinates to a known pointing, such as a plate solve of the finder camera
+* Precondition:		Telescope must be level, pass in the site and the RA / Dec in degrees it is pointed at
+* Postcondition:	The Coordinate class will know where the telescope is pointed, and can now point to another target
+************************************************************************/
+void coordinate::calibrate(twoAxisDeg latLong, twoAxisDeg RaDecInput)
+{
 	//Store the RA/Dec coordinates
 	/*currentCelestialPosDeg.x = sidereal::hmsToDeg(RA);
 	currentCelestialPosDeg.y = sidereal::dmsToDeg(Dec);*/
@@ -126,12 +217,410 @@ void coordinate::calibrate(twoAxisDeg latLong)
 	//currentLatLongDeg.y = sidereal::dmsToDeg(latLong.y);
 	currentLatLongDeg.x = latLong.x;
 	currentLatLongDeg.y = latLong.y;
-	//Store the Alt/Az coordinates
-	currentAltAz = equatorialToLocal(RaDecInput.x, RaDecInput.y, latLong);
+	//Store the Alt/Az coordinates as exact microsteps
+	twoAxisDeg calibratedAltAz = equatorialToLocal(RaDecInput.x, RaDecInput.y, latLong);
+	altAxis.setDeg(calibratedAltAz.x);
+	azAxis.setDeg(calibratedAltAz.y);
+
+	//Cables are assumed to hang freely at the calibration position
+	planner.setCableNeutral(azAxis.getDeg());
+
+	calibrated = true;
+	tracking = false;
+	commitState();
+	if (state != nullptr)
+	{
+		state->flush();
+	}
 
 	int x = 0;
 }
 
+/**********************************************************************
+* Function:			setSlewLimits
+* Purpose: 			Sets the cable-wrap and altitude limits used by gotoCoordsDeg
+* Precondition:		cableWrapDeg should be at least 180 so every azimuth can be reached
+* Postcondition:	Following slews respect the new limits
+************************************************************************/
+void coordinate::setSlewLimits(slewLimits limits)
+{
+	planner.setLimits(limits);
+	commitState();
+}
+
+/**********************************************************************
+* Function:			getSlewLimits
+* Purpose: 			Returns the cable-wrap and altitude limits used by gotoCoordsDeg
+* Precondition:		None
+* Postcondition:	Returns a copy of the slewLimits struct
+************************************************************************/
+slewLimits coordinate::getSlewLimits()
+{
+	return planner.getLimits();
+}
+
+/**********************************************************************
+* Function:			getLatLongDeg
+* Purpose: 			Returns the observer location set by calibrate()
+* Precondition:		None
+* Postcondition:	Returns twoAxisDeg with x = Latitude, y = Longitude in degrees
+************************************************************************/
+twoAxisDeg coordinate::getLatLongDeg()
+{
+	return currentLatLongDeg;
+}
+
+/**********************************************************************
+* Function:			estimateSlewSeconds
+* Purpose: 			Model of how long gotoCoordsDeg takes to reach a planned position
+* Precondition:		Pass in the starting Alt / unwrapped Az in degrees and a plan from planSlew()
+* Postcondition:	Returns seconds. The loop steps azimuth then altitude, each pulse taking one period of that
+*					axis' step rate in the mode the driver will use, so the time is the sum of both axis moves.
+************************************************************************/
+double coordinate::estimateSlewSeconds(twoAxisDeg fromAltAz, slewPlan target)
+{
+	int64_t altSteps = altAxis.degToSteps(target.altDeg) - altAxis.degToSteps(fromAltAz.x);
+	int64_t azSteps = azAxis.degToSteps(target.azDeg) - azAxis.degToSteps(fromAltAz.y);
+
+	return altDriver.estimateSeconds(altSteps) + azDriver.estimateSeconds(azSteps);
+}
+
+/**********************************************************************
+* Function:			planSlew
+* Purpose: 			Plans a slew with the mount's planner without moving
+* Precondition:		Pass in the starting Alt / unwrapped Az and the target Alt / Az in degrees
+* Postcondition:	Returns the slewPlan gotoCoordsDeg would use from that position
+************************************************************************/
+slewPlan coordinate::planSlew(twoAxisDeg fromAltAz, twoAxisDeg targetAltAz)
+{
+	return planner.plan(fromAltAz.y, targetAltAz.x, targetAltAz.y);
+}
+
+/**********************************************************************
+* Function:			getCurrentAltAz
+* Purpose: 			Returns where the telescope is pointed
+* Precondition:		None
+* Postcondition:	Returns twoAxisDeg with x = Alt, y = unwrapped mount Az, converted from the step counters
+************************************************************************/
+twoAxisDeg coordinate::getCurrentAltAz()
+{
+	twoAxisDeg altAz;
+	altAz.x = altAxis.getDeg();
+	altAz.y = azAxis.getDeg();
+
+	return altAz;
+}
+
+/**********************************************************************
+* Function:			attachStateFile
+* Purpose: 			Persists the mount state in a file and resumes from it if possible
+* Precondition:		Pass in a stateFile that has been opened
+* Postcondition:	Returns true if a calibrated state saved while the motors were held was loaded, the telescope
+*					then knows where it points without manualControl() or calibrate(). Every later move is saved.
+*					PEC tables loaded by the constructor start playing back only then, with the motor phase
+*					restored, out of phase they would add to the gear error instead of cancelling it.
+************************************************************************/
+bool coordinate::attachStateFile(stateFile *file)
+{
+	mountState saved;
+
+	state = file;
+	if (state == nullptr || !state->load(saved) || !saved.calibrated || !saved.motorsEnabled)
+	{
+		if (altPec.isValid() && azPec.isValid())
+		{
+			cout << "PEC tables loaded but the motor phase was not saved, PEC stays off until it is recorded again" << endl;
+		}
+		return false;
+	}
+
+	currentLatLongDeg.x = saved.latDeg;
+	currentLatLongDeg.y = saved.longDeg;
+	altAxis.setSteps(saved.altSteps);
+	azAxis.setSteps(saved.azSteps);
+	altDriver.setMotorSteps(saved.altMotorSteps);
+	azDriver.setMotorSteps(saved.azMotorSteps);
+	planner.setCableNeutral(saved.cableNeutralAzDeg);
+	planner.setLimits(saved.limits);
+	currentCelestialPosDeg.x = saved.targetRaDeg;
+	currentCelestialPosDeg.y = saved.targetDecDeg;
+	calibrated = true;
+	tracking = (saved.tracking != 0);
+
+	pecPhaseKnown = true;
+	if (altPec.isValid() && azPec.isValid())
+	{
+		pec = PEC_PLAYBACK;
+	}
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			isTracking
+* Purpose: 			Checks if a target was being tracked, used to resume after a restart
+* Precondition:		None
+* Postcondition:	Returns true if gotoCoordsDeg was running on the target from getTargetRaDec()
+************************************************************************/
+bool coordinate::isTracking()
+{
+	return tracking;
+}
+
+/**********************************************************************
+* Function:			getTargetRaDec
+* Purpose: 			Returns the last target passed to gotoCoordsDeg
+* Precondition:		None
+* Postcondition:	Returns twoAxisDeg with x = RA, y = Dec in degrees
+************************************************************************/
+twoAxisDeg coordinate::getTargetRaDec()
+{
+	return currentCelestialPosDeg;
+}
+
+/**********************************************************************
+* Function:			setMotorsEnabled
+* Purpose: 			Holds or releases both stepper drivers
+* Precondition:		GPIO must be initialized
+* Postcondition:	Releasing the motors lets the tube move freely, so the saved state is marked as not resumable
+************************************************************************/
+void coordinate::setMotorsEnabled(bool enabled)
+{
+	gpio->write(config.azPins.ena, enabled ? PI_LOW : PI_HIGH);
+	gpio->write(config.altPins.ena, enabled ? PI_LOW : PI_HIGH);
+
+	motorsEnabled = enabled;
+	commitState();
+	if (state != nullptr)
+	{
+		state->flush();
+	}
+}
+
+/**********************************************************************
+* Function:			requestStop
+* Purpose: 			Ends a running gotoCoordsDeg, safe to call from another thread
+* Precondition:		None
+* Postcondition:	gotoCoordsDeg returns after its current step, or as soon as it starts if it has not yet. The
+*					request is used up when tracking ends on it.
+************************************************************************/
+void coordinate::requestStop()
+{
+	stopRequested = true;
+}
+
+/**********************************************************************
+* Function:			clearStop
+* Purpose: 			Drops a stop request that no track used up
+* Precondition:		Call from the thread that starts tracking, before it starts
+* Postcondition:	The next gotoCoordsDeg runs until its stop time or the next requestStop()
+************************************************************************/
+void coordinate::clearStop()
+{
+	stopRequested = false;
+}
+
+/**********************************************************************
+* Function:			getConfig
+* Purpose: 			Returns the pins of this mount
+* Precondition:		None
+* Postcondition:	Returns a copy of the mountConfig
+************************************************************************/
+mountConfig coordinate::getConfig()
+{
+	return config;
+}
+
+/**********************************************************************
+* Function:			getMissedDeadlines
+* Purpose: 			Returns how many pulse edges came late
+* Precondition:		None
+* Postcondition:	Returns the count since the mount was created, safe to call from another thread
+************************************************************************/
+uint64_t coordinate::getMissedDeadlines()
+{
+	return scheduler.getMissed();
+}
+
+/**********************************************************************
+* Function:			setPecMode
+* Purpose: 			Starts or ends PEC recording, or turns playback on or off
+* Precondition:		Record for several whole error periods while tracking, feeding recordPecSample()
+* Postcondition:	Leaving PEC_RECORD builds both tables and saves them to the config paths. Playback only
+*					starts once both tables hold a recording made against the current motor phase, recorded now
+*					or restored with it by attachStateFile(), otherwise PEC is left off.
+************************************************************************/
+void coordinate::setPecMode(pecMode mode)
+{
+	if (pec == PEC_RECORD && mode != PEC_RECORD)
+	{
+		bool altRecorded = altPec.finishRecording();
+		bool azRecorded = azPec.finishRecording();
+		pecPhaseKnown = pecPhaseKnown || (altRecorded && azRecorded);
+		if (config.altPecPath != nullptr && config.azPecPath != nullptr)
+		{
+			altPec.save(config.altPecPath);
+			azPec.save(config.azPecPath);
+		}
+	}
+
+	if (mode == PEC_RECORD && pec != PEC_RECORD)
+	{
+		altPec.startRecording();
+		azPec.startRecording();
+	}
+
+	if (mode == PEC_PLAYBACK && !(altPec.isValid() && azPec.isValid()))
+	{
+		mode = PEC_OFF;
+	}
+	else if (mode == PEC_PLAYBACK && !pecPhaseKnown)
+	{
+		cout << "PEC tables were recorded against a motor phase that was not restored, record them again" << endl;
+		mode = PEC_OFF;
+	}
+	pec = mode;
+}
+
+/**********************************************************************
+* Function:			getPecMode
+* Purpose: 			Returns what tracking does with the PEC tables
+* Precondition:		None
+* Postcondition:	Returns the mode
+************************************************************************/
+pecMode coordinate::getPecMode()
+{
+	return pec;
+}
+
+/**********************************************************************
+* Function:			recordPecSample
+* Purpose: 			Adds one measured correction at the current motor shaft phase of each axis
+* Precondition:		Pass in the microsteps each axis had to move to be back on target, from a guide camera or
+*					hand corrections
+* Postcondition:	Samples are added to the tables while recording, ignored otherwise
+************************************************************************/
+void coordinate::recordPecSample(double altCorrectionSteps, double azCorrectionSteps)
+{
+	if (pec == PEC_RECORD)
+	{
+		altPec.record(altDriver.getMotorSteps(), altCorrectionSteps);
+		azPec.record(azDriver.getMotorSteps(), azCorrectionSteps);
+	}
+}
+
+/**********************************************************************
+* Function:			guide
+* Purpose: 			Applies one correction from the guide camera to the tracked target
+* Precondition:		Pass in how far the mount should move now and the drift rate to follow from now on, both
+*					as arcseconds on the sky, azimuth measured along the sky rather than along the axis
+* Postcondition:	Tracking follows the target plus the accumulated offset and rate until the next target.
+*					The whole accumulated offset, rate and this move included, is handed to recordPecSample(), so
+*					guiding while recording builds the tables from how far off the target the gears have left the mount.
+************************************************************************/
+void coordinate::guide(double altArcsec, double azArcsec, double altRateArcsec, double azRateArcsec)
+{
+	double julianDate = sidereal::getJulianDate();
+	double cosAlt = cos(altAxis.getDeg() * DEG_TO_RAD);
+	double azScale = azKinematics::stepsPerDeg / 3600.0 / ((cosAlt > MIN_GUIDE_COS_ALT) ? cosAlt : MIN_GUIDE_COS_ALT);
+	double altScale = altKinematics::stepsPerDeg / 3600.0;
+
+	//Fold the old rate into the offset before it changes
+	double elapsed = (julianDate - guideJulianDate) * SECONDS_PER_DAY;
+	guideAltSteps += guideAltRate * elapsed + altArcsec * altScale;
+	guideAzSteps += guideAzRate * elapsed + azArcsec * azScale;
+	guideAltRate = altRateArcsec * altScale;
+	guideAzRate = azRateArcsec * azScale;
+	guideJulianDate = julianDate;
+
+	recordPecSample(guideAltSteps, guideAzSteps);
+}
+
+/**********************************************************************
+* Function:			clearGuide
+* Purpose: 			Forgets every guide correction
+* Precondition:		None
+* Postcondition:	Tracking follows the target alone
+************************************************************************/
+void coordinate::clearGuide()
+{
+	guideAltSteps = 0;
+	guideAzSteps = 0;
+	guideAltRate = 0;
+	guideAzRate = 0;
+	guideJulianDate = 0;
+}
+
+/**********************************************************************
+* Function:			addGuideOffset
+* Purpose: 			Adds the guide camera corrections to the tracking loop's targets
+* Precondition:		Pass in the time the targets are for and the targets from planToSteps()
+* Postcondition:	Targets are moved by the offset plus the rate since it was set, rounded to whole microsteps
+************************************************************************/
+void coordinate::addGuideOffset(double julianDate, int64_t &altSteps, int64_t &azSteps)
+{
+	if (guideJulianDate == 0)
+	{
+		return;
+	}
+
+	double elapsed = (julianDate - guideJulianDate) * SECONDS_PER_DAY;
+	altSteps += llround(guideAltSteps + guideAltRate * elapsed);
+	azSteps += llround(guideAzSteps + guideAzRate * elapsed);
+}
+
+/**********************************************************************
+* Function:			commitState
+* Purpose: 			Saves the mount state to the state file
+* Precondition:		None
+* Postcondition:	State is written to memory-mapped file if one is attached, costs a memory copy and a checksum
+************************************************************************/
+void coordinate::commitState()
+{
+	mountState saved;
+
+	if (state == nullptr)
+	{
+		return;
+	}
+
+	saved.latDeg = currentLatLongDeg.x;
+	saved.longDeg = currentLatLongDeg.y;
+	saved.altSteps = altAxis.getSteps();
+	saved.azSteps = azAxis.getSteps();
+	saved.altMotorSteps = altDriver.getMotorSteps();
+	saved.azMotorSteps = azDriver.getMotorSteps();
+	saved.cableNeutralAzDeg = planner.getCableNeutral();
+	saved.limits = planner.getLimits();
+	saved.targetRaDeg = currentCelestialPosDeg.x;
+	saved.targetDecDeg = currentCelestialPosDeg.y;
+	saved.calibrated = calibrated ? 1 : 0;
+	saved.tracking = tracking ? 1 : 0;
+	saved.motorsEnabled = motorsEnabled ? 1 : 0;
+	saved.reserved = 0;
+
+	state->save(saved);
+}
+
+/**********************************************************************
+* Function:			planToSteps
+* Purpose: 			Converts a planned position to the microstep targets of the tracking loop
+* Precondition:		Pass in the plan and the targets to fill
+* Postcondition:	Targets are whole microsteps. During playback each axis' correction at its motor shaft phase
+*					is added, so the tracking rate follows the gearbox error instead of reacting to it.
+************************************************************************/
+void coordinate::planToSteps(slewPlan plan, int64_t &altSteps, int64_t &azSteps)
+{
+	altSteps = altAxis.degToSteps(plan.altDeg);
+	azSteps = azAxis.degToSteps(plan.azDeg);
+
+	if (pec == PEC_PLAYBACK)
+	{
+		altSteps += llround(altPec.correction(altDriver.getMotorSteps()));
+		azSteps += llround(azPec.correction(azDriver.getMotorSteps()));
+	}
+}
+
 void coordinate::manualControl()
 {
 	//Keyboard control:
@@ -144,39 +633,25 @@ void coordinate::manualControl()
 		{
 			//Up
 		case 'w':
-			
-			for (int i = 0; i < 1000; i++)
-			{
-				stepUp();
-				
-			}
+			jog(1000, 0);
 			cout << "Moving up!" << endl;
 			break;
 
 			//Down
 		case 's':
-			for (int i = 0; i < 1000; i++)
-			{
-				stepDown();
-			}
+			jog(-1000, 0);
 			cout << "Moving Down!" << endl;
 			break;
 
 			//Left
 		case 'a':
-			for (int i = 0; i < 1000; i++)
-			{
-				stepLeft();
-			}
+			jog(0, -1000);
 			cout << "Moving left!" << endl;
 			break;
 
 			//Right
 		case 'd':
-			for (int i = 0; i < 1000; i++)
-			{
-				stepRight();
-			}
+			jog(0, 1000);
 			cout << "Moving right!" << endl;
 			break;
 
@@ -187,71 +662,54 @@ void coordinate::manualControl()
 
 		//Reset
 		key = NULL;
-		gpioDelay(_DELAY);
+		gpio->delayMicros(_DELAY);
 	}
 
 }
 
+/**********************************************************************
+* Function:			gotoCoordsDeg
+* Purpose: 			Slews to a target and tracks it
+* Precondition:		calibrate() must have been called, pass in the target RA / Dec in degrees
+* Postcondition:	Never returns, the telescope keeps tracking the target. The azimuth path is the shortest
+*					one allowed by the cable-wrap limit and the altitude is kept inside the altitude limits.
+************************************************************************/
 void coordinate::gotoCoordsDeg(twoAxisDeg targetRaDec)
 {
-	//Convert Ra Dec to Alt Az
-	twoAxisDeg targetAltAz = equatorialToLocal(targetRaDec.x, targetRaDec.y, currentLatLongDeg);
-	
-	double xToMove = targetAltAz.x - currentAltAz.x;
-	double yToMove = targetAltAz.y - currentAltAz.y;
+	track(targetRaDec, -1);
+}
 
-	double gear_ratio = 100 * 2.5;
-	double step_resolution = _STEPS * gear_ratio;
+/**********************************************************************
+* Function:			gotoCoordsDeg (override)
+* Purpose: 			Slews to a target and tracks it for a while
+* Precondition:		calibrate() must have been called, pass in the target RA / Dec in degrees and how long to
+*					stay on it in seconds, counted from when the call is made
+* Postcondition:	Returns once trackSeconds have passed, the telescope is left pointed at the target
+************************************************************************/
+void coordinate::gotoCoordsDeg(twoAxisDeg targetRaDec, double trackSeconds)
+{
+	track(targetRaDec, sidereal::getJulianDate() + trackSeconds / SECONDS_PER_DAY);
+}
 
-	double step_size = 360 / step_resolution;
-	while (1)
-	{
-		//If the y degrees to move is more than a step size in degrees
-		if (abs(yToMove) >= (step_size))
-		{
-			//0 to 360 degrees, 0 = North, 90 = East, 180 = South, 270 = West
-			
-			//Step if positive AND not out of bounds
-			if (yToMove > 0 && targetAltAz.y < 360)
-			{
-				coordinate::stepRight();
-				currentAltAz.y += step_size;
-			}
-			//Step if negative AND not out of bounds
-			if (yToMove < 0 && targetAltAz.y > 0)
-			{
-				coordinate::stepLeft();
-				currentAltAz.y -= step_size;
-			}
-		}
+/**********************************************************************
+* Function:			track
+* Purpose: 			Blocking slew and tracking loop shared by both gotoCoordsDeg
+* Precondition:		Pass in the target RA / Dec in degrees and the julian date to stop at, negative to never stop
+* Postcondition:	Telescope is pointed at the target when the stop time is reached
+************************************************************************/
+void coordinate::track(twoAxisDeg targetRaDec, double untilJulianDate)
+{
+	beginTrack(targetRaDec, untilJulianDate);
 
-		//If the x degrees to move is more than a step size in degrees
-		if (abs(xToMove) >= (step_size))
+	//Rest for one pulse whenever both axes are on target instead of spinning on the clock
+	while (tracking)
+	{
+		if (updateTrack(1) == 0)
 		{
-			//0 to 90 degrees, 0 = Horizontal, 90 = Vertical, anything > 90 or < 0 is ignored
-			// 
-			//Step if positive
-			if (xToMove > 0 && targetAltAz.x < 90)
-			{
-				coordinate::stepUp();
-				currentAltAz.x += step_size;
-
-			}
-			//Step if negative
-			if (xToMove < 0 && targetAltAz.x > 0)
-			{
-				coordinate::stepDown();
-				currentAltAz.x -= step_size;
-			}
+			gpio->delayMicros(azKinematics::pulseDelayMicros);
 		}
-		//Update target Alt Az
-		targetAltAz = coordinate::equatorialToLocal(targetRaDec.x, targetRaDec.y, currentLatLongDeg);
-		xToMove = targetAltAz.x - currentAltAz.x;
-		yToMove = targetAltAz.y - currentAltAz.y;
-		cout << "Tracking" << endl;
 	}
 
-
 	//Step
 	//char key = NULL;
 
@@ -313,44 +771,183 @@ void coordinate::gotoCoordsDeg(twoAxisDeg targetRaDec)
 
 }
 
+/**********************************************************************
+* Function:			beginTrack
+* Purpose: 			Starts a slew to a target, the moves are made by updateTrack()
+* Precondition:		calibrate() must have been called, pass in the target RA / Dec in degrees and the julian date
+*					to stop at, negative to never stop
+* Postcondition:	isTracking() is true and the shortest allowed path to the target is planned. If the cable-wrap
+*					window has no room for the target the mount is left where it is and isTracking() is false.
+************************************************************************/
+void coordinate::beginTrack(twoAxisDeg targetRaDec, double untilJulianDate)
+{
+	//Convert Ra Dec to Alt Az and pick the shortest way around the azimuth circle
+	twoAxisDeg targetAltAz = equatorialToLocal(targetRaDec.x, targetRaDec.y, currentLatLongDeg);
+	slewPlan target = planner.plan(azAxis.getDeg(), targetAltAz.x, targetAltAz.y);
+	if (!target.reachable)
+	{
+		cout << "Target azimuth " << targetAltAz.y << " is outside the cable-wrap limits, not slewing" << endl;
+		endTrack();
+		return;
+	}
+
+	currentCelestialPosDeg = targetRaDec;
+	trackUntilJulianDate = untilJulianDate;
+	trackPlan = target;
+	tracking = true;
+	clearGuide();
+
+	commitState();
+}
+
+/**********************************************************************
+* Function:			updateTrack
+* Purpose: 			Moves toward the tracked target, the body of the tracking loop
+* Precondition:		beginTrack() must have been called, pass in the most pulses per axis to make before returning
+* Postcondition:	Returns how many pulses were made, fewer than maxPulses once both axes are on target. The
+*					target is re-planned before every pulse so one crossing North does not turn the mount the
+*					long way. Tracking ends when the stop time passes, requestStop() was called, or the target
+*					moves where the cable-wrap window cannot follow.
+************************************************************************/
+int coordinate::updateTrack(int maxPulses)
+{
+	int pulses = 0;
+	while (tracking && pulses < maxPulses)
+	{
+		double julianDate = sidereal::getJulianDate();
+		bool stop = stopRequested.exchange(false);
+		if ((trackUntilJulianDate >= 0 && julianDate >= trackUntilJulianDate) || stop)
+		{
+			endTrack();
+			break;
+		}
+
+		//Targets are converted to whole microsteps once per update, the stepping itself only compares integers
+		twoAxisDeg targetAltAz = equatorialToLocal(currentCelestialPosDeg.x, currentCelestialPosDeg.y, currentLatLongDeg, julianDate);
+		trackPlan = planner.replan(trackPlan, targetAltAz.x, targetAltAz.y);
+		if (!trackPlan.reachable)
+		{
+			cout << "Target moved outside the cable-wrap limits, tracking stopped" << endl;
+			endTrack();
+			break;
+		}
+		int64_t xTargetSteps, yTargetSteps;
+		planToSteps(trackPlan, xTargetSteps, yTargetSteps);
+		addGuideOffset(julianDate, xTargetSteps, yTargetSteps);
+
+		bool moved = false;
+
+		//If the azimuth is at least one microstep away
+		//Unwrapped mount degrees, 0 = North, 90 = East, 180 = South, 270 = West, the planner keeps it inside the cable-wrap
+		if (yTargetSteps != azAxis.getSteps())
+		{
+			moved = true;
+			azAxis.move(azDriver.step(yTargetSteps - azAxis.getSteps()));
+		}
+
+		//If the altitude is at least one microstep away
+		//0 to 90 degrees, 0 = Horizontal, 90 = Vertical, the planner clamps targets outside the altitude limits
+		if (xTargetSteps != altAxis.getSteps())
+		{
+			moved = true;
+			altAxis.move(altDriver.step(xTargetSteps - altAxis.getSteps()));
+		}
+
+		//On target, the next pulse starts a new run of deadlines
+		if (!moved)
+		{
+			scheduler.resync();
+			break;
+		}
+
+		//Every committed step is saved so a restart resumes from the exact microstep
+		commitState();
+		pulses++;
+	}
+
+	return pulses;
+}
+
+/**********************************************************************
+* Function:			endTrack
+* Purpose: 			Stops tracking where the mount is
+* Precondition:		None
+* Postcondition:	isTracking() is false and the state is saved, further updateTrack() calls do nothing
+************************************************************************/
+void coordinate::endTrack()
+{
+	tracking = false;
+	scheduler.resync();
+	commitState();
+}
+
+/**********************************************************************
+* Function:			retarget
+* Purpose: 			Moves a track that is running onto a new target without stopping it
+* Precondition:		beginTrack() must have been called, pass in the new target RA / Dec in degrees
+* Postcondition:	The next updateTrack() slews to the new target. The plan carries on from the last one, so the
+*					azimuth stays on its wrap, and the stop time is kept. Guide corrections are dropped, they
+*					were for the old star.
+************************************************************************/
+void coordinate::retarget(twoAxisDeg targetRaDec)
+{
+	currentCelestialPosDeg = targetRaDec;
+	clearGuide();
+	commitState();
+}
+
+/**********************************************************************
+* Function:			jog
+* Purpose: 			Moves each axis by a number of fine microsteps, used for hand control
+* Precondition:		Pass in signed microsteps, positive is up / right
+* Postcondition:	The step counters follow the move so pointing is kept after calibrate(), the state is saved
+************************************************************************/
+void coordinate::jog(int64_t altSteps, int64_t azSteps)
+{
+	//Starts a new run of deadlines, the mount may have been idle for a long time
+	scheduler.resync();
+	for (int64_t i = 0; i < llabs(azSteps); i++)
+	{
+		if (azSteps > 0)
+		{
+			stepRight();
+		}
+		else
+		{
+			stepLeft();
+		}
+	}
+	for (int64_t i = 0; i < llabs(altSteps); i++)
+	{
+		if (altSteps > 0)
+		{
+			stepUp();
+		}
+		else
+		{
+			stepDown();
+		}
+	}
+	commitState();
+}
+
+//Single fine microsteps for manual control, reversals take up backlash first and the counters follow
 void coordinate::stepRight()
-{	//Set direction
-	gpioWrite(DIR1, PI_LOW);
-	//Step
-	gpioWrite(PUL1, PI_HIGH);
-	gpioDelay(_DELAY);
-	gpioWrite(PUL1, PI_LOW);
-	gpioDelay(_DELAY);
+{
+	azAxis.move(azDriver.step(1));
 }
 
 void coordinate::stepLeft()
-{	//Set direction
-	gpioWrite(DIR1, PI_HIGH);
-	//Step 
-	gpioWrite(PUL1, PI_HIGH);
-	gpioDelay(_DELAY);
-	gpioWrite(PUL1, PI_LOW);
-	gpioDelay(_DELAY);
+{
+	azAxis.move(azDriver.step(-1));
 }
 
 void coordinate::stepUp()
-{		
-	//Set direction
-	gpioWrite(DIR2, PI_LOW);
-	//Step
-	gpioWrite(PUL2, PI_HIGH);
-	gpioDelay(_DELAY);
-	gpioWrite(PUL2, PI_LOW);
-	gpioDelay(_DELAY);
+{
+	altAxis.move(altDriver.step(1));
 }
 
 void coordinate::stepDown()
 {
-	//Set direction
-	gpioWrite(DIR2, PI_HIGH);
-	//Step
-	gpioWrite(PUL2, PI_HIGH);
-	gpioDelay(_DELAY);
-	gpioWrite(PUL2, PI_LOW);
-	gpioDelay(_DELAY);
+	altAxis.move(altDriver.step(-1));
 }
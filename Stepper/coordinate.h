@@ -7,32 +7,23 @@
 **************************************************************/
 #pragma once
 
-//Stepper motor 1 - Horizontal
-#define	ENA1 2
-#define DIR1 3
-#define PUL1 4
-
-//Stepper motor 2 - Vertical
-#define ENA2 17
-#define DIR2 27
-#define PUL2 22
-
-//#define _DELAY 64
+//Delay between manual control commands, step timing comes from axisKinematics
 #define _DELAY 100
-#define _STEPS 1600
-#define _GEAR_RATIO 100 * 2.5
-#define _STEP_RESOLUTION _STEPS * _GEAR_RATIO
-#define _STEP_SIZE 1/_STEP_RESOLUTION
-//Controller pins
-#define D_BTN 5
-#define C_BTN 6
-#define B_BTN 13
-#define A_BTN 19
+
+//Azimuth guide corrections grow as 1 / cos(Alt), this caps them near the zenith
+#define MIN_GUIDE_COS_ALT 0.05
 
 #include <math.h>		//M_PI
 #include <cmath>		//atan2()
 #include "sidereal.h"	//degree and hour minute second structs, getLMST()
-#include <pigpio.h>		//gpio access for Raspberry Pi
+#include "slewPlanner.h"	//Shortest path and cable-wrap limits for slews
+#include "axisPosition.h"	//Exact microstep counters for each axis, altKinematics / azKinematics
+#include "axisDriver.h"		//Backlash take-up and microstep mode of each driver
+#include "pecTable.h"		//Periodic error correction of each axis
+#include "stateFile.h"		//Memory-mapped mount state for warm restarts
+#include "mountConfig.h"	//Pins of this mount
+#include "gpioDriver.h"		//Real or software gpio pins
+#include <atomic>		//std::atomic
 
 using std::cin;
 
@@ -76,25 +67,88 @@ typedef struct twoAxisDms
 /************************************************************************
 * Class: 		coordinate
 * Purpose:		Provide conversion from equatorial Right Ascension / Declination to local Altitude / Azimuth coordinates
-* Data members:	double Alt
-*				double Az
+* Data members:	config / gpio		- Pins of this mount and the driver used to reach them
+*				altAxis / azAxis	- Exact microstep position of each axis
+*				altDriver / azDriver	- Pulse each axis, taking up backlash and using coarse steps on long slews
+*				altPec / azPec / pec	- Periodic error table of each axis and what tracking does with them
+*				pecPhaseKnown		- True once playback lines up with the gears, after a recording or a warm restart
+*				currentLatLongDeg	- Observer latitude / longitude
+*				planner				- Shortest path and limits for slews
+*				state				- Persistent copy of all of the above
 * 
 * Methods:		myMethods
 *************************************************************************/
 class coordinate
 {
 	public:
-		twoAxisDeg equatorialToLocal(double RA, double Dec, twoAxisDeg myPositionDeg);
+		coordinate();
+		coordinate(mountConfig config, gpioDriver *gpio);
+		static twoAxisDeg equatorialToLocal(double RA, double Dec, twoAxisDeg myPositionDeg);
+		static twoAxisDeg equatorialToLocal(double RA, double Dec, twoAxisDeg myPositionDeg, double julianDate);
 		void calibrate(twoAxisDeg latLong);
+		void calibrate(twoAxisDeg latLong, twoAxisDeg RaDecInput);
 		void manualControl();
 		void gotoCoordsDeg(twoAxisDeg targetRaDec);
+		void gotoCoordsDeg(twoAxisDeg targetRaDec, double trackSeconds);
+		void beginTrack(twoAxisDeg targetRaDec, double untilJulianDate);
+		int updateTrack(int maxPulses);
+		void endTrack();
+		void retarget(twoAxisDeg targetRaDec);
+		void jog(int64_t altSteps, int64_t azSteps);
+		uint64_t getMissedDeadlines();
+		void setSlewLimits(slewLimits limits);
+		slewLimits getSlewLimits();
+		twoAxisDeg getCurrentAltAz();
+		twoAxisDeg getLatLongDeg();
+		slewPlan planSlew(twoAxisDeg fromAltAz, twoAxisDeg targetAltAz);
+		double estimateSlewSeconds(twoAxisDeg fromAltAz, slewPlan target);
+		bool attachStateFile(stateFile *file);
+		bool isTracking();
+		twoAxisDeg getTargetRaDec();
+		void setMotorsEnabled(bool enabled);
+		void requestStop();
+		void clearStop();
+		mountConfig getConfig();
+		void setPecMode(pecMode mode);
+		pecMode getPecMode();
+		void recordPecSample(double altCorrectionSteps, double azCorrectionSteps);
+		void guide(double altArcsec, double azArcsec, double altRateArcsec, double azRateArcsec);
+		void clearGuide();
 		void stepRight();
 		void stepLeft();
 		void stepUp();
 		void stepDown();
 	private:
-		twoAxisDeg currentCelestialPosDeg;
-		twoAxisDeg currentAltAz;
+		void track(twoAxisDeg targetRaDec, double untilJulianDate);
+		void commitState();
+		void planToSteps(slewPlan plan, int64_t &altSteps, int64_t &azSteps);
+		void addGuideOffset(double julianDate, int64_t &altSteps, int64_t &azSteps);
+
+		mountConfig config;				//Pins of this mount
+		gpioDriver *gpio;				//Pins are driven through this, real or software
+		stepScheduler scheduler;		//Absolute deadlines of every pulse of both axes
+		std::atomic<bool> stopRequested;	//Set from another thread to end gotoCoordsDeg
+		twoAxisDeg currentCelestialPosDeg;	//Target being tracked
+		slewPlan trackPlan;				//Last plan toward it, replanned on every update
+		double trackUntilJulianDate;	//When tracking ends, negative for never
+		axisPosition<altKinematics> altAxis;	//Exact microsteps, 0 = Horizontal
+		axisPosition<azKinematics> azAxis;		//Exact microsteps, 0 = North, unwrapped (leaves 0 - 360 when the cables wind up)
+		axisDriver<altKinematics> altDriver;
+		axisDriver<azKinematics> azDriver;
+		pecTable altPec;
+		pecTable azPec;
+		pecMode pec;
+		bool pecPhaseKnown;				//True once the motor step counters are on the phase the tables were recorded against
+		double guideAltSteps;			//Guide camera offset from the target, fine microsteps
+		double guideAzSteps;
+		double guideAltRate;			//Guide camera drift correction, fine microsteps per second
+		double guideAzRate;
+		double guideJulianDate;			//When the offset was last set, the rate runs from here
 		twoAxisDeg currentLatLongDeg;
+		slewPlanner planner;
+		stateFile *state;				//Where every committed move is saved, nullptr if not persisted
+		bool calibrated;
+		bool tracking;
+		bool motorsEnabled;
 };
 
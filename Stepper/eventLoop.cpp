@@ -0,0 +1,277 @@
+/*************************************************************
+* Filename:			eventLoop.cpp
+* Purpose:			Single-threaded executor for C++20 coroutines, timers and file descriptors wait in epoll
+**************************************************************/
+#include "eventLoop.h"
+
+#include <sys/epoll.h>		//epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/timerfd.h>	//timerfd_create(), timerfd_settime()
+#include <unistd.h>			//read(), close()
+#include <time.h>			//clock_gettime(), CLOCK_MONOTONIC
+#include <errno.h>			//errno, EINTR
+#include <algorithm>		//std::find()
+
+#define LOOP_MAX_EVENTS 16
+
+/**********************************************************************
+* Function:			eventLoop (constructor)
+* Purpose: 			Creates the epoll set and its timerfd
+* Precondition:		None
+* Postcondition:	Tasks can be spawned, nothing runs until run()
+************************************************************************/
+eventLoop::eventLoop()
+{
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	//The timerfd is told apart from watched descriptors by a null pointer
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+
+	nextSequence = 0;
+	armedDeadline = 0;
+	stopping = false;
+}
+
+/**********************************************************************
+* Function:			~eventLoop (destructor)
+* Purpose: 			Destroys every task that has not finished and closes the descriptors
+* Precondition:		run() must have returned
+* Postcondition:	Nothing is left waiting
+************************************************************************/
+eventLoop::~eventLoop()
+{
+	for (int i = 0; i < (int)tasks.size(); i++)
+	{
+		tasks[i].destroy();
+	}
+	close(timerFd);
+	close(epollFd);
+}
+
+/**********************************************************************
+* Function:			spawn
+* Purpose: 			Adds a task to the loop
+* Precondition:		Pass in a task that has not been spawned before
+* Postcondition:	The task starts on the next pass of run(), the loop owns it from now on
+************************************************************************/
+void eventLoop::spawn(asyncTask task)
+{
+	tasks.push_back(task.handle);
+	ready.push_back(task.handle);
+}
+
+/**********************************************************************
+* Function:			run
+* Purpose: 			Runs tasks until all of them are done or stop() is called
+* Precondition:		None
+* Postcondition:	Returns on the calling thread, unfinished tasks stay suspended
+************************************************************************/
+void eventLoop::run()
+{
+	stopping = false;
+	while (!stopping)
+	{
+		//Resume everything that is due, tasks woken meanwhile wait for the next pass
+		std::vector<std::coroutine_handle<>> resuming;
+		resuming.swap(ready);
+		for (int i = 0; i < (int)resuming.size() && !stopping; i++)
+		{
+			resuming[i].resume();
+		}
+		reap();
+
+		if (tasks.empty() || stopping)
+		{
+			break;
+		}
+
+		int64_t time = now();
+		while (!timers.empty() && timers.top().deadline <= time)
+		{
+			ready.push_back(timers.top().handle);
+			timers.pop();
+		}
+
+		//With tasks still ready only look for input, otherwise a task that keeps yielding would starve it.
+		//Nothing to do blocks until the next timer or input.
+		int timeout = 0;
+		if (ready.empty())
+		{
+			armTimer();
+			timeout = -1;
+		}
+		epoll_event events[LOOP_MAX_EVENTS];
+		int count = epoll_wait(epollFd, events, LOOP_MAX_EVENTS, timeout);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			if (events[i].data.ptr == nullptr)
+			{
+				uint64_t expirations;
+				read(timerFd, &expirations, sizeof(expirations));
+				armedDeadline = 0;
+			}
+			else
+			{
+				ready.push_back(std::coroutine_handle<>::from_address(events[i].data.ptr));
+			}
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			stop
+* Purpose: 			Makes run() return
+* Precondition:		Call from a task or before run()
+* Postcondition:	run() returns once the current task suspends
+************************************************************************/
+void eventLoop::stop()
+{
+	stopping = true;
+}
+
+/**********************************************************************
+* Function:			sleepFor
+* Purpose: 			Waits without blocking other tasks
+* Precondition:		co_await the result, pass in seconds
+* Postcondition:	The task resumes once the time has passed
+************************************************************************/
+eventLoop::sleepAwaiter eventLoop::sleepFor(double seconds)
+{
+	sleepAwaiter awaiter;
+	awaiter.loop = this;
+	awaiter.deadline = now() + (int64_t)(seconds * 1e9);
+	return awaiter;
+}
+
+/**********************************************************************
+* Function:			yield
+* Purpose: 			Lets the other ready tasks run
+* Precondition:		co_await the result
+* Postcondition:	The task resumes on the next pass of the loop
+************************************************************************/
+eventLoop::sleepAwaiter eventLoop::yield()
+{
+	sleepAwaiter awaiter;
+	awaiter.loop = this;
+	awaiter.deadline = 0;
+	return awaiter;
+}
+
+/**********************************************************************
+* Function:			readable
+* Purpose: 			Waits for input on a file descriptor
+* Precondition:		co_await the result, pass in a descriptor only one task waits on at a time
+* Postcondition:	The task resumes once a read will not block, including at end of file
+************************************************************************/
+eventLoop::readAwaiter eventLoop::readable(int fd)
+{
+	readAwaiter awaiter;
+	awaiter.loop = this;
+	awaiter.fd = fd;
+	return awaiter;
+}
+
+/**********************************************************************
+* Function:			now
+* Purpose: 			Returns the time timers are measured in
+* Precondition:		None
+* Postcondition:	Returns CLOCK_MONOTONIC in nanoseconds
+************************************************************************/
+int64_t eventLoop::now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**********************************************************************
+* Function:			addTimer
+* Purpose: 			Queues a coroutine to resume at a time
+* Precondition:		Pass in a CLOCK_MONOTONIC deadline in nanoseconds and the suspended coroutine
+* Postcondition:	Deadlines already passed resume on the next pass without touching the timerfd
+************************************************************************/
+void eventLoop::addTimer(int64_t deadline, std::coroutine_handle<> handle)
+{
+	if (deadline <= now())
+	{
+		ready.push_back(handle);
+		return;
+	}
+
+	loopTimer timer;
+	timer.deadline = deadline;
+	timer.sequence = nextSequence++;
+	timer.handle = handle;
+	timers.push(timer);
+}
+
+/**********************************************************************
+* Function:			watch
+* Purpose: 			Resumes a coroutine once a descriptor is readable
+* Precondition:		Pass in the descriptor and the suspended coroutine
+* Postcondition:	The descriptor fires once, it is re-armed by the next readable()
+************************************************************************/
+void eventLoop::watch(int fd, std::coroutine_handle<> handle)
+{
+	epoll_event event;
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = handle.address();
+
+	//A closed descriptor leaves epoll by itself, so a new one given the same number has to be added again
+	if (std::find(watched.begin(), watched.end(), fd) == watched.end())
+	{
+		watched.push_back(fd);
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+	}
+	else if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) != 0 && errno == ENOENT)
+	{
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+	}
+}
+
+/**********************************************************************
+* Function:			armTimer
+* Purpose: 			Points the timerfd at the earliest timer
+* Precondition:		None
+* Postcondition:	The timerfd is only reprogrammed when the earliest deadline changed
+************************************************************************/
+void eventLoop::armTimer()
+{
+	int64_t deadline = timers.empty() ? 0 : timers.top().deadline;
+	if (deadline == armedDeadline)
+	{
+		return;
+	}
+
+	itimerspec setting = {};
+	setting.it_value.tv_sec = deadline / 1000000000;
+	setting.it_value.tv_nsec = deadline % 1000000000;
+	timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &setting, nullptr);
+	armedDeadline = deadline;
+}
+
+/**********************************************************************
+* Function:			reap
+* Purpose: 			Destroys finished tasks
+* Precondition:		None
+* Postcondition:	Only unfinished tasks are left
+************************************************************************/
+void eventLoop::reap()
+{
+	for (int i = (int)tasks.size() - 1; i >= 0; i--)
+	{
+		if (tasks[i].done())
+		{
+			tasks[i].destroy();
+			tasks.erase(tasks.begin() + i);
+		}
+	}
+}
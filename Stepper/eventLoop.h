@@ -0,0 +1,149 @@
+/*************************************************************
+* Filename:			eventLoop.h
+* Purpose:			Single-threaded executor for C++20 coroutines, timers and file descriptors wait in epoll
+**************************************************************/
+#pragma once
+
+#include <coroutine>	//std::coroutine_handle, std::suspend_always
+#include <exception>	//std::terminate()
+#include <vector>		//std::vector
+#include <queue>		//std::priority_queue
+#include <functional>	//std::greater
+#include <stdint.h>		//int64_t, uint64_t
+
+class eventLoop;
+
+/************************************************************************
+* Class: 		asyncTask
+* Purpose:		A coroutine run by eventLoop. It does not start until spawned, and the loop destroys it once
+*				it has finished.
+* Data members:	handle	- The coroutine
+*************************************************************************/
+class asyncTask
+{
+	public:
+		struct promise_type
+		{
+			asyncTask get_return_object() { return asyncTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+
+		explicit asyncTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+		std::coroutine_handle<promise_type> handle;
+};
+
+/************************************************************************
+* Struct: 		cancelToken
+* Purpose:		Shared between a task and whoever may cancel it, the task checks it each time it wakes
+* Data members:	cancelled	- Set to end the task
+*************************************************************************/
+typedef struct cancelToken
+{
+	bool cancelled;
+} cancelToken;
+
+/************************************************************************
+* Struct: 		loopTimer
+* Purpose:		One coroutine waiting for a time
+* Data members:	deadline	- CLOCK_MONOTONIC nanoseconds to wake at
+*				sequence	- Keeps timers with the same deadline in the order they were set
+*				handle		- Coroutine to resume
+*************************************************************************/
+typedef struct loopTimer
+{
+	int64_t deadline;
+	uint64_t sequence;
+	std::coroutine_handle<> handle;
+
+	bool operator>(const loopTimer &other) const
+	{
+		return (deadline != other.deadline) ? deadline > other.deadline : sequence > other.sequence;
+	}
+} loopTimer;
+
+/************************************************************************
+* Class: 		eventLoop
+* Purpose:		Runs spawned tasks on the calling thread. A task runs until it awaits sleepFor() or readable(),
+*				and the loop then blocks in epoll_wait until the earliest timer, held in one timerfd, or a
+*				watched file descriptor is due. Nothing spins, so an idle loop uses no CPU.
+* Data members:	epollFd		- Waits for the timerfd and watched descriptors
+*				timerFd		- Armed for the earliest timer
+*				timers		- Waiting timers, earliest on top
+*				ready		- Coroutines to resume on the next pass
+*				tasks		- Every spawned task, destroyed once done
+*				watched		- Descriptors already added to epoll
+*				nextSequence	- Sequence of the next timer
+*				armedDeadline	- Deadline timerFd is set for, 0 if disarmed
+*				stopping	- Set by stop()
+*
+* Methods:		spawn
+*				run
+*				stop
+*				sleepFor
+*				yield
+*				readable
+*				now
+*************************************************************************/
+class eventLoop
+{
+	public:
+		eventLoop();
+		~eventLoop();
+
+		void spawn(asyncTask task);
+		void run();
+		void stop();
+
+		/************************************************************************
+		* Struct: 		sleepAwaiter
+		* Purpose:		Returned by sleepFor(), co_await it to wait
+		*************************************************************************/
+		struct sleepAwaiter
+		{
+			eventLoop *loop;
+			int64_t deadline;
+
+			bool await_ready() { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { loop->addTimer(deadline, handle); }
+			void await_resume() {}
+		};
+
+		/************************************************************************
+		* Struct: 		readAwaiter
+		* Purpose:		Returned by readable(), co_await it to wait for input
+		*************************************************************************/
+		struct readAwaiter
+		{
+			eventLoop *loop;
+			int fd;
+
+			bool await_ready() { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { loop->watch(fd, handle); }
+			void await_resume() {}
+		};
+
+		sleepAwaiter sleepFor(double seconds);
+		sleepAwaiter yield();
+		readAwaiter readable(int fd);
+		static int64_t now();
+
+	private:
+		void addTimer(int64_t deadline, std::coroutine_handle<> handle);
+		void watch(int fd, std::coroutine_handle<> handle);
+		void armTimer();
+		void reap();
+
+		int epollFd;
+		int timerFd;
+		std::priority_queue<loopTimer, std::vector<loopTimer>, std::greater<loopTimer>> timers;
+		std::vector<std::coroutine_handle<>> ready;
+		std::vector<std::coroutine_handle<asyncTask::promise_type>> tasks;
+		std::vector<int> watched;
+		uint64_t nextSequence;
+		int64_t armedDeadline;
+		bool stopping;
+};
@@ -0,0 +1,236 @@
+/*************************************************************
+* Filename:			fastTrig.h
+* Purpose:			Minimax polynomial sin / cos / atan2 / asin with bounded error for the tracking math
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//uint64_t, int64_t
+#include <string.h>		//memcpy()
+#include <math.h>		//floor(), sqrt(), fmod(), M_PI
+
+/*
+* Build with USE_FAST_TRIG defined (the project defines it) for the polynomials below, or without it for libm.
+* Worst case errors measured by --check-trig against libm, one microstep of the 400,000 step drivetrain is
+* 1.57e-5 rad:
+*	sin / cos		2.4e-12 rad		|x| < 1.6e6 rad
+*	atan2			1.8e-13 rad		finite arguments
+*	asin			6e-13 rad		|x| <= 1, rounding past either end is clamped
+*	wrapTwoPi		4e-17 * |x| rad	|x| < 6.5e6 rad, all of it fmod()'s, which divides by 2 pi rounded to a double
+* None of the functions branch, so loops of them vectorize for NEON or SSE4. GCC also needs -fno-math-errno for
+* sqrt() and -fno-trapping-math for the selects, both set in the project, nothing here reads errno or FP flags.
+*/
+
+//Adding 1.5 * 2^52 rounds to the nearest integer, which is then the low bits of the result
+#define TRIG_ROUND_MAGIC 6755399441055744.0
+#define TRIG_TWO_OVER_PI 0.636619772367581343076
+#define TRIG_ONE_OVER_TWO_PI 0.159154943091895335769
+//pi / 2 split so that n * TRIG_PIO2_HI is exact for |n| < 2^20, Cody and Waite's reduction
+#define TRIG_PIO2_HI 1.57079632673412561417e+00
+#define TRIG_PIO2_LO 6.07710050650619224932e-11
+#define TRIG_TAN_PI_OVER_8 0.414213562373095048802
+#define TRIG_SIGN_BIT 0x8000000000000000ULL
+
+//sin(r) = r + r^3 * S(r^2) on |r| <= pi / 4, error 2.3e-12
+#define TRIG_S1 -1.66666666279990660597e-01
+#define TRIG_S2 8.33332823871526493505e-03
+#define TRIG_S3 -1.98390437703807103364e-04
+#define TRIG_S4 2.71601401630063147855e-06
+
+//cos(r) = 1 - r^2 / 2 + r^4 * C(r^2) on |r| <= pi / 4, error 9.9e-14
+#define TRIG_C1 4.16666666228281937126e-02
+#define TRIG_C2 -1.38888837534264741305e-03
+#define TRIG_C3 2.47995200138940779482e-05
+#define TRIG_C4 -2.72102382379810180480e-07
+
+//atan(u) = u + u^3 * A(u^2) on |u| <= tan(pi / 8), error 1.8e-13
+#define TRIG_A1 -3.33333332572327548939e-01
+#define TRIG_A2 1.99999908168587817335e-01
+#define TRIG_A3 -1.42853089666098379679e-01
+#define TRIG_A4 1.11022106373773544601e-01
+#define TRIG_A5 -8.98230094463360928647e-02
+#define TRIG_A6 6.93225210531002469547e-02
+#define TRIG_A7 -3.69781857319962921978e-02
+
+//asin(v) = v + v^3 * B(v^2) on |v| <= 1 / 2, error 2.9e-13
+#define TRIG_B1 1.66666665715484341506e-01
+#define TRIG_B2 7.50000947379628109414e-02
+#define TRIG_B3 4.46393867347934742672e-02
+#define TRIG_B4 3.04457547810588176264e-02
+#define TRIG_B5 2.17118838631376227556e-02
+#define TRIG_B6 2.13351111289164417500e-02
+#define TRIG_B7 3.60085136877458523970e-04
+#define TRIG_B8 3.44681263325009097297e-02
+
+/************************************************************************
+* Class: 		fastTrig
+* Purpose:		The trig the tracking loop runs every pulse, as short minimax polynomials instead of libm's
+*				full precision ones. Coefficients were fit with the Remez exchange over each reduced range.
+*				Everything is inline and written with selects rather than branches, so a loop over many
+*				angles compiles to vector code.
+* Data members:	none
+*
+* Methods:		sin / cos / sinCos
+*				atan2
+*				asin
+*				wrapTwoPi
+*************************************************************************/
+class fastTrig
+{
+	public:
+		static inline void sinCos(double x, double &sinX, double &cosX);
+		static inline double sin(double x);
+		static inline double cos(double x);
+		static inline double atan2(double y, double x);
+		static inline double asin(double x);
+		static inline double wrapTwoPi(double x);
+
+	private:
+		static inline uint64_t toBits(double x)
+		{
+			uint64_t bits;
+			memcpy(&bits, &x, sizeof(bits));
+			return bits;
+		}
+		static inline double fromBits(uint64_t bits)
+		{
+			double x;
+			memcpy(&x, &bits, sizeof(x));
+			return x;
+		}
+};
+
+/**********************************************************************
+* Function:			sinCos
+* Purpose: 			Sine and cosine of one angle
+* Precondition:		Pass in the angle in radians, |x| < 1.6e6
+* Postcondition:	sinX and cosX are within 2.4e-12 of the true values
+************************************************************************/
+inline void fastTrig::sinCos(double x, double &sinX, double &cosX)
+{
+	//Nearest multiple n of pi / 2 and the remainder r in [-pi / 4, pi / 4]
+	double shifted = x * TRIG_TWO_OVER_PI + TRIG_ROUND_MAGIC;
+	uint64_t quadrant = toBits(shifted);
+	double n = shifted - TRIG_ROUND_MAGIC;
+	double r = (x - n * TRIG_PIO2_HI) - n * TRIG_PIO2_LO;
+	double r2 = r * r;
+
+	double sinR = r + r * r2 * (TRIG_S1 + r2 * (TRIG_S2 + r2 * (TRIG_S3 + r2 * TRIG_S4)));
+	double cosR = 1.0 - 0.5 * r2 + r2 * r2 * (TRIG_C1 + r2 * (TRIG_C2 + r2 * (TRIG_C3 + r2 * TRIG_C4)));
+
+	//Odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, 1 and 2 negate cos
+	bool swap = (quadrant & 1) != 0;
+	double sinValue = swap ? cosR : sinR;
+	double cosValue = swap ? sinR : cosR;
+	sinX = fromBits(toBits(sinValue) ^ ((quadrant & 2) << 62));
+	cosX = fromBits(toBits(cosValue) ^ (((quadrant + 1) & 2) << 62));
+}
+
+inline double fastTrig::sin(double x)
+{
+	double sinX, cosX;
+	sinCos(x, sinX, cosX);
+	return sinX;
+}
+
+inline double fastTrig::cos(double x)
+{
+	double sinX, cosX;
+	sinCos(x, sinX, cosX);
+	return cosX;
+}
+
+/**********************************************************************
+* Function:			atan2
+* Purpose: 			Angle of the point (x, y)
+* Precondition:		Pass in finite y and x
+* Postcondition:	Returns the angle in [-pi, pi] within 1.8e-13 of libm, 0 for (0, 0)
+************************************************************************/
+inline double fastTrig::atan2(double y, double x)
+{
+	//Fold into the first octant, t = tan of the angle in [0, 1]
+	double absX = fabs(x);
+	double absY = fabs(y);
+	bool swap = absY > absX;
+	double numerator = swap ? absX : absY;
+	double denominator = swap ? absY : absX;
+	double t = numerator / ((denominator > 0) ? denominator : 1.0);
+
+	//Above tan(pi / 8) use atan(t) = pi / 4 + atan((t - 1) / (t + 1)), so |u| <= tan(pi / 8)
+	bool upper = t > TRIG_TAN_PI_OVER_8;
+	double shift = upper ? 1.0 : 0.0;
+	double u = (t - shift) / (1.0 + shift * t);
+	double u2 = u * u;
+	double angle = shift * (M_PI / 4.0) + u + u * u2 * (TRIG_A1 + u2 * (TRIG_A2 + u2 * (TRIG_A3 + u2 * (TRIG_A4
+		+ u2 * (TRIG_A5 + u2 * (TRIG_A6 + u2 * TRIG_A7))))));
+
+	//Unfold, the sign of y goes on last. Both sides of each select are worked out first, arithmetic inside one
+	//would be a branch to the compiler.
+	double unswapped = (M_PI / 2.0) - angle;
+	angle = swap ? unswapped : angle;
+	double mirrored = M_PI - angle;
+	angle = (toBits(x) & TRIG_SIGN_BIT) ? mirrored : angle;
+	return fromBits(toBits(angle) | (toBits(y) & TRIG_SIGN_BIT));
+}
+
+/**********************************************************************
+* Function:			asin
+* Purpose: 			Arc sine
+* Precondition:		Pass in x in [-1, 1], a rounding error past either end is taken as the end
+* Postcondition:	Returns asin(x) within 6e-13. Above 1 / 2 it uses asin(x) = pi / 2 - 2 asin(sqrt((1 - x) / 2)),
+*					which stays accurate next to 1, where the altitude of a target near the zenith is found.
+************************************************************************/
+inline double fastTrig::asin(double x)
+{
+	double absX = fabs(x);
+	absX = (absX < 1.0) ? absX : 1.0;
+	bool upper = absX > 0.5;
+	double half = 0.5 * (1.0 - absX);
+	double v2 = upper ? half : absX * absX;
+	double root = sqrt(half);
+	double v = upper ? root : absX;
+	double angle = v + v * v2 * (TRIG_B1 + v2 * (TRIG_B2 + v2 * (TRIG_B3 + v2 * (TRIG_B4 + v2 * (TRIG_B5
+		+ v2 * (TRIG_B6 + v2 * (TRIG_B7 + v2 * TRIG_B8)))))));
+	double reflected = (M_PI / 2.0) - 2.0 * angle;
+	angle = upper ? reflected : angle;
+	return fromBits(toBits(angle) | (toBits(x) & TRIG_SIGN_BIT));
+}
+
+/**********************************************************************
+* Function:			wrapTwoPi
+* Purpose: 			Reduces an angle to [0, 2 pi), the same as fmod() plus a correction for negatives
+* Precondition:		Pass in the angle in radians, |x| < 6.5e6
+* Postcondition:	Returns the reduced angle. fmod() divides bit by bit, this is one floor and two multiplies.
+************************************************************************/
+inline double fastTrig::wrapTwoPi(double x)
+{
+	double n = floor(x * TRIG_ONE_OVER_TWO_PI);
+	double r = (x - n * (4.0 * TRIG_PIO2_HI)) - n * (4.0 * TRIG_PIO2_LO);
+	r += (r < 0) ? 2.0 * M_PI : 0.0;
+	return r - ((r >= 2.0 * M_PI) ? 2.0 * M_PI : 0.0);
+}
+
+/**********************************************************************
+* Function:			trigSin / trigCos / trigSinCos / trigAtan2 / trigAsin / trigWrapTwoPi
+* Purpose: 			The trig the tracking math calls, fastTrig with USE_FAST_TRIG and libm without
+* Precondition:		Same as the fastTrig functions
+* Postcondition:	Same as the fastTrig functions
+************************************************************************/
+#ifdef USE_FAST_TRIG
+inline double trigSin(double x) { return fastTrig::sin(x); }
+inline double trigCos(double x) { return fastTrig::cos(x); }
+inline void trigSinCos(double x, double &sinX, double &cosX) { fastTrig::sinCos(x, sinX, cosX); }
+inline double trigAtan2(double y, double x) { return fastTrig::atan2(y, x); }
+inline double trigAsin(double x) { return fastTrig::asin(x); }
+inline double trigWrapTwoPi(double x) { return fastTrig::wrapTwoPi(x); }
+#else
+inline double trigSin(double x) { return ::sin(x); }
+inline double trigCos(double x) { return ::cos(x); }
+inline void trigSinCos(double x, double &sinX, double &cosX) { sinX = ::sin(x); cosX = ::cos(x); }
+inline double trigAtan2(double y, double x) { return ::atan2(y, x); }
+inline double trigAsin(double x) { return ::asin(fmax(fmin(x, 1.0), -1.0)); }
+inline double trigWrapTwoPi(double x)
+{
+	double r = fmod(x, 2.0 * M_PI);
+	return (r < 0) ? r + 2.0 * M_PI : r;
+}
+#endif
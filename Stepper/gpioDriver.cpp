@@ -0,0 +1,124 @@
+/*************************************************************
+* Filename:			gpioDriver.cpp
+* Purpose:			Let the mount code drive either the Raspberry Pi pins or an in-process software stand-in
+**************************************************************/
+#include "gpioDriver.h"
+
+#include <chrono>		//std::chrono::microseconds
+#include <thread>		//std::this_thread::sleep_for()
+
+/**********************************************************************
+* Function:			instance
+* Purpose: 			Returns the one pigpio driver shared by every mount
+* Precondition:		None
+* Postcondition:	Returns a pointer that stays valid for the whole program
+************************************************************************/
+pigpioDriver *pigpioDriver::instance()
+{
+	static pigpioDriver driver;
+	return &driver;
+}
+
+/**********************************************************************
+* Function:			softGpioDriver (constructor)
+* Purpose: 			Creates a bank of software pins, all low with no pulses
+* Precondition:		None
+* Postcondition:	delayMicros() does not sleep until setRealDelays(true) is called
+************************************************************************/
+softGpioDriver::softGpioDriver()
+{
+	for (int i = 0; i < SOFT_GPIO_PINS; i++)
+	{
+		levels[i] = 0;
+		pulses[i] = 0;
+	}
+	realDelays = false;
+}
+
+/**********************************************************************
+* Function:			setMode
+* Purpose: 			Accepts a mode change, software pins work in either direction
+* Precondition:		None
+* Postcondition:	None
+************************************************************************/
+void softGpioDriver::setMode(unsigned /*pin*/, unsigned /*mode*/)
+{
+}
+
+/**********************************************************************
+* Function:			write
+* Purpose: 			Sets a pin and counts rising edges
+* Precondition:		pin must be below SOFT_GPIO_PINS
+* Postcondition:	Level is stored, pulses is increased on a low to high change
+************************************************************************/
+void softGpioDriver::write(unsigned pin, unsigned level)
+{
+	if (pin >= SOFT_GPIO_PINS)
+	{
+		return;
+	}
+
+	unsigned previous = levels[pin].exchange(level, std::memory_order_relaxed);
+	if (previous == PI_LOW && level == PI_HIGH)
+	{
+		pulses[pin].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/**********************************************************************
+* Function:			read
+* Purpose: 			Returns the level of a pin
+* Precondition:		pin must be below SOFT_GPIO_PINS
+* Postcondition:	Returns PI_LOW or PI_HIGH
+************************************************************************/
+int softGpioDriver::read(unsigned pin)
+{
+	return (int)getLevel(pin);
+}
+
+/**********************************************************************
+* Function:			delayMicros
+* Purpose: 			Stands in for gpioDelay()
+* Precondition:		None
+* Postcondition:	Sleeps for micros if real delays are on, otherwise returns at once
+************************************************************************/
+void softGpioDriver::delayMicros(unsigned micros)
+{
+	if (realDelays)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(micros));
+	}
+}
+
+/**********************************************************************
+* Function:			getLevel
+* Purpose: 			Returns the level of a pin
+* Precondition:		None
+* Postcondition:	Returns PI_LOW or PI_HIGH, PI_LOW for pins out of range
+************************************************************************/
+unsigned softGpioDriver::getLevel(unsigned pin)
+{
+	return (pin < SOFT_GPIO_PINS) ? levels[pin].load(std::memory_order_relaxed) : PI_LOW;
+}
+
+/**********************************************************************
+* Function:			getPulses
+* Purpose: 			Returns how many rising edges a pin has seen
+* Precondition:		None
+* Postcondition:	Returns the count, 0 for pins out of range
+************************************************************************/
+uint64_t softGpioDriver::getPulses(unsigned pin)
+{
+	return (pin < SOFT_GPIO_PINS) ? pulses[pin].load(std::memory_order_relaxed) : 0;
+}
+
+/**********************************************************************
+* Function:			setRealDelays
+* Purpose: 			Chooses if delayMicros() really waits
+* Precondition:		None
+* Postcondition:	Following delays follow the setting
+************************************************************************/
+void softGpioDriver::setRealDelays(bool realDelays)
+{
+	this->realDelays = realDelays;
+}
@@ -0,0 +1,85 @@
+/*************************************************************
+* Filename:			gpioDriver.h
+* Purpose:			Let the mount code drive either the Raspberry Pi pins or an in-process software stand-in
+**************************************************************/
+#pragma once
+
+#include <atomic>		//std::atomic
+#include <stdint.h>		//uint64_t
+#include <pigpio.h>		//gpio access for Raspberry Pi
+
+#define SOFT_GPIO_PINS 256
+
+/************************************************************************
+* Class: 		gpioDriver
+* Purpose:		Interface for the few GPIO calls the mount uses, matches the pigpio calls it replaces
+* Data members:	none
+* Methods:		setMode
+*				write
+*				read
+*				delayMicros
+*				hasRealTiming
+*************************************************************************/
+class gpioDriver
+{
+	public:
+		virtual ~gpioDriver() {}
+		virtual void setMode(unsigned pin, unsigned mode) = 0;
+		virtual void write(unsigned pin, unsigned level) = 0;
+		virtual int read(unsigned pin) = 0;
+		virtual void delayMicros(unsigned micros) = 0;
+
+		//False if waiting between pulses is pointless, like software pins benchmarking the stepping loop
+		virtual bool hasRealTiming() = 0;
+};
+
+/************************************************************************
+* Class: 		pigpioDriver
+* Purpose:		Real Raspberry Pi pins through pigpio, gpioInitialise() must be called first
+* Data members:	none
+* Methods:		instance
+*************************************************************************/
+class pigpioDriver : public gpioDriver
+{
+	public:
+		static pigpioDriver *instance();
+
+		void setMode(unsigned pin, unsigned mode) { gpioSetMode(pin, mode); }
+		void write(unsigned pin, unsigned level) { gpioWrite(pin, level); }
+		int read(unsigned pin) { return gpioRead(pin); }
+		void delayMicros(unsigned micros) { gpioDelay(micros); }
+		bool hasRealTiming() { return true; }
+};
+
+/************************************************************************
+* Class: 		softGpioDriver
+* Purpose:		Software pins for testing and benchmarking without hardware. Pin levels and rising edges are
+*				kept per pin, so several mounts on different pins can share one bank from different threads.
+* Data members:	levels		- Current level of each pin
+*				pulses		- Number of rising edges seen on each pin
+*				realDelays	- If true, delayMicros() sleeps, otherwise it returns at once
+*
+* Methods:		getLevel
+*				getPulses
+*				setRealDelays
+*************************************************************************/
+class softGpioDriver : public gpioDriver
+{
+	public:
+		softGpioDriver();
+
+		void setMode(unsigned pin, unsigned mode);
+		void write(unsigned pin, unsigned level);
+		int read(unsigned pin);
+		void delayMicros(unsigned micros);
+		bool hasRealTiming() { return realDelays; }
+
+		unsigned getLevel(unsigned pin);
+		uint64_t getPulses(unsigned pin);
+		void setRealDelays(bool realDelays);
+
+	private:
+		std::atomic<unsigned> levels[SOFT_GPIO_PINS];
+		std::atomic<uint64_t> pulses[SOFT_GPIO_PINS];
+		bool realDelays;
+};
@@ -0,0 +1,244 @@
+/*************************************************************
+* Filename:			guideCamera.cpp
+* Purpose:			Receive raw guide camera frames from a directory or a pipe without copying them
+**************************************************************/
+#include "guideCamera.h"
+#include "eventLoop.h"		//eventLoop::now()
+
+#include <fcntl.h>			//open(), fcntl()
+#include <unistd.h>			//read(), close()
+#include <sys/inotify.h>	//inotify_init1(), inotify_add_watch()
+#include <sys/mman.h>		//mmap(), munmap()
+#include <sys/stat.h>		//fstat()
+#include <limits.h>			//NAME_MAX
+
+/**********************************************************************
+* Function:			directoryFrameSource (constructor)
+* Purpose: 			Starts watching a directory for frames
+* Precondition:		Pass in the directory and the frame layout the camera writes
+* Postcondition:	isOpen() is false if the directory could not be watched. Files already there are ignored.
+************************************************************************/
+directoryFrameSource::directoryFrameSource(const char *directory, frameFormat format) : directory(directory), format(format)
+{
+	mapping = nullptr;
+	mappedBytes = 0;
+	sequence = 0;
+
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notifyFd >= 0 && inotify_add_watch(notifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		::close(notifyFd);
+		notifyFd = -1;
+	}
+}
+
+/**********************************************************************
+* Function:			~directoryFrameSource (destructor)
+* Purpose: 			Releases the last frame and stops watching the directory
+* Precondition:		None
+* Postcondition:	The mapping and the inotify descriptor are closed
+************************************************************************/
+directoryFrameSource::~directoryFrameSource()
+{
+	release();
+	if (notifyFd >= 0)
+	{
+		::close(notifyFd);
+	}
+}
+
+/**********************************************************************
+* Function:			getFd
+* Purpose: 			Returns the descriptor to wait on for new frames
+* Precondition:		None
+* Postcondition:	Returns the inotify descriptor, -1 if the directory could not be watched
+************************************************************************/
+int directoryFrameSource::getFd()
+{
+	return notifyFd;
+}
+
+/**********************************************************************
+* Function:			next
+* Purpose: 			Maps the newest finished frame file
+* Precondition:		None
+* Postcondition:	Returns true with frame pointing into the mapping if a file of the right size arrived since
+*					the last call. The previous frame is unmapped first, so its pixels are gone.
+************************************************************************/
+bool directoryFrameSource::next(guideFrame &frame)
+{
+	if (notifyFd < 0)
+	{
+		return false;
+	}
+
+	//Drain every event, only the last file matters
+	alignas(struct inotify_event) char events[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+	std::string newest;
+	int64_t arrival = eventLoop::now();
+	ssize_t length;
+	while ((length = read(notifyFd, events, sizeof(events))) > 0)
+	{
+		for (char *p = events; p < events + length; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+		{
+			struct inotify_event *event = (struct inotify_event *)p;
+			if (event->len > 0)
+			{
+				newest = event->name;
+			}
+		}
+	}
+	if (newest.empty())
+	{
+		return false;
+	}
+
+	size_t expected = (size_t)format.width * format.height * format.bytesPerPixel;
+	int fd = open((directory + "/" + newest).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	void *map = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && (size_t)info.st_size == expected)
+	{
+		map = mmap(nullptr, expected, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	release();
+	mapping = map;
+	mappedBytes = expected;
+
+	frame.pixels = (const uint8_t *)mapping;
+	frame.format = format;
+	frame.arrivalNanos = arrival;
+	frame.sequence = ++sequence;
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			release
+* Purpose: 			Unmaps the frame handed out by the last next()
+* Precondition:		None
+* Postcondition:	The previous frame's pixels must not be used any more
+************************************************************************/
+void directoryFrameSource::release()
+{
+	if (mapping != nullptr)
+	{
+		munmap(mapping, mappedBytes);
+	}
+	mapping = nullptr;
+	mappedBytes = 0;
+}
+
+/**********************************************************************
+* Function:			pipeFrameSource (constructor)
+* Purpose: 			Opens a FIFO the capture program writes frames into
+* Precondition:		Pass in the FIFO path and the frame layout
+* Postcondition:	isOpen() is false if it could not be opened
+************************************************************************/
+pipeFrameSource::pipeFrameSource(const char *path, frameFormat format) : pipeFrameSource(open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC), format)
+{
+	ownsFd = true;
+}
+
+/**********************************************************************
+* Function:			pipeFrameSource (constructor override)
+* Purpose: 			Reads frames from a descriptor that is already open, such as stdin or one end of pipe()
+* Precondition:		Pass in the descriptor, it is left open when the source is destroyed
+* Postcondition:	The descriptor is made non-blocking
+************************************************************************/
+pipeFrameSource::pipeFrameSource(int fd, frameFormat format) : fd(fd), format(format)
+{
+	ownsFd = false;
+	ended = false;
+	buffer.resize((size_t)format.width * format.height * format.bytesPerPixel);
+	filled = 0;
+	arrival = 0;
+	sequence = 0;
+
+	if (fd >= 0)
+	{
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+}
+
+/**********************************************************************
+* Function:			~pipeFrameSource (destructor)
+* Purpose: 			Closes the pipe if it was opened here
+* Precondition:		None
+* Postcondition:	A descriptor passed in by the caller is left open
+************************************************************************/
+pipeFrameSource::~pipeFrameSource()
+{
+	if (ownsFd && fd >= 0)
+	{
+		::close(fd);
+	}
+}
+
+/**********************************************************************
+* Function:			getFd
+* Purpose: 			Returns the descriptor to wait on for new frames
+* Precondition:		None
+* Postcondition:	Returns the read end of the pipe
+************************************************************************/
+int pipeFrameSource::getFd()
+{
+	return fd;
+}
+
+/**********************************************************************
+* Function:			next
+* Purpose: 			Reads whatever part of the current frame has arrived
+* Precondition:		None
+* Postcondition:	Returns true with frame pointing at the buffer once a whole frame is read. The buffer is
+*					reused for the next frame, so the pixels change on the following call. isOpen() turns false
+*					once the writer closes.
+************************************************************************/
+bool pipeFrameSource::next(guideFrame &frame)
+{
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (filled == buffer.size())
+	{
+		filled = 0;
+	}
+
+	ssize_t length = -1;
+	while (filled < buffer.size() && (length = read(fd, buffer.data() + filled, buffer.size() - filled)) > 0)
+	{
+		if (filled == 0)
+		{
+			arrival = eventLoop::now();
+		}
+		filled += (size_t)length;
+	}
+	//Zero is end of file, the writer has gone and the descriptor would otherwise stay readable forever
+	if (length == 0)
+	{
+		ended = true;
+	}
+	if (filled < buffer.size())
+	{
+		return false;
+	}
+
+	frame.pixels = buffer.data();
+	frame.format = format;
+	frame.arrivalNanos = arrival;
+	frame.sequence = ++sequence;
+
+	return true;
+}
@@ -0,0 +1,132 @@
+/*************************************************************
+* Filename:			guideCamera.h
+* Purpose:			Receive raw guide camera frames from a directory or a pipe without copying them
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//uint8_t, int64_t, uint64_t
+#include <stddef.h>		//size_t
+#include <string>		//std::string
+#include <vector>		//std::vector
+
+/************************************************************************
+* Struct: 		frameFormat
+* Purpose:		Layout of a raw frame, there is no header in the data
+* Data members:	width / height	- Pixels
+*				bytesPerPixel	- 1 for 8 bit, 2 for 16 bit little endian
+*************************************************************************/
+typedef struct frameFormat
+{
+	int width;
+	int height;
+	int bytesPerPixel;
+} frameFormat;
+
+/************************************************************************
+* Struct: 		guideFrame
+* Purpose:		One frame handed to the guider, the pixels belong to the source and stay valid until its next
+*				call to next()
+* Data members:	pixels			- Row after row, no padding
+*				format			- Size and depth
+*				arrivalNanos	- CLOCK_MONOTONIC time the source first saw the frame
+*				sequence		- Count of frames delivered, starting at 1
+*************************************************************************/
+typedef struct guideFrame
+{
+	const uint8_t *pixels;
+	frameFormat format;
+	int64_t arrivalNanos;
+	uint64_t sequence;
+} guideFrame;
+
+/************************************************************************
+* Class: 		frameSource
+* Purpose:		Interface for where guide frames come from. getFd() becomes readable when a frame may be
+*				ready, so a source can be awaited on the eventLoop like the keyboard.
+* Data members:	none
+* Methods:		isOpen
+*				getFd
+*				next
+*************************************************************************/
+class frameSource
+{
+	public:
+		virtual ~frameSource() {}
+
+		virtual bool isOpen() = 0;
+		virtual int getFd() = 0;
+		//Never blocks, returns true and fills frame if a new one is complete
+		virtual bool next(guideFrame &frame) = 0;
+};
+
+/************************************************************************
+* Class: 		directoryFrameSource
+* Purpose:		Frames written as files into a directory by the capture program. inotify reports each file
+*				once it is closed, and the newest one is mapped straight from the page cache. Older files
+*				that arrived in the same wakeup are skipped, the guider only wants the latest star position.
+* Data members:	directory	- Watched directory
+*				format		- Expected frame layout, files of any other size are skipped
+*				notifyFd	- inotify descriptor
+*				mapping		- Current frame's mapping, nullptr if none
+*				mappedBytes	- Size of the mapping
+*				sequence	- Frames delivered
+*
+* Methods:		isOpen
+*************************************************************************/
+class directoryFrameSource : public frameSource
+{
+	public:
+		directoryFrameSource(const char *directory, frameFormat format);
+		~directoryFrameSource();
+
+		bool isOpen() { return notifyFd >= 0; }
+		int getFd();
+		bool next(guideFrame &frame);
+
+	private:
+		void release();
+
+		std::string directory;
+		frameFormat format;
+		int notifyFd;
+		void *mapping;
+		size_t mappedBytes;
+		uint64_t sequence;
+};
+
+/************************************************************************
+* Class: 		pipeFrameSource
+* Purpose:		Frames streamed back to back through a pipe or FIFO. Each frame is read into one buffer that is
+*				reused, the only copy being the kernel's. Partial reads are kept until the frame is whole.
+* Data members:	fd			- Read end, non-blocking
+*				ownsFd		- True if it was opened here and must be closed
+*				ended		- Set once every writer has closed its end
+*				format		- Frame layout
+*				buffer		- The frame being read
+*				filled		- Bytes of it read so far
+*				arrival		- When its first bytes were read
+*				sequence	- Frames delivered
+*
+* Methods:		isOpen
+*************************************************************************/
+class pipeFrameSource : public frameSource
+{
+	public:
+		pipeFrameSource(const char *path, frameFormat format);
+		pipeFrameSource(int fd, frameFormat format);
+		~pipeFrameSource();
+
+		bool isOpen() { return fd >= 0 && !ended; }
+		int getFd();
+		bool next(guideFrame &frame);
+
+	private:
+		int fd;
+		bool ownsFd;
+		bool ended;
+		frameFormat format;
+		std::vector<uint8_t> buffer;
+		size_t filled;
+		int64_t arrival;
+		uint64_t sequence;
+};
@@ -10,6 +10,11 @@
 
 #include "sidereal.h"	//Custom class for calculating time and time angles
 #include "coordinate.h" //Custom class for calculating coordinates and reference frames
+#include "observingScheduler.h" //Orders and runs an observing list
+#include "mountController.h"	//Event loop that runs the telescope, controller pins
+#include "plateSolver.h"		//Blind alignment from finder camera stars
+#include "simulations.h"		//Benchmarks and simulations, no hardware needed
+#include <string>		//std::string
 #include <chrono>		//Used for testing
 #include <thread>		//Used for testing
 
@@ -17,61 +22,85 @@ using std::cout;
 using std::endl;
 using std::fixed;
 
-//Stepper motor 1 - Horizontal
-#define	ENA1 2
-#define DIR1 3
-#define PUL1 4
-
-//Stepper motor 2 - Vertical
-#define ENA2 17
-#define DIR2 27
-#define PUL2 22
-
-//#define _DELAY 64
-#define _DELAY 100
-#define _STEPS 1600
-#define _GEAR_RATIO 100 * 2.5
-#define _STEPRESOLUTION _STEPS * _GEAR_RATIO
-#define _STEPSIZE 1/_STEPRESOLUTION
-//Controller pins
-#define D_BTN 5
-#define C_BTN 6
-#define B_BTN 13
-#define A_BTN 19
-
-int main(void)
+/**********************************************************************
+* Function:			usage
+* Purpose: 			Prints every mode and its arguments
+* Precondition:		Pass in argv[0]
+* Postcondition:	Returns 1 so main can return it
+************************************************************************/
+static int usage(const char *program)
 {
-	int stepsPerRev = _STEPS * _GEAR_RATIO;
-	bool myBool = false;
-	
-	//Initialize GPIO
-	gpioInitialise();
+	cout << "Usage: " << program << " [observing list]" << endl;
+	cout << "       " << program << " --build-index catalog [index]" << endl;
+	cout << "       " << program << " --solve centroids [index]" << endl;
+	simulations::printUsage(program);
+	return 1;
+}
 
-	//Set up GPIO pins for stepper motor
-	gpioSetMode(ENA1, PI_OUTPUT);
-	gpioSetMode(DIR1, PI_OUTPUT);
-	gpioSetMode(PUL1, PI_OUTPUT);
+int main(int argc, char *argv[])
+{
+	int stepsPerRev = (int)azKinematics::stepsPerRev;
+	bool myBool = false;
+	std::string mode = (argc > 1) ? argv[1] : "";
 
-	//Set up GPIO pins for stepper motor
-	gpioSetMode(ENA2, PI_OUTPUT);
-	gpioSetMode(DIR2, PI_OUTPUT);
-	gpioSetMode(PUL2, PI_OUTPUT);
+	//Benchmarks and simulations are all handled in one place
+	int testResult = simulations::run(argc, argv);
+	if (testResult != NOT_A_TEST_MODE)
+	{
+		return testResult;
+	}
 
-	//Set Controller pins to input
-	gpioSetMode(D_BTN, PI_INPUT);
-	gpioSetMode(C_BTN, PI_INPUT);
-	gpioSetMode(B_BTN, PI_INPUT);
-	gpioSetMode(A_BTN, PI_INPUT);
+	//Build a plate solving index from a star catalog: --build-index catalog [index]
+	if (mode == "--build-index")
+	{
+		if (argc < 3 || argc > 4)
+		{
+			return usage(argv[0]);
+		}
+
+		const char *indexPath = (argc > 3) ? argv[3] : STAR_INDEX_DEFAULT_PATH;
+		std::vector<catalogStar> catalog = starIndex::loadCatalog(argv[2]);
+		bool built = !catalog.empty() && starIndex::build(catalog, indexPath);
+		cout << (built ? "Wrote " : "Could not write ") << indexPath << " from " << catalog.size() << " stars" << endl;
+		return built ? 0 : 1;
+	}
 
-	//Start at 0
-	gpioWrite(ENA1, PI_LOW);
-	gpioWrite(DIR1, PI_LOW);
-	gpioWrite(PUL1, PI_LOW);
+	//Plate solve a finder camera frame: --solve centroids [index]
+	if (mode == "--solve")
+	{
+		if (argc < 3 || argc > 4)
+		{
+			return usage(argv[0]);
+		}
+
+		starIndex index;
+		centroidList frame;
+		if (!index.open((argc > 3) ? argv[3] : STAR_INDEX_DEFAULT_PATH) || !plateSolver::loadCentroids(argv[2], frame))
+		{
+			cout << "Could not read the index or " << argv[2] << endl;
+			return 1;
+		}
+
+		plateSolution solution = plateSolver(index).solve(frame);
+		if (!solution.solved)
+		{
+			cout << "No solution, " << solution.tried << " quads tried in " << solution.seconds * 1000.0 << "ms" << endl;
+			return 1;
+		}
+		cout << "RA " << solution.raDec.x << " Dec " << solution.raDec.y << " rotation " << solution.rotationDeg << " scale "
+			<< solution.arcsecPerPixel << "\"/px" << (solution.mirrored ? " mirrored" : "") << ", " << solution.matched
+			<< " stars matched in " << solution.seconds * 1000.0 << "ms" << endl;
+		return 0;
+	}
 
-	//Start at 0
-	gpioWrite(ENA2, PI_LOW);
-	gpioWrite(DIR2, PI_LOW);
-	gpioWrite(PUL2, PI_LOW);
+	//Anything else that looks like an option is a typo, not an observing list to drive the mount with
+	if (mode.rfind("-", 0) == 0 || argc > 2)
+	{
+		return usage(argv[0]);
+	}
+	
+	//Initialize GPIO
+	gpioInitialise();
 
 	//Custom coordinates 
 	degreeMinuteSeconds latitude;
@@ -100,93 +129,64 @@ int main(void)
 	twoAxisDeg temp;
 	twoAxisDms AltAz;
 
+	//Motor pins are set up by coordinate from the default mountConfig
 	coordinate telescope;
-	while (1)
+
+	//Resume from the saved state if the motors were never released, otherwise align by hand. A config with no
+	//state file path runs without saving anything.
+	stateFile savedState;
+	const char *statePath = telescope.getConfig().stateFilePath;
+	bool opened = statePath != nullptr && savedState.open(statePath);
+	bool resumed = telescope.attachStateFile(opened ? &savedState : nullptr);
+	telescope.setMotorsEnabled(true);
+
+	//An observing list file on the command line is ordered and run, otherwise take commands from the keyboard
+	if (argc > 1)
 	{
-		telescope.manualControl();
-		telescope.calibrate(latLong);
-		telescope.gotoCoordsDeg(RaDecInput);
-		//Get local sidereal time using getGMSTinRads() and longitude in degrees
-		//double LMST = sidereal::getLMST(sidereal::getGMSTinRads(),-longitudeDeg);
-		//cout << "Current Time (UTC/GMT): ";	sidereal::displayHHMMSS(sidereal::getGMT());
-		////Status for console
-		//cout << endl << endl;
-		//cout << "Lat: " << latitudeDeg << " Long: " << longitudeDeg << endl;
-		//cout << fixed << sidereal::getJulianDate() << endl;
-		//cout << fixed << "GMST = " << sidereal::getGMSTinRads() << " (in Radians)" << endl;
-		//cout << "LMST in Deg: " << LMST << endl;
-
-		//cout << "LMST: ";
-		//sidereal::displayHHMMSS(sidereal::degToHms(LMST));	
-		//cout << "RA Deg input: " << RaDecInput.x << " Dec Deg input: " << RaDecInput.y << endl;
-		//cout << "Moon RA:  "; sidereal::displayHHMMSS(sidereal::degToHms(RaDecInput.x));
-		//cout << "Moon Dec: "; sidereal::displayDms(sidereal::degToDms(RaDecInput.y));
-
-		//temp = coordinate::equatorialToLocal(RaDecInput.x, RaDecInput.y, latLong);
-		//AltAz.x = sidereal::degToDms(temp.x);
-		//AltAz.y = sidereal::degToDms(temp.y);
-		//cout << "Alt: " << temp.x << " Az: " << temp.y << endl;
-
-		//double ha = LMST - RaDecInput.x;
-
-
-
-		//				Begin Controller Code						//
-
-		//If Up or Down:
-		//
-		//if (!gpioRead(A_BTN))
-		//{
-		//	//Set Direction
-		//	gpioWrite(DIR2, PI_HIGH);
-		//	gpioDelay(_DELAY);
-
-		//	//Pulse
-		//	gpioWrite(PUL2, PI_HIGH);
-		//	gpioDelay(_DELAY);
-		//	gpioWrite(PUL2, PI_LOW);
-		//	gpioDelay(_DELAY);
-		//}
-		//else if (!gpioRead(C_BTN))
-		//{
-		//	//Set Direction
-		//	gpioWrite(DIR2, PI_LOW);
-		//	gpioDelay(_DELAY);
-
-		//	//Pulse
-		//	gpioWrite(PUL2, PI_HIGH);
-		//	gpioDelay(_DELAY);
-		//	gpioWrite(PUL2, PI_LOW);
-		//	gpioDelay(_DELAY);
-
-		//}
-
-		////If Left or Right
-		//if (!gpioRead(D_BTN))
-		//{
-		//	//Set Direction Left
-		//	gpioWrite(DIR1, PI_HIGH);
-		//	gpioDelay(_DELAY);
-
-		//	//Pulse
-		//	gpioWrite(PUL1, PI_HIGH);
-		//	gpioDelay(_DELAY);
-		//	gpioWrite(PUL1, PI_LOW);
-		//	gpioDelay(_DELAY);
-		//}
-		//else if (!gpioRead(B_BTN))
-		//{
-		//	//Set Direction Right
-		//	gpioWrite(DIR1, PI_LOW);
-		//	gpioDelay(_DELAY);
-
-		//	gpioWrite(PUL1, PI_HIGH);
-		//	gpioDelay(_DELAY);
-		//	gpioWrite(PUL1, PI_LOW);
-		//	gpioDelay(_DELAY);
-		//}
-		//				End Controller Code							//
+		if (!resumed)
+		{
+			telescope.manualControl();
+			telescope.calibrate(latLong);
+		}
+
+		std::vector<observingTarget> targets = observingScheduler::loadTargets(argv[1]);
+		observingScheduler scheduler(telescope);
+		double now = sidereal::getJulianDate();
+		observingPlan plan = scheduler.plan(targets, now, now + 0.5);
+
+		cout << "Scheduled " << plan.order.size() << " targets, skipped " << plan.skipped.size() << endl;
+		cout << "Slewing: " << plan.totalSlewSeconds << "s Waiting: " << plan.totalWaitSeconds << "s" << endl;
+		scheduler.execute(targets, plan);
 	}
+	else
+	{
+		//Align with w/a/s/d and calibrate unless resumed, then goto the test target or any other
+		mountController controller(telescope, pigpioDriver::instance(), latLong, RaDecInput);
+		controller.run(resumed && telescope.isTracking());
+	}
+
+	//Get local sidereal time using getGMSTinRads() and longitude in degrees
+	//double LMST = sidereal::getLMST(sidereal::getGMSTinRads(),-longitudeDeg);
+	//cout << "Current Time (UTC/GMT): ";	sidereal::displayHHMMSS(sidereal::getGMT());
+	////Status for console
+	//cout << endl << endl;
+	//cout << "Lat: " << latitudeDeg << " Long: " << longitudeDeg << endl;
+	//cout << fixed << sidereal::getJulianDate() << endl;
+	//cout << fixed << "GMST = " << sidereal::getGMSTinRads() << " (in Radians)" << endl;
+	//cout << "LMST in Deg: " << LMST << endl;
+
+	//cout << "LMST: ";
+	//sidereal::displayHHMMSS(sidereal::degToHms(LMST));	
+	//cout << "RA Deg input: " << RaDecInput.x << " Dec Deg input: " << RaDecInput.y << endl;
+	//cout << "Moon RA:  "; sidereal::displayHHMMSS(sidereal::degToHms(RaDecInput.x));
+	//cout << "Moon Dec: "; sidereal::displayDms(sidereal::degToDms(RaDecInput.y));
+
+	//temp = coordinate::equatorialToLocal(RaDecInput.x, RaDecInput.y, latLong);
+	//AltAz.x = sidereal::degToDms(temp.x);
+	//AltAz.y = sidereal::degToDms(temp.y);
+	//cout << "Alt: " << temp.x << " Az: " << temp.y << endl;
+
+	//double ha = LMST - RaDecInput.x;
 
 	gpioTerminate();
 	return 0;
@@ -0,0 +1,102 @@
+/*************************************************************
+* Filename:			mountConfig.h
+* Purpose:			Pin and site settings for one mount, so several mounts can run from one program
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t
+#include "stateFile.h"	//STATE_FILE_PATH
+#include "pecTable.h"	//DEFAULT_PEC_PERIOD_STEPS, DEFAULT_ALT_PEC_PATH, DEFAULT_AZ_PEC_PATH
+
+//Stepper motor 1 - Horizontal
+#define DEFAULT_AZ_ENA 2
+#define DEFAULT_AZ_DIR 3
+#define DEFAULT_AZ_PUL 4
+
+//Stepper motor 2 - Vertical
+#define DEFAULT_ALT_ENA 17
+#define DEFAULT_ALT_DIR 27
+#define DEFAULT_ALT_PUL 22
+
+//Microstep mode pins, the current drivers are set by DIP switch so mode switching is off
+#define NO_PIN -1
+
+/************************************************************************
+* Struct: 		axisPins
+* Purpose:		GPIO pins of one stepper driver
+* Data members:	ena				- Enable pin, low holds the motor
+*				dir				- Direction pin
+*				pul				- Step pulse pin
+*				mode			- Up to three microstep mode pins (MS1 - MS3 / M0 - M2), NO_PIN if not wired
+*				fineModeBits	- Mode pin levels for fine microstepping, bit 0 = mode[0]
+*				coarseModeBits	- Mode pin levels for coarse microstepping
+*				backlashSteps	- Fine microsteps of slack taken up when the axis reverses
+*************************************************************************/
+typedef struct axisPins
+{
+	unsigned ena;
+	unsigned dir;
+	unsigned pul;
+	int mode[3];
+	unsigned fineModeBits;
+	unsigned coarseModeBits;
+	int64_t backlashSteps;
+} axisPins;
+
+/************************************************************************
+* Struct: 		mountConfig
+* Purpose:		Everything that differs between two mounts run by the same program
+* Data members:	name			- Shown in console output
+*				azPins			- Pins of the horizontal (azimuth) driver
+*				altPins			- Pins of the vertical (altitude) driver
+*				stateFilePath	- Where the mount state is saved, nullptr to not save it
+*				altPecPath / azPecPath	- Where each axis' PEC table is saved, nullptr to not save it
+*				pecPeriodSteps	- Motor microsteps in one period of the gearbox error
+*************************************************************************/
+typedef struct mountConfig
+{
+	const char *name;
+	axisPins azPins;
+	axisPins altPins;
+	const char *stateFilePath;
+	const char *altPecPath;
+	const char *azPecPath;
+	int64_t pecPeriodSteps;
+} mountConfig;
+
+/**********************************************************************
+* Function:			defaultMountConfig
+* Purpose: 			Returns the settings of the original single telescope
+* Precondition:		None
+* Postcondition:	Returns a mountConfig using the default pins and state file
+************************************************************************/
+inline mountConfig defaultMountConfig()
+{
+	mountConfig config;
+	config.name = "telescope";
+	config.azPins.ena = DEFAULT_AZ_ENA;
+	config.azPins.dir = DEFAULT_AZ_DIR;
+	config.azPins.pul = DEFAULT_AZ_PUL;
+	config.altPins.ena = DEFAULT_ALT_ENA;
+	config.altPins.dir = DEFAULT_ALT_DIR;
+	config.altPins.pul = DEFAULT_ALT_PUL;
+
+	//No mode pins or backlash until they are wired and measured
+	for (int i = 0; i < 3; i++)
+	{
+		config.azPins.mode[i] = NO_PIN;
+		config.altPins.mode[i] = NO_PIN;
+	}
+	config.azPins.fineModeBits = 0;
+	config.azPins.coarseModeBits = 0;
+	config.azPins.backlashSteps = 0;
+	config.altPins.fineModeBits = 0;
+	config.altPins.coarseModeBits = 0;
+	config.altPins.backlashSteps = 0;
+	config.stateFilePath = STATE_FILE_PATH;
+	config.altPecPath = DEFAULT_ALT_PEC_PATH;
+	config.azPecPath = DEFAULT_AZ_PEC_PATH;
+	config.pecPeriodSteps = DEFAULT_PEC_PERIOD_STEPS;
+
+	return config;
+}
@@ -0,0 +1,567 @@
+/*************************************************************
+* Filename:			mountController.cpp
+* Purpose:			Run one telescope from an event loop, taking commands while it slews and tracks
+**************************************************************/
+#include "mountController.h"
+
+#include <unistd.h>		//read(), STDIN_FILENO
+#include <sstream>		//std::istringstream
+#include <sys/stat.h>	//stat(), S_ISDIR()
+
+/**********************************************************************
+* Function:			mountController (constructor)
+* Purpose: 			Sets up the controller buttons
+* Precondition:		Pass in the telescope, the driver its buttons are on, the site, and the target of a bare goto.
+*					The telescope and driver must outlive the controller.
+* Postcondition:	Button pins are inputs, nothing runs until run()
+************************************************************************/
+mountController::mountController(coordinate &mount, gpioDriver *gpio, twoAxisDeg latLong, twoAxisDeg defaultTarget) :
+	mount(mount), gpio(gpio), latLong(latLong), defaultTarget(defaultTarget)
+{
+	gpio->setMode(A_BTN, PI_INPUT);
+	gpio->setMode(B_BTN, PI_INPUT);
+	gpio->setMode(C_BTN, PI_INPUT);
+	gpio->setMode(D_BTN, PI_INPUT);
+}
+
+/**********************************************************************
+* Function:			run
+* Purpose: 			Runs the telescope until the quit command
+* Precondition:		Pass in true to carry on tracking the target saved in the state file
+* Postcondition:	Returns after quit, tracking is stopped and the state saved
+************************************************************************/
+void mountController::run(bool resumeTracking)
+{
+	cout << "Commands: w/a/s/d [steps], calibrate [centroidFile], goto [raDeg decDeg], survey raDeg decDeg widthDeg heightDeg fovWidthDeg fovHeightDeg [overlap dwellSeconds], stop, guide dir|fifo [width height bytes]|off, pec off|record|play, status, quit" << endl;
+
+	loop.spawn(commandTask());
+	loop.spawn(buttonTask());
+	loop.spawn(telemetryTask());
+	if (resumeTracking)
+	{
+		cout << "Resuming tracking from saved state" << endl;
+		startGoto(mount.getTargetRaDec());
+	}
+
+	loop.run();
+	cancelGoto();
+}
+
+/**********************************************************************
+* Function:			startGoto
+* Purpose: 			Slews to and tracks a new target
+* Precondition:		The telescope must be calibrated, pass in the target RA / Dec in degrees
+* Postcondition:	Any running goto is cancelled first, the new one runs as its own task
+************************************************************************/
+void mountController::startGoto(twoAxisDeg targetRaDec)
+{
+	cancelGoto();
+
+	gotoToken = std::make_shared<cancelToken>();
+	gotoToken->cancelled = false;
+	loop.spawn(gotoTask(targetRaDec, gotoToken));
+}
+
+/**********************************************************************
+* Function:			cancelGoto
+* Purpose: 			Stops the running goto where the mount is
+* Precondition:		None
+* Postcondition:	Tracking has ended and the state is saved now, the task itself ends the next time it wakes
+*					without touching the mount again
+************************************************************************/
+void mountController::cancelGoto()
+{
+	cancelGuide();
+	if (gotoToken != nullptr)
+	{
+		gotoToken->cancelled = true;
+		gotoToken = nullptr;
+		mount.endTrack();
+	}
+}
+
+/**********************************************************************
+* Function:			startJog
+* Purpose: 			Moves each axis by a number of fine microsteps without holding up the other tasks
+* Precondition:		Pass in signed microsteps, positive is up / right
+* Postcondition:	Any running goto is cancelled first, the jog runs as its own task in place of a goto so
+*					stop, a new goto, or a button press cancels it
+************************************************************************/
+void mountController::startJog(int64_t altSteps, int64_t azSteps)
+{
+	cancelGoto();
+
+	gotoToken = std::make_shared<cancelToken>();
+	gotoToken->cancelled = false;
+	loop.spawn(jogTask(altSteps, azSteps, gotoToken));
+}
+
+/**********************************************************************
+* Function:			startSurvey
+* Purpose: 			Plans a mosaic of a region and runs it
+* Precondition:		The telescope must be calibrated, pass in the region and the field of each tile
+* Postcondition:	Returns false if the region could not be tiled. Otherwise any running goto is cancelled, the
+*					plan is printed, and it runs as its own task in place of a goto.
+************************************************************************/
+bool mountController::startSurvey(surveyRegion region, surveyField field)
+{
+	cancelGoto();
+
+	surveyPlanner planner(mount);
+	surveyPlan plan = planner.plan(region, field, sidereal::getJulianDate());
+	surveyPlanner::printPlan(plan);
+	if (plan.tiles.empty())
+	{
+		return false;
+	}
+
+	gotoToken = std::make_shared<cancelToken>();
+	gotoToken->cancelled = false;
+	loop.spawn(surveyTask(plan, gotoToken));
+	return true;
+}
+
+/**********************************************************************
+* Function:			startGuide
+* Purpose: 			Guides the current target from a guide camera
+* Precondition:		Pass in a directory the camera writes frame files into, or a FIFO it streams frames through,
+*					and the frame layout
+* Postcondition:	Returns false if the source could not be opened. Otherwise any running guide task is
+*					cancelled and a new one corrects the mount from every frame.
+************************************************************************/
+bool mountController::startGuide(const std::string &path, frameFormat format)
+{
+	struct stat info;
+	std::shared_ptr<frameSource> source;
+	if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+	{
+		std::shared_ptr<directoryFrameSource> directory = std::make_shared<directoryFrameSource>(path.c_str(), format);
+		if (!directory->isOpen())
+		{
+			return false;
+		}
+		source = directory;
+	}
+	else
+	{
+		std::shared_ptr<pipeFrameSource> pipe = std::make_shared<pipeFrameSource>(path.c_str(), format);
+		if (!pipe->isOpen())
+		{
+			return false;
+		}
+		source = pipe;
+	}
+
+	cancelGuide();
+	guideToken = std::make_shared<cancelToken>();
+	guideToken->cancelled = false;
+	loop.spawn(guideTask(source, guideToken));
+	return true;
+}
+
+/**********************************************************************
+* Function:			cancelGuide
+* Purpose: 			Stops guiding
+* Precondition:		None
+* Postcondition:	The mount follows the target alone, the task ends the next time a frame wakes it
+************************************************************************/
+void mountController::cancelGuide()
+{
+	if (guideToken != nullptr)
+	{
+		guideToken->cancelled = true;
+		guideToken = nullptr;
+		mount.clearGuide();
+	}
+}
+
+/**********************************************************************
+* Function:			handleCommand
+* Purpose: 			Runs one line of keyboard input
+* Precondition:		Pass in the line without its newline
+* Postcondition:	Returns false for quit, true otherwise
+************************************************************************/
+bool mountController::handleCommand(const std::string &line)
+{
+	std::istringstream words(line);
+	std::string command;
+	if (!(words >> command))
+	{
+		return true;
+	}
+
+	if (command == "w" || command == "a" || command == "s" || command == "d")
+	{
+		int64_t steps;
+		if (!(words >> steps))
+		{
+			steps = JOG_DEFAULT_PULSES;
+		}
+		if (steps <= 0)
+		{
+			cout << "Jog steps must be a positive count" << endl;
+			return true;
+		}
+
+		if (command == "w")
+		{
+			startJog(steps, 0);
+		}
+		else if (command == "s")
+		{
+			startJog(-steps, 0);
+		}
+		else if (command == "a")
+		{
+			startJog(0, -steps);
+		}
+		else
+		{
+			startJog(0, steps);
+		}
+	}
+	else if (command == "calibrate")
+	{
+		//With a centroid file from the finder camera, plate solve it instead of using the fixed star
+		std::string centroidPath;
+		cancelGoto();
+		if (words >> centroidPath)
+		{
+			starIndex index;
+			centroidList frame;
+			if (!index.open(STAR_INDEX_DEFAULT_PATH) || !plateSolver::loadCentroids(centroidPath.c_str(), frame))
+			{
+				cout << "Could not read " << STAR_INDEX_DEFAULT_PATH << " or " << centroidPath << endl;
+				return true;
+			}
+
+			plateSolution solution = plateSolver(index).solve(frame);
+			if (!solution.solved)
+			{
+				cout << "No solution from " << solution.tried << " quads, still at the old alignment" << endl;
+				return true;
+			}
+			mount.calibrate(latLong, solution.raDec);
+			cout << "Solved RA " << solution.raDec.x << " Dec " << solution.raDec.y << " in " << solution.seconds * 1000.0 << "ms" << endl;
+		}
+		else
+		{
+			mount.calibrate(latLong);
+		}
+		cout << "Calibrated" << endl;
+	}
+	else if (command == "goto")
+	{
+		twoAxisDeg target = defaultTarget;
+		if (!(words >> target.x >> target.y))
+		{
+			target = defaultTarget;
+		}
+		startGoto(target);
+		cout << "Going to RA " << target.x << " Dec " << target.y << endl;
+	}
+	else if (command == "survey")
+	{
+		surveyRegion region;
+		surveyField field;
+		field.overlap = SURVEY_DEFAULT_OVERLAP;
+		field.dwellSeconds = SURVEY_DEFAULT_DWELL_SECONDS;
+		if (!(words >> region.centerRaDec.x >> region.centerRaDec.y >> region.widthDeg >> region.heightDeg >> field.widthDeg >> field.heightDeg))
+		{
+			cout << "Usage: survey raDeg decDeg widthDeg heightDeg fovWidthDeg fovHeightDeg [overlap dwellSeconds]" << endl;
+			return true;
+		}
+
+		//A failed read zeroes its variable, so the optional values go through temporaries
+		double overlap, dwellSeconds;
+		if (words >> overlap)
+		{
+			field.overlap = overlap;
+			if (words >> dwellSeconds)
+			{
+				field.dwellSeconds = dwellSeconds;
+			}
+		}
+		startSurvey(region, field);
+	}
+	else if (command == "stop")
+	{
+		cancelGoto();
+		cout << "Stopped" << endl;
+	}
+	else if (command == "guide")
+	{
+		std::string path;
+		frameFormat format = { GUIDE_FRAME_WIDTH, GUIDE_FRAME_HEIGHT, GUIDE_FRAME_BYTES };
+		if (!(words >> path) || path == "off")
+		{
+			cancelGuide();
+			cout << "Guiding off" << endl;
+			return true;
+		}
+		if (!(words >> format.width >> format.height >> format.bytesPerPixel))
+		{
+			format = { GUIDE_FRAME_WIDTH, GUIDE_FRAME_HEIGHT, GUIDE_FRAME_BYTES };
+		}
+		if (!mount.isTracking())
+		{
+			cout << "Goto a target before guiding" << endl;
+		}
+		else if (!startGuide(path, format))
+		{
+			cout << "Could not open " << path << endl;
+		}
+		else
+		{
+			cout << "Guiding from " << path << endl;
+		}
+	}
+	else if (command == "pec")
+	{
+		std::string mode;
+		words >> mode;
+		if (mode == "record")
+		{
+			mount.setPecMode(PEC_RECORD);
+		}
+		else if (mode == "play")
+		{
+			mount.setPecMode(PEC_PLAYBACK);
+		}
+		else
+		{
+			mount.setPecMode(PEC_OFF);
+		}
+		const char *names[] = { "off", "record", "play" };
+		cout << "PEC " << names[mount.getPecMode()] << endl;
+	}
+	else if (command == "status")
+	{
+		twoAxisDeg altAz = mount.getCurrentAltAz();
+		cout << "Alt: " << altAz.x << " Az: " << altAz.y << (mount.isTracking() ? " tracking" : " idle")
+			<< ((guideToken != nullptr) ? " guiding" : "")
+			<< " Missed deadlines: " << mount.getMissedDeadlines() << endl;
+	}
+	else if (command == "quit" || command == "x")
+	{
+		cout << "Exiting..." << endl;
+		return false;
+	}
+	else
+	{
+		cout << "Unknown command: " << command << endl;
+	}
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			commandTask
+* Purpose: 			Reads keyboard commands without blocking the other tasks
+* Precondition:		Spawned by run()
+* Postcondition:	Stops the loop on quit, ends quietly at end of input so tracking carries on
+************************************************************************/
+asyncTask mountController::commandTask()
+{
+	char buffer[256];
+	while (true)
+	{
+		co_await loop.readable(STDIN_FILENO);
+		ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+		if (count <= 0)
+		{
+			co_return;
+		}
+		inputBuffer.append(buffer, count);
+
+		size_t newline;
+		while ((newline = inputBuffer.find('\n')) != std::string::npos)
+		{
+			std::string line = inputBuffer.substr(0, newline);
+			inputBuffer.erase(0, newline + 1);
+			if (!handleCommand(line))
+			{
+				loop.stop();
+				co_return;
+			}
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			buttonTask
+* Purpose: 			Jogs the mount while a hand controller button is held
+* Precondition:		Spawned by run()
+* Postcondition:	Never ends. A press cancels a running goto, the step counters follow the jog.
+************************************************************************/
+asyncTask mountController::buttonTask()
+{
+	while (true)
+	{
+		co_await loop.sleepFor(BUTTON_POLL_SECONDS);
+
+		int altSteps = 0;
+		int azSteps = 0;
+		if (!gpio->read(A_BTN))
+		{
+			altSteps = -JOG_PULSES_PER_POLL;
+		}
+		else if (!gpio->read(C_BTN))
+		{
+			altSteps = JOG_PULSES_PER_POLL;
+		}
+		if (!gpio->read(D_BTN))
+		{
+			azSteps = -JOG_PULSES_PER_POLL;
+		}
+		else if (!gpio->read(B_BTN))
+		{
+			azSteps = JOG_PULSES_PER_POLL;
+		}
+
+		if (altSteps != 0 || azSteps != 0)
+		{
+			cancelGoto();
+			mount.jog(altSteps, azSteps);
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			telemetryTask
+* Purpose: 			Prints where the mount is pointed now and then
+* Precondition:		Spawned by run()
+* Postcondition:	Never ends
+************************************************************************/
+asyncTask mountController::telemetryTask()
+{
+	while (true)
+	{
+		co_await loop.sleepFor(TELEMETRY_SECONDS);
+
+		if (mount.isTracking())
+		{
+			twoAxisDeg altAz = mount.getCurrentAltAz();
+			twoAxisDeg raDec = mount.getTargetRaDec();
+			cout << "Tracking RA " << raDec.x << " Dec " << raDec.y << " at Alt: " << altAz.x << " Az: " << altAz.y
+				<< " Missed deadlines: " << mount.getMissedDeadlines() << endl;
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			gotoTask
+* Purpose: 			Slews to and tracks one target in slices, sleeping whenever the mount is on target
+* Precondition:		Spawned by startGoto(), pass in the target RA / Dec in degrees and its cancel token
+* Postcondition:	Ends when cancelled, without touching the mount since cancelGoto() already stopped it
+************************************************************************/
+asyncTask mountController::gotoTask(twoAxisDeg targetRaDec, std::shared_ptr<cancelToken> token)
+{
+	mount.beginTrack(targetRaDec, -1);
+
+	while (!token->cancelled && mount.isTracking())
+	{
+		//A full slice means the slew is still going, let the other tasks in and carry on
+		if (mount.updateTrack(TRACK_MAX_PULSES) == TRACK_MAX_PULSES)
+		{
+			co_await loop.yield();
+		}
+		else
+		{
+			co_await loop.sleepFor(TRACK_PERIOD_SECONDS);
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			jogTask
+* Purpose: 			Runs a keyboard jog in slices of JOG_PULSES_PER_POLL, the same as a held button
+* Precondition:		Spawned by startJog(), pass in signed microsteps and its cancel token
+* Postcondition:	Ends when cancelled or once both axes have moved the whole way
+************************************************************************/
+asyncTask mountController::jogTask(int64_t altSteps, int64_t azSteps, std::shared_ptr<cancelToken> token)
+{
+	while (!token->cancelled && (altSteps != 0 || azSteps != 0))
+	{
+		int64_t altSlice = (altSteps > JOG_PULSES_PER_POLL) ? JOG_PULSES_PER_POLL : (altSteps < -JOG_PULSES_PER_POLL) ? -JOG_PULSES_PER_POLL : altSteps;
+		int64_t azSlice = (azSteps > JOG_PULSES_PER_POLL) ? JOG_PULSES_PER_POLL : (azSteps < -JOG_PULSES_PER_POLL) ? -JOG_PULSES_PER_POLL : azSteps;
+		mount.jog(altSlice, azSlice);
+		altSteps -= altSlice;
+		azSteps -= azSlice;
+
+		co_await loop.yield();
+	}
+}
+
+/**********************************************************************
+* Function:			surveyTask
+* Purpose: 			Runs a survey in slices, sleeping whenever the mount is on a tile
+* Precondition:		Spawned by startSurvey(), pass in the plan and its cancel token
+* Postcondition:	Ends when cancelled, or after the last tile with tracking stopped and the time printed
+************************************************************************/
+asyncTask mountController::surveyTask(surveyPlan plan, std::shared_ptr<cancelToken> token)
+{
+	surveyPlanner survey(mount);
+	survey.begin(plan);
+	int announced = -1;
+
+	while (!token->cancelled && survey.isActive())
+	{
+		int pulses = survey.update(TRACK_MAX_PULSES);
+		if (survey.isActive() && survey.getTileIndex() != announced)
+		{
+			announced = survey.getTileIndex();
+			cout << "Tile " << (announced + 1) << " of " << plan.tiles.size() << " - RA: " << plan.tiles[announced].raDec.x
+				<< " Dec: " << plan.tiles[announced].raDec.y << endl;
+		}
+
+		//A full slice means a slew is still going, let the other tasks in and carry on
+		if (pulses == TRACK_MAX_PULSES)
+		{
+			co_await loop.yield();
+		}
+		else
+		{
+			co_await loop.sleepFor(TRACK_PERIOD_SECONDS);
+		}
+	}
+
+	if (!token->cancelled)
+	{
+		cout << "Survey finished in " << survey.getElapsedSeconds() << "s, planned " << plan.totalSeconds << "s" << endl;
+	}
+}
+
+/**********************************************************************
+* Function:			guideTask
+* Purpose: 			Corrects the mount from each guide camera frame as soon as it arrives
+* Precondition:		Spawned by startGuide(), pass in the frame source and its cancel token
+* Postcondition:	Ends when cancelled or the camera closes the FIFO. The task owns the source, so it is
+*					released only once nothing is waiting on its descriptor.
+************************************************************************/
+asyncTask mountController::guideTask(std::shared_ptr<frameSource> source, std::shared_ptr<cancelToken> token)
+{
+	autoGuider guider(defaultGuideConfig());
+	guideFrame frame;
+
+	while (!token->cancelled && source->isOpen())
+	{
+		co_await loop.readable(source->getFd());
+
+		while (!token->cancelled && source->next(frame))
+		{
+			bool wasLocked = guider.isLocked();
+			guider.processFrame(frame, &mount);
+			if (!wasLocked && guider.isLocked())
+			{
+				cout << "Guide star locked" << endl;
+			}
+		}
+	}
+
+	if (!token->cancelled)
+	{
+		cout << "Guide camera closed, tracking carries on at the last guide rate" << endl;
+	}
+	guider.printLatency();
+}
@@ -0,0 +1,88 @@
+/*************************************************************
+* Filename:			mountController.h
+* Purpose:			Run one telescope from an event loop, taking commands while it slews and tracks
+**************************************************************/
+#pragma once
+
+#include <memory>		//std::shared_ptr
+#include <string>		//std::string
+#include "eventLoop.h"	//eventLoop, asyncTask, cancelToken
+#include "coordinate.h"	//coordinate, gpioDriver
+#include "plateSolver.h"	//Calibrate from a finder camera frame
+#include "autoGuider.h"	//Guide camera corrections while tracking
+#include "surveyPlanner.h"	//Mosaics run as one track
+
+//Controller pins, pulled low while a button is held
+#define D_BTN 5
+#define C_BTN 6
+#define B_BTN 13
+#define A_BTN 19
+
+//Task timing
+#define TRACK_PERIOD_SECONDS 0.02		//Wake-up rate while on target, well under one microstep of sidereal motion
+#define TRACK_MAX_PULSES 64				//Pulses per slice of a slew before other tasks get a turn
+#define BUTTON_POLL_SECONDS 0.02
+#define JOG_PULSES_PER_POLL 50			//10ms of pulses at 5kHz while a button is held
+#define JOG_DEFAULT_PULSES 1000			//A keyboard jog, the same as manualControl()
+#define TELEMETRY_SECONDS 10.0
+
+//Guide camera frame layout when the guide command does not give one
+#define GUIDE_FRAME_WIDTH 640
+#define GUIDE_FRAME_HEIGHT 480
+#define GUIDE_FRAME_BYTES 2
+
+/************************************************************************
+* Class: 		mountController
+* Purpose:		Replaces the blocking manualControl / calibrate / gotoCoordsDeg sequence with cooperative tasks
+*				on one eventLoop: keyboard commands, the hand controller buttons, telemetry, and one goto
+*				or survey at a time that can be cancelled by a new one, stop, or a button press.
+* Data members:	loop			- Runs every task
+*				mount			- The telescope
+*				gpio			- Reads the controller buttons
+*				latLong			- Site used by calibrate
+*				defaultTarget	- Target of a goto with no coordinates
+*				gotoToken		- Cancels the running goto, survey or keyboard jog, null if none
+*				guideToken		- Cancels the running guide task, null if none
+*				inputBuffer		- Keyboard input not yet ending in a newline
+*
+* Methods:		run
+*				startGoto
+*				cancelGoto
+*				startJog
+*				startSurvey
+*				startGuide
+*				cancelGuide
+*				handleCommand
+*************************************************************************/
+class mountController
+{
+	public:
+		mountController(coordinate &mount, gpioDriver *gpio, twoAxisDeg latLong, twoAxisDeg defaultTarget);
+
+		void run(bool resumeTracking);
+		void startGoto(twoAxisDeg targetRaDec);
+		void cancelGoto();
+		void startJog(int64_t altSteps, int64_t azSteps);
+		bool startSurvey(surveyRegion region, surveyField field);
+		bool startGuide(const std::string &path, frameFormat format);
+		void cancelGuide();
+		bool handleCommand(const std::string &line);
+
+	private:
+		asyncTask commandTask();
+		asyncTask buttonTask();
+		asyncTask telemetryTask();
+		asyncTask gotoTask(twoAxisDeg targetRaDec, std::shared_ptr<cancelToken> token);
+		asyncTask jogTask(int64_t altSteps, int64_t azSteps, std::shared_ptr<cancelToken> token);
+		asyncTask surveyTask(surveyPlan plan, std::shared_ptr<cancelToken> token);
+		asyncTask guideTask(std::shared_ptr<frameSource> source, std::shared_ptr<cancelToken> token);
+
+		eventLoop loop;
+		coordinate &mount;
+		gpioDriver *gpio;
+		twoAxisDeg latLong;
+		twoAxisDeg defaultTarget;
+		std::shared_ptr<cancelToken> gotoToken;
+		std::shared_ptr<cancelToken> guideToken;
+		std::string inputBuffer;
+};
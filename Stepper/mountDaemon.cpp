@@ -0,0 +1,156 @@
+/*************************************************************
+* Filename:			mountDaemon.cpp
+* Purpose:			Run several mounts from one program, each on its own stepping thread
+**************************************************************/
+#include "mountDaemon.h"
+
+/**********************************************************************
+* Function:			mountDaemon (constructor)
+* Purpose: 			Creates a daemon with no mounts
+* Precondition:		Pass in the gpio driver every mount will use, it must outlive the daemon
+* Postcondition:	Mounts can be added
+************************************************************************/
+mountDaemon::mountDaemon(gpioDriver *gpio)
+{
+	this->gpio = gpio;
+}
+
+/**********************************************************************
+* Function:			~mountDaemon (destructor)
+* Purpose: 			Stops every mount before they are destroyed
+* Precondition:		None
+* Postcondition:	All stepping threads have ended
+************************************************************************/
+mountDaemon::~mountDaemon()
+{
+	stop();
+}
+
+/**********************************************************************
+* Function:			addMount
+* Purpose: 			Adds a mount on its own pins
+* Precondition:		Pins must not be shared with another mount, the daemon must not be running
+* Postcondition:	Returns the index of the new mount, its state file is attached if the config names one
+************************************************************************/
+int mountDaemon::addMount(mountConfig config)
+{
+	mountSlot slot;
+	slot.mount.reset(new coordinate(config, gpio));
+
+	if (config.stateFilePath != nullptr)
+	{
+		slot.state.reset(new stateFile());
+		if (slot.state->open(config.stateFilePath))
+		{
+			slot.mount->attachStateFile(slot.state.get());
+		}
+	}
+
+	mounts.push_back(std::move(slot));
+	return (int)mounts.size() - 1;
+}
+
+/**********************************************************************
+* Function:			getMount
+* Purpose: 			Returns one of the mounts
+* Precondition:		index must be below getMountCount()
+* Postcondition:	Returns a reference owned by the daemon
+************************************************************************/
+coordinate &mountDaemon::getMount(int index)
+{
+	return *mounts[index].mount;
+}
+
+/**********************************************************************
+* Function:			getMountCount
+* Purpose: 			Returns how many mounts were added
+* Precondition:		None
+* Postcondition:	Returns the count
+************************************************************************/
+int mountDaemon::getMountCount()
+{
+	return (int)mounts.size();
+}
+
+/**********************************************************************
+* Function:			calibrateAll
+* Purpose: 			Calibrates every mount at the same site
+* Precondition:		Every mount must be pointed at the calibration target
+* Postcondition:	Every mount knows where it is pointed
+************************************************************************/
+void mountDaemon::calibrateAll(twoAxisDeg latLong)
+{
+	for (int i = 0; i < (int)mounts.size(); i++)
+	{
+		mounts[i].mount->setMotorsEnabled(true);
+		mounts[i].mount->calibrate(latLong);
+	}
+}
+
+/**********************************************************************
+* Function:			start
+* Purpose: 			Starts one stepping thread per mount
+* Precondition:		Pass in at least one target, mounts must be calibrated and not already running
+* Postcondition:	Mount i slews to and tracks targets[i % size] for trackSeconds (negative for forever)
+************************************************************************/
+void mountDaemon::start(const std::vector<twoAxisDeg> &targets, double trackSeconds)
+{
+	catalog = targets;
+	if (catalog.empty())
+	{
+		return;
+	}
+
+	for (int i = 0; i < (int)mounts.size(); i++)
+	{
+		coordinate *mount = mounts[i].mount.get();
+		twoAxisDeg target = catalog[i % catalog.size()];
+
+		//Cleared here rather than in the thread, a stop() before the thread starts tracking must still count
+		mount->clearStop();
+
+		mounts[i].thread = std::thread([mount, target, trackSeconds]()
+		{
+			if (trackSeconds < 0)
+			{
+				mount->gotoCoordsDeg(target);
+			}
+			else
+			{
+				mount->gotoCoordsDeg(target, trackSeconds);
+			}
+		});
+	}
+}
+
+/**********************************************************************
+* Function:			stop
+* Purpose: 			Ends tracking on every mount
+* Precondition:		None
+* Postcondition:	All stepping threads have ended, the mounts stay where they are
+************************************************************************/
+void mountDaemon::stop()
+{
+	for (int i = 0; i < (int)mounts.size(); i++)
+	{
+		mounts[i].mount->requestStop();
+	}
+	join();
+}
+
+/**********************************************************************
+* Function:			join
+* Purpose: 			Waits for every stepping thread to finish on its own
+* Precondition:		None
+* Postcondition:	All stepping threads have ended
+************************************************************************/
+void mountDaemon::join()
+{
+	for (int i = 0; i < (int)mounts.size(); i++)
+	{
+		if (mounts[i].thread.joinable())
+		{
+			mounts[i].thread.join();
+		}
+	}
+}
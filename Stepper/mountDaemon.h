@@ -0,0 +1,61 @@
+/*************************************************************
+* Filename:			mountDaemon.h
+* Purpose:			Run several mounts from one program, each on its own stepping thread
+**************************************************************/
+#pragma once
+
+#include <vector>		//std::vector
+#include <memory>		//std::unique_ptr
+#include <thread>		//std::thread
+#include "coordinate.h"	//coordinate, mountConfig, gpioDriver
+
+/************************************************************************
+* Struct: 		mountSlot
+* Purpose:		One mount owned by the daemon
+* Data members:	mount	- The telescope
+*				state	- Its state file, empty if the config has no stateFilePath
+*				thread	- Stepping thread while running
+*************************************************************************/
+typedef struct mountSlot
+{
+	std::unique_ptr<coordinate> mount;
+	std::unique_ptr<stateFile> state;
+	std::thread thread;
+} mountSlot;
+
+/************************************************************************
+* Class: 		mountDaemon
+* Purpose:		Owns N mounts that share one gpio driver and one read-only target catalog. Time comes from the
+*				static sidereal functions, which every thread can call at once.
+* Data members:	gpio	- Driver shared by every mount, each mount uses its own pins
+*				mounts	- The mounts and their threads
+*				catalog	- Targets, mount i tracks catalog[i % size], not changed while running
+*
+* Methods:		addMount
+*				getMount
+*				getMountCount
+*				calibrateAll
+*				start
+*				stop
+*				join
+*************************************************************************/
+class mountDaemon
+{
+	public:
+		mountDaemon(gpioDriver *gpio);
+		~mountDaemon();
+
+		int addMount(mountConfig config);
+		coordinate &getMount(int index);
+		int getMountCount();
+
+		void calibrateAll(twoAxisDeg latLong);
+		void start(const std::vector<twoAxisDeg> &targets, double trackSeconds);
+		void stop();
+		void join();
+
+	private:
+		gpioDriver *gpio;
+		std::vector<mountSlot> mounts;
+		std::vector<twoAxisDeg> catalog;
+};
@@ -0,0 +1,610 @@
+/*************************************************************
+* Filename:			nightSimulation.cpp
+* Purpose:			Replay a whole night of tracking on a virtual clock and a modeled mount
+**************************************************************/
+#include "nightSimulation.h"
+
+#include <time.h>				//clock_gettime(), CLOCK_THREAD_CPUTIME_ID
+#include <chrono>				//std::chrono::steady_clock
+#include <random>				//std::mt19937, std::normal_distribution
+#include <thread>				//std::thread
+#include <mutex>				//std::mutex
+#include <condition_variable>	//std::condition_variable
+#include <unistd.h>				//pipe(), write(), close()
+#include <poll.h>				//poll()
+
+/**********************************************************************
+* Function:			nightSimulation (constructor)
+* Purpose: 			Sets up a simulation at a site and start time
+* Precondition:		Pass in the site latitude / longitude in degrees and UTC seconds since 1970 to start at
+* Postcondition:	Nothing runs until run()
+************************************************************************/
+nightSimulation::nightSimulation(twoAxisDeg latLong, double startUnixSeconds) : clock(startUnixSeconds)
+{
+	this->latLong = latLong;
+}
+
+/**********************************************************************
+* Function:			run
+* Purpose: 			Calibrates a modeled mount and tracks one target for a simulated night
+* Precondition:		Pass in the target RA / Dec in degrees, the hours to track, and the virtual seconds per tick.
+*					The target should stay above the horizon for the whole run.
+* Postcondition:	Returns the pointing error after the first slew and the cost of the run. The sidereal clock
+*					is the system clock again when this returns.
+************************************************************************/
+simulationReport nightSimulation::run(twoAxisDeg targetRaDec, double hours, double tickSeconds)
+{
+	simulationReport report = {};
+	report.simulatedHours = hours;
+
+	//The modeled mount, software pins with no delays and nothing saved to disk
+	softGpioDriver pins;
+	mountConfig config = defaultMountConfig();
+	config.name = "simulation";
+	config.stateFilePath = nullptr;
+	config.altPecPath = nullptr;
+	config.azPecPath = nullptr;
+	periodicErrorModel altGear(config.pecPeriodSteps, SIM_GEAR_ERROR_STEPS);
+	periodicErrorModel azGear(config.pecPeriodSteps, SIM_GEAR_ERROR_STEPS);
+
+	//Every time read of the tracking code goes through the virtual clock from here on
+	sidereal::setClock(&clock);
+	coordinate mount(config, &pins);
+	mount.calibrate(latLong);
+	mount.beginTrack(targetRaDec, -1);
+
+	int maxPulses = (int)(altKinematics::maxStepRate * tickSeconds);
+	if (maxPulses < 1)
+	{
+		maxPulses = 1;
+	}
+	int64_t ticks = (int64_t)(hours * 3600.0 / tickSeconds);
+	bool slewing = true;
+	double commandSquares = 0, pointingSquares = 0;
+
+	timespec cpuBegin, cpuEnd;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuBegin);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+	for (int64_t tick = 0; tick < ticks; tick++)
+	{
+		clock.advance(tickSeconds);
+		bool onTarget = stepTick(mount, pins, config, maxPulses);
+
+		if (slewing)
+		{
+			if (!onTarget)
+			{
+				continue;
+			}
+			slewing = false;
+			report.slewSeconds = (tick + 1) * tickSeconds;
+		}
+
+		//Where the target is now against where the counters, and the gears, say the mount points
+		twoAxisDeg errorDeg;
+		double command;
+		double pointing = pointingError(mount, targetRaDec, altGear, azGear, errorDeg, &command);
+
+		commandSquares += command * command;
+		pointingSquares += pointing * pointing;
+		report.commandMaxArcsec = (command > report.commandMaxArcsec) ? command : report.commandMaxArcsec;
+		report.pointingMaxArcsec = (pointing > report.pointingMaxArcsec) ? pointing : report.pointingMaxArcsec;
+		report.samples++;
+	}
+
+	report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+	report.cpuSeconds = (cpuEnd.tv_sec - cpuBegin.tv_sec) + (cpuEnd.tv_nsec - cpuBegin.tv_nsec) / 1e9;
+	report.pulses = pins.getPulses(config.altPins.pul) + pins.getPulses(config.azPins.pul);
+
+	if (report.samples > 0)
+	{
+		report.commandRmsArcsec = sqrt(commandSquares / report.samples);
+		report.pointingRmsArcsec = sqrt(pointingSquares / report.samples);
+	}
+
+	mount.endTrack();
+	sidereal::setClock(nullptr);
+	return report;
+}
+
+/**********************************************************************
+* Function:			stepTick
+* Purpose: 			Lets the mount step for one tick of the virtual clock
+* Precondition:		Pass in a tracking mount, its software pins and config, and the most pulses each axis may make
+* Postcondition:	Returns true if both axes reached the target within the tick. One pass of updateTrack() can
+*					pulse both axes, and several times on a reversal while the backlash is taken up, so the
+*					pins themselves are counted and the tick ends once either axis has used its pulses.
+************************************************************************/
+bool nightSimulation::stepTick(coordinate &mount, softGpioDriver &pins, const mountConfig &config, int maxPulses)
+{
+	uint64_t altEnd = pins.getPulses(config.altPins.pul) + maxPulses;
+	uint64_t azEnd = pins.getPulses(config.azPins.pul) + maxPulses;
+
+	while (pins.getPulses(config.altPins.pul) < altEnd && pins.getPulses(config.azPins.pul) < azEnd)
+	{
+		if (mount.updateTrack(1) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**********************************************************************
+* Function:			printReport
+* Purpose: 			Prints the results of a simulated night
+* Precondition:		Pass in a report from run()
+* Postcondition:	Errors, speed-up over real time, and CPU time per simulated hour are printed
+************************************************************************/
+void nightSimulation::printReport(simulationReport report)
+{
+	cout << "Simulated " << report.simulatedHours << " hours in " << report.wallSeconds << "s ("
+		<< (uint64_t)(report.simulatedHours * 3600.0 / report.wallSeconds) << "x real time)" << endl;
+	cout << "Slew: " << report.slewSeconds << "s, " << report.pulses << " pulses, " << report.samples << " samples" << endl;
+	cout << "Error\t\tRMS arcsec\tMax arcsec" << endl;
+	cout << "Counters\t" << report.commandRmsArcsec << "\t\t" << report.commandMaxArcsec << endl;
+	cout << "Pointing\t" << report.pointingRmsArcsec << "\t\t" << report.pointingMaxArcsec << endl;
+	cout << "CPU: " << report.cpuSeconds * 1000.0 / report.simulatedHours << "ms per simulated hour" << endl;
+}
+
+/**********************************************************************
+* Function:			benchmark
+* Purpose: 			Simulates one night from the test site
+* Precondition:		Pass in the hours to track and the virtual seconds per tick
+* Postcondition:	Tracks a target at Dec +60, which never sets from the test site, and prints the report
+************************************************************************/
+void nightSimulation::benchmark(double hours, double tickSeconds)
+{
+	twoAxisDeg latLong;
+	latLong.x = sidereal::dmsToDeg(42, 13, 29.53);
+	latLong.y = -sidereal::dmsToDeg(121, 46, 54.01);
+
+	nightSimulation simulation(latLong, SIM_START_UNIX);
+
+	//An hour east of the meridian at the start
+	virtualClock start(SIM_START_UNIX);
+	sidereal::setClock(&start);
+	twoAxisDeg target;
+	target.x = fmod(sidereal::getLMST(sidereal::getGMSTinRads(), latLong.y) + 15.0, 360.0);
+	target.y = 60.0;
+	sidereal::setClock(nullptr);
+
+	printReport(simulation.run(target, hours, tickSeconds));
+}
+
+/**********************************************************************
+* Function:			guidedPec
+* Purpose: 			Records PEC the way a guide camera would and checks the tables it builds
+* Precondition:		Pass in a target that stays up for the whole run, the gear periods to record and to measure,
+*					and the virtual seconds per tick
+* Postcondition:	Prints the RMS and peak pointing error of the modeled gears with PEC off and with playback of
+*					a table recorded by guiding every SIM_GUIDE_SECONDS with coordinate::guide(). The sidereal
+*					clock is the system clock again when this returns.
+************************************************************************/
+void nightSimulation::guidedPec(twoAxisDeg targetRaDec, int periods, double tickSeconds)
+{
+	//The modeled mount, with a gear period short enough to record in a few minutes
+	softGpioDriver pins;
+	mountConfig config = defaultMountConfig();
+	config.name = "simulation";
+	config.stateFilePath = nullptr;
+	config.altPecPath = nullptr;
+	config.azPecPath = nullptr;
+	config.pecPeriodSteps = SIM_PEC_PERIOD_STEPS;
+	periodicErrorModel altGear(config.pecPeriodSteps, SIM_GEAR_ERROR_STEPS);
+	periodicErrorModel azGear(config.pecPeriodSteps, SIM_GEAR_ERROR_STEPS);
+
+	sidereal::setClock(&clock);
+	coordinate mount(config, &pins);
+	mount.calibrate(latLong, targetRaDec);
+	mount.beginTrack(targetRaDec, -1);
+
+	int maxPulses = (int)(altKinematics::maxStepRate * tickSeconds);
+	if (maxPulses < 1)
+	{
+		maxPulses = 1;
+	}
+	int guideTicks = (int)(SIM_GUIDE_SECONDS / tickSeconds + 0.5);
+	int64_t maxTicks = (int64_t)(SIM_PEC_MAX_HOURS * 3600.0 / tickSeconds);
+	const char *names[] = { "Off", "Record", "Playback" };
+	pecMode modes[] = { PEC_RECORD, PEC_PLAYBACK, PEC_OFF };
+
+	cout << "Guided PEC, " << periods << " periods of " << config.pecPeriodSteps << " steps each" << endl;
+	cout << "PEC\t\tRMS arcsec\tPeak arcsec" << endl;
+	for (int m = 0; m < 3; m++)
+	{
+		//Each stage runs until both axes have turned through the periods
+		mount.setPecMode(modes[m]);
+		mount.clearGuide();
+		twoAxisDeg start = mount.getCurrentAltAz();
+		double squares = 0, peak = 0;
+		int64_t samples = 0;
+
+		for (int64_t tick = 1; tick <= maxTicks; tick++)
+		{
+			clock.advance(tickSeconds);
+			stepTick(mount, pins, config, maxPulses);
+
+			twoAxisDeg errorDeg;
+			double error = pointingError(mount, targetRaDec, altGear, azGear, errorDeg);
+			squares += error * error;
+			peak = (error > peak) ? error : peak;
+			samples++;
+
+			//The guide camera sees the gears' error and moves the mount all the way back
+			if (modes[m] == PEC_RECORD && tick % guideTicks == 0)
+			{
+				double cosAlt = cos(mount.getCurrentAltAz().x * DEG_TO_RAD);
+				mount.guide(-errorDeg.x * ARCSEC_PER_DEG, -errorDeg.y * cosAlt * ARCSEC_PER_DEG, 0, 0);
+			}
+
+			twoAxisDeg now = mount.getCurrentAltAz();
+			if (fabs(now.x - start.x) * altKinematics::stepsPerDeg >= periods * config.pecPeriodSteps &&
+				fabs(now.y - start.y) * azKinematics::stepsPerDeg >= periods * config.pecPeriodSteps)
+			{
+				break;
+			}
+		}
+
+		if (modes[m] != PEC_RECORD)
+		{
+			cout << names[modes[m]] << "\t\t" << sqrt(squares / samples) << "\t\t" << peak << endl;
+		}
+	}
+
+	mount.endTrack();
+	sidereal::setClock(nullptr);
+}
+
+/**********************************************************************
+* Function:			pecBenchmark
+* Purpose: 			Records and plays back PEC through guiding from the test site
+* Precondition:		Pass in the gear periods to record and to measure
+* Postcondition:	Runs guidedPec() on the same target as benchmark()
+************************************************************************/
+void nightSimulation::pecBenchmark(int periods)
+{
+	twoAxisDeg latLong;
+	latLong.x = sidereal::dmsToDeg(42, 13, 29.53);
+	latLong.y = -sidereal::dmsToDeg(121, 46, 54.01);
+
+	nightSimulation simulation(latLong, SIM_START_UNIX);
+
+	virtualClock start(SIM_START_UNIX);
+	sidereal::setClock(&start);
+	twoAxisDeg target;
+	target.x = fmod(sidereal::getLMST(sidereal::getGMSTinRads(), latLong.y) + 15.0, 360.0);
+	target.y = 60.0;
+	sidereal::setClock(nullptr);
+
+	simulation.guidedPec(target, periods, SIM_DEFAULT_TICK_SECONDS);
+}
+
+/************************************************************************
+* Struct: 		simCamera
+* Purpose:		Hands star positions from the simulation to the camera thread that draws them
+* Data members:	lock / ready	- Guard the fields below and wake the camera
+*				requested		- Frames asked for so far
+*				starX / starY	- Where the star of the newest frame is drawn, pixels
+*************************************************************************/
+typedef struct simCamera
+{
+	std::mutex lock;
+	std::condition_variable ready;
+	int requested;
+	double starX;
+	double starY;
+} simCamera;
+
+/**********************************************************************
+* Function:			renderFrame
+* Purpose: 			Draws one 16 bit guide frame with a single star on a noisy sky
+* Precondition:		Pass in the frame buffer, the star position in pixels and the random generator
+* Postcondition:	Every pixel is the sky plus noise, pixels within 5 sigma of the star add its profile
+************************************************************************/
+static void renderFrame(std::vector<uint16_t> &pixels, double starX, double starY, std::mt19937 &random)
+{
+	std::normal_distribution<double> noise(0.0, GUIDE_SIM_NOISE);
+	int reach = (int)ceil(5.0 * GUIDE_SIM_SIGMA_PIXELS);
+	double spread = 2.0 * GUIDE_SIM_SIGMA_PIXELS * GUIDE_SIM_SIGMA_PIXELS;
+
+	for (int y = 0; y < GUIDE_SIM_HEIGHT; y++)
+	{
+		bool nearRow = fabs(y - starY) <= reach;
+		for (int x = 0; x < GUIDE_SIM_WIDTH; x++)
+		{
+			double value = GUIDE_SIM_BACKGROUND + noise(random);
+			if (nearRow && fabs(x - starX) <= reach)
+			{
+				double dx = x - starX;
+				double dy = y - starY;
+				value += GUIDE_SIM_PEAK * exp(-(dx * dx + dy * dy) / spread);
+			}
+			value = (value < 0) ? 0 : ((value > 65535) ? 65535 : value);
+			pixels[(size_t)y * GUIDE_SIM_WIDTH + x] = (uint16_t)lround(value);
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			guideCamera
+* Purpose: 			Guides the modeled mount with autoGuider and compares it with the same run left alone
+* Precondition:		Pass in a target that stays up for the whole run, how many frames, and the virtual seconds
+*					per tick
+* Postcondition:	Prints the centroid error, the pointing error guided and unguided, and the latency. Both runs
+*					start from the same virtual time. The sidereal clock is the system clock again when this
+*					returns.
+************************************************************************/
+void nightSimulation::guideCamera(twoAxisDeg targetRaDec, int frames, double tickSeconds)
+{
+	double startSeconds = clock.unixSeconds();
+	autoGuider guider(defaultGuideConfig());
+	guideSimulationReport guided = guideRun(targetRaDec, frames, tickSeconds, guider, true);
+
+	clock.set(startSeconds);
+	autoGuider watcher(defaultGuideConfig());
+	guideSimulationReport unguided = guideRun(targetRaDec, frames, tickSeconds, watcher, false);
+
+	cout << frames << " frames of " << GUIDE_SIM_WIDTH << " x " << GUIDE_SIM_HEIGHT << " x 16 bit, " << guided.lost
+		<< " with the star lost" << endl;
+	if (guided.measured > 0 && unguided.measured > 0)
+	{
+		cout << "Centroid error: " << guided.centroidRmsPixels << " px RMS" << endl;
+		cout << "Mount error: guided " << guided.errorRmsArcsec << " arcsec RMS, unguided " << unguided.errorRmsArcsec
+			<< " arcsec RMS" << endl;
+	}
+	guider.printLatency();
+}
+
+/**********************************************************************
+* Function:			guideRun
+* Purpose: 			One run of synthetic guide frames against a modeled mount
+* Precondition:		Pass in the target, how many frames, the virtual seconds per tick, a guider that has not
+*					locked yet, and false to only measure the frames without correcting the mount
+* Postcondition:	A coordinate on software pins tracks the target under the virtual clock. Before each frame
+*					the clock is advanced one frame time, then the star is drawn where the gears, a slow drift
+*					and seeing put it, and written to a pipe that the guider reads with a pipeFrameSource as it
+*					would a real FIFO. Corrections reach the mount through coordinate::guide(). The sidereal
+*					clock is the system clock again when this returns.
+************************************************************************/
+guideSimulationReport nightSimulation::guideRun(twoAxisDeg targetRaDec, int frames, double tickSeconds, autoGuider &guider, bool correct)
+{
+	guideSimulationReport report = {};
+	int fds[2];
+	if (pipe(fds) != 0)
+	{
+		cout << "Could not open a pipe" << endl;
+		return report;
+	}
+
+	softGpioDriver pins;
+	mountConfig config = defaultMountConfig();
+	config.name = "simulation";
+	config.stateFilePath = nullptr;
+	config.altPecPath = nullptr;
+	config.azPecPath = nullptr;
+	config.pecPeriodSteps = SIM_PEC_PERIOD_STEPS;
+	periodicErrorModel altGear(config.pecPeriodSteps, GUIDE_SIM_GEAR_ERROR_STEPS);
+	periodicErrorModel azGear(config.pecPeriodSteps, GUIDE_SIM_GEAR_ERROR_STEPS);
+
+	sidereal::setClock(&clock);
+	coordinate mount(config, &pins);
+	mount.calibrate(latLong, targetRaDec);
+	mount.beginTrack(targetRaDec, -1);
+
+	int maxPulses = (int)(altKinematics::maxStepRate * tickSeconds);
+	if (maxPulses < 1)
+	{
+		maxPulses = 1;
+	}
+	guideConfig guiding = defaultGuideConfig();
+	int frameTicks = (int)(guiding.frameSeconds / tickSeconds + 0.5);
+	simCamera camera;
+	camera.requested = 0;
+
+	//Camera: waits for each request, then draws and writes that frame
+	std::thread drawer([&]()
+	{
+		std::mt19937 random(39);
+		std::vector<uint16_t> pixels((size_t)GUIDE_SIM_WIDTH * GUIDE_SIM_HEIGHT);
+
+		for (int i = 0; i < frames; i++)
+		{
+			double starX, starY;
+			{
+				std::unique_lock<std::mutex> guard(camera.lock);
+				camera.ready.wait(guard, [&]() { return camera.requested > i; });
+				starX = camera.starX;
+				starY = camera.starY;
+			}
+
+			renderFrame(pixels, starX, starY, random);
+			const uint8_t *bytes = (const uint8_t *)pixels.data();
+			size_t remaining = pixels.size() * sizeof(uint16_t);
+			while (remaining > 0)
+			{
+				ssize_t written = write(fds[1], bytes, remaining);
+				if (written <= 0)
+				{
+					return;
+				}
+				bytes += written;
+				remaining -= (size_t)written;
+			}
+		}
+	});
+
+	pipeFrameSource source(fds[0], { GUIDE_SIM_WIDTH, GUIDE_SIM_HEIGHT, 2 });
+	guideFrame frame;
+	std::mt19937 random(40);
+	std::normal_distribution<double> seeing(0.0, GUIDE_SIM_SEEING_ARCSEC);
+	double centroidSquares = 0, errorSquares = 0;
+	double lockAltError = 0, lockAzError = 0;
+
+	for (int i = 0; i < frames; i++)
+	{
+		for (int tick = 0; tick < frameTicks; tick++)
+		{
+			clock.advance(tickSeconds);
+			stepTick(mount, pins, config, maxPulses);
+		}
+
+		//The gears and an imperfect alignment, on the sky, azimuth along the sky rather than the axis
+		twoAxisDeg errorDeg;
+		pointingError(mount, targetRaDec, altGear, azGear, errorDeg);
+		double seconds = (i + 1) * guiding.frameSeconds;
+		double cosAlt = cos(mount.getCurrentAltAz().x * DEG_TO_RAD);
+		double altError = errorDeg.x * ARCSEC_PER_DEG + GUIDE_SIM_DRIFT_ARCSEC * seconds;
+		double azError = errorDeg.y * cosAlt * ARCSEC_PER_DEG - 0.5 * GUIDE_SIM_DRIFT_ARCSEC * seconds;
+
+		//A mount pointing past the star moves it the other way in the frame
+		double starX = GUIDE_SIM_WIDTH / 2.0 - (azError + seeing(random)) / guiding.arcsecPerPixel;
+		double starY = GUIDE_SIM_HEIGHT / 2.0 - (altError + seeing(random)) / guiding.arcsecPerPixel;
+		{
+			std::lock_guard<std::mutex> guard(camera.lock);
+			camera.starX = starX;
+			camera.starY = starY;
+			camera.requested = i + 1;
+		}
+		camera.ready.notify_one();
+
+		struct pollfd waiting = { source.getFd(), POLLIN, 0 };
+		while (!source.next(frame))
+		{
+			poll(&waiting, 1, -1);
+		}
+
+		guideResult result = guider.processFrame(frame, correct ? &mount : nullptr);
+		if (!result.star.found || result.star.snr < GUIDE_MIN_SNR)
+		{
+			report.lost++;
+			continue;
+		}
+		//The guider holds the star where it first saw it, so that is what the error is measured from
+		if (report.measured == 0)
+		{
+			lockAltError = altError;
+			lockAzError = azError;
+		}
+		double dx = result.star.x - starX;
+		double dy = result.star.y - starY;
+		centroidSquares += dx * dx + dy * dy;
+		errorSquares += (altError - lockAltError) * (altError - lockAltError) + (azError - lockAzError) * (azError - lockAzError);
+		report.measured++;
+	}
+
+	drawer.join();
+	close(fds[0]);
+	close(fds[1]);
+	mount.endTrack();
+	sidereal::setClock(nullptr);
+
+	if (report.measured > 0)
+	{
+		report.centroidRmsPixels = sqrt(centroidSquares / report.measured);
+		report.errorRmsArcsec = sqrt(errorSquares / report.measured);
+	}
+	return report;
+}
+
+/**********************************************************************
+* Function:			guideBenchmark
+* Purpose: 			Guides the modeled mount from the test site
+* Precondition:		Pass in how many frames to guide
+* Postcondition:	Runs guideCamera() on the same target as benchmark()
+************************************************************************/
+void nightSimulation::guideBenchmark(int frames)
+{
+	twoAxisDeg latLong;
+	latLong.x = sidereal::dmsToDeg(42, 13, 29.53);
+	latLong.y = -sidereal::dmsToDeg(121, 46, 54.01);
+
+	nightSimulation simulation(latLong, SIM_START_UNIX);
+
+	virtualClock start(SIM_START_UNIX);
+	sidereal::setClock(&start);
+	twoAxisDeg target;
+	target.x = fmod(sidereal::getLMST(sidereal::getGMSTinRads(), latLong.y) + 15.0, 360.0);
+	target.y = 60.0;
+	sidereal::setClock(nullptr);
+
+	simulation.guideCamera(target, frames, SIM_DEFAULT_TICK_SECONDS);
+}
+
+/**********************************************************************
+* Function:			pointingError
+* Purpose: 			Where the modeled gears point the mount against where the target is
+* Precondition:		Pass in the mount, the target RA / Dec in degrees, and the gear model of each axis
+* Postcondition:	errorDeg holds x = Alt, y = Az pointing minus target in degrees, the azimuth along its axis.
+*					Returns the error on the sky in arcseconds. If commandArcsec is not nullptr it is set to the
+*					error of the step counters alone, what the tracking loop controls.
+************************************************************************/
+double nightSimulation::pointingError(coordinate &mount, twoAxisDeg targetRaDec, periodicErrorModel &altGear, periodicErrorModel &azGear, twoAxisDeg &errorDeg, double *commandArcsec)
+{
+	twoAxisDeg target = mount.equatorialToLocal(targetRaDec.x, targetRaDec.y, mount.getLatLongDeg());
+	twoAxisDeg counted = mount.getCurrentAltAz();
+	double cosAlt = cos(target.x * DEG_TO_RAD);
+
+	errorDeg.x = counted.x - target.x;
+	errorDeg.y = fmod(counted.y - target.y + 540.0, 360.0) - 180.0;
+	if (commandArcsec != nullptr)
+	{
+		*commandArcsec = sqrt(errorDeg.x * errorDeg.x + errorDeg.y * errorDeg.y * cosAlt * cosAlt) * ARCSEC_PER_DEG;
+	}
+
+	errorDeg.x += altGear.errorSteps(altKinematics::degToSteps(counted.x)) * altKinematics::degPerStep;
+	errorDeg.y += azGear.errorSteps(azKinematics::degToSteps(counted.y)) * azKinematics::degPerStep;
+
+	return sqrt(errorDeg.x * errorDeg.x + errorDeg.y * errorDeg.y * cosAlt * cosAlt) * ARCSEC_PER_DEG;
+}
+
+/**********************************************************************
+* Function:			periodicErrorModel (constructor)
+* Purpose: 			Creates a simulated gearbox error
+* Precondition:		Pass in the error period and the peak of the fundamental, both in microsteps
+* Postcondition:	Harmonics 2 and 3 are a third and a sixth of the fundamental, phases are fixed
+************************************************************************/
+periodicErrorModel::periodicErrorModel(int64_t periodSteps, double amplitudeSteps) : generator(1)
+{
+	this->periodSteps = periodSteps;
+	amplitudes[0] = amplitudeSteps;
+	amplitudes[1] = amplitudeSteps / 3.0;
+	amplitudes[2] = amplitudeSteps / 6.0;
+	phases[0] = 0.3;
+	phases[1] = 1.9;
+	phases[2] = 4.1;
+}
+
+/**********************************************************************
+* Function:			errorSteps
+* Purpose: 			Returns how far the gearbox output is from where the motor was told to put it
+* Precondition:		Pass in the axis position in microsteps
+* Postcondition:	Returns the error in microsteps, positive is ahead
+************************************************************************/
+double periodicErrorModel::errorSteps(int64_t steps)
+{
+	int64_t phase = steps % periodSteps;
+	double angle = 2.0 * M_PI * (double)((phase < 0) ? phase + periodSteps : phase) / (double)periodSteps;
+
+	double error = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		error += amplitudes[i] * sin((i + 1) * angle + phases[i]);
+	}
+	return error;
+}
+
+/**********************************************************************
+* Function:			measure
+* Purpose: 			Simulates measuring the error, for example from a guide camera
+* Precondition:		Pass in the axis position and the standard deviation of the noise, both in microsteps
+* Postcondition:	Returns errorSteps plus gaussian noise
+************************************************************************/
+double periodicErrorModel::measure(int64_t steps, double noiseSteps)
+{
+	std::normal_distribution<double> noise(0.0, noiseSteps);
+	return errorSteps(steps) + noise(generator);
+}
@@ -0,0 +1,149 @@
+/*************************************************************
+* Filename:			nightSimulation.h
+* Purpose:			Replay a whole night of tracking on a virtual clock and a modeled mount
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//uint64_t
+#include <random>			//std::mt19937
+#include "coordinate.h"		//coordinate, twoAxisDeg
+#include "clockSource.h"	//virtualClock
+#include "autoGuider.h"		//autoGuider, guideConfig
+
+#define SIM_DEFAULT_HOURS 10.0
+#define SIM_DEFAULT_TICK_SECONDS 0.05
+#define SIM_START_UNIX 1792465200.0		//10/20/2026 03:00 UTC, early evening at the test site
+#define SIM_GEAR_ERROR_STEPS 20.0		//Peak periodic error of the modeled gearbox
+#define ARCSEC_PER_DEG 3600.0
+#define SIM_PEC_PERIOD_STEPS 1000		//Short gear period for --pec-sim, a few minutes of tracking
+#define SIM_GUIDE_SECONDS 1.0			//Time between guide corrections while recording PEC
+#define SIM_PEC_MAX_HOURS 12.0			//Give up recording if the axes turn too slowly to cover the periods
+
+//Synthetic guide camera frames used by --guide-sim
+#define GUIDE_SIM_WIDTH 320
+#define GUIDE_SIM_HEIGHT 240
+#define GUIDE_SIM_BACKGROUND 1000.0
+#define GUIDE_SIM_NOISE 20.0
+#define GUIDE_SIM_PEAK 6000.0
+#define GUIDE_SIM_SIGMA_PIXELS 1.3			//Star profile, about 3 pixels across at half maximum
+#define GUIDE_SIM_SEEING_ARCSEC 0.4			//Random shift of each frame
+#define GUIDE_SIM_DRIFT_ARCSEC 0.15			//Per second, left over from an imperfect alignment
+#define GUIDE_SIM_GEAR_ERROR_STEPS 1.5		//Peak gear error while guiding, about 5 arcseconds
+#define GUIDE_SIM_DEFAULT_FRAMES 600
+
+/************************************************************************
+* Struct: 		simulationReport
+* Purpose:		Results of one simulated night
+* Data members:	simulatedHours		- Virtual time tracked
+*				slewSeconds			- Virtual time until the mount first reached the target
+*				samples				- Ticks measured after the slew
+*				commandRmsArcsec / commandMaxArcsec	- Error of the step counters, what the tracking loop controls
+*				pointingRmsArcsec / pointingMaxArcsec	- Error on the sky once the modeled gearbox error is added
+*				pulses				- Pulses sent to both motors, backlash take-up included
+*				cpuSeconds			- CPU time of the simulation thread
+*				wallSeconds			- Real time taken
+*************************************************************************/
+typedef struct simulationReport
+{
+	double simulatedHours;
+	double slewSeconds;
+	uint64_t samples;
+	double commandRmsArcsec;
+	double commandMaxArcsec;
+	double pointingRmsArcsec;
+	double pointingMaxArcsec;
+	uint64_t pulses;
+	double cpuSeconds;
+	double wallSeconds;
+} simulationReport;
+
+/************************************************************************
+* Struct: 		guideSimulationReport
+* Purpose:		Results of guiding the modeled mount through one run of synthetic frames
+* Data members:	measured			- Frames where the star was found
+*				lost				- Frames where it was not
+*				centroidRmsPixels	- Measured centroid against where the star was drawn
+*				errorRmsArcsec		- Pointing error on the sky from where the star was locked, gears and drift
+*									  included, seeing left out
+*************************************************************************/
+typedef struct guideSimulationReport
+{
+	int measured;
+	int lost;
+	double centroidRmsPixels;
+	double errorRmsArcsec;
+} guideSimulationReport;
+
+/************************************************************************
+* Class: 		periodicErrorModel
+* Purpose:		Simulated gearbox error for testing PEC, a fundamental and its first harmonics at fixed
+*				phases plus optional measurement noise.
+* Data members:	periodSteps	- Microsteps in one error period
+*				amplitudes	- Peak error of each harmonic in microsteps
+*				phases		- Phase of each harmonic in radians
+*				generator	- Seeded so every run measures the same noise
+*
+* Methods:		errorSteps
+*				measure
+*************************************************************************/
+class periodicErrorModel
+{
+	public:
+		periodicErrorModel(int64_t periodSteps, double amplitudeSteps);
+
+		double errorSteps(int64_t steps);
+		double measure(int64_t steps, double noiseSteps);
+
+	private:
+		int64_t periodSteps;
+		double amplitudes[3];
+		double phases[3];
+		std::mt19937 generator;
+};
+
+/************************************************************************
+* Class: 		nightSimulation
+* Purpose:		Runs the real tracking code on software pins while a virtual clock is advanced in fixed ticks.
+*				Each tick each axis may make as many pulses as its step rate allows in that time, then the
+*				step counters and a modeled gearbox are compared with where the target really is.
+* Data members:	clock		- Virtual time of day, installed as the sidereal clock while running
+*				latLong		- Observer site
+*
+* Methods:		run
+*				printReport
+*				benchmark
+*				guidedPec
+*				pecBenchmark
+*				guideCamera
+*				guideBenchmark
+*				guideRun
+*				stepTick
+*				pointingError
+*************************************************************************/
+class nightSimulation
+{
+	public:
+		nightSimulation(twoAxisDeg latLong, double startUnixSeconds);
+
+		simulationReport run(twoAxisDeg targetRaDec, double hours, double tickSeconds);
+		static void printReport(simulationReport report);
+
+		//Simulates a night on a circumpolar target from the test site
+		static void benchmark(double hours, double tickSeconds);
+
+		//Records PEC through coordinate::guide() while guiding on the modeled gears, then plays it back
+		void guidedPec(twoAxisDeg targetRaDec, int periods, double tickSeconds);
+		static void pecBenchmark(int periods);
+
+		//Guides the modeled mount through autoGuider and coordinate::guide() on frames streamed through a pipe
+		void guideCamera(twoAxisDeg targetRaDec, int frames, double tickSeconds);
+		static void guideBenchmark(int frames);
+
+	private:
+		guideSimulationReport guideRun(twoAxisDeg targetRaDec, int frames, double tickSeconds, autoGuider &guider, bool correct);
+		static bool stepTick(coordinate &mount, softGpioDriver &pins, const mountConfig &config, int maxPulses);
+		static double pointingError(coordinate &mount, twoAxisDeg targetRaDec, periodicErrorModel &altGear, periodicErrorModel &azGear, twoAxisDeg &errorDeg, double *commandArcsec = nullptr);
+
+		virtualClock clock;
+		twoAxisDeg latLong;
+};
@@ -0,0 +1,415 @@
+/*************************************************************
+* Filename:			observingScheduler.cpp
+* Purpose:			Order a night's observing list so the least time is spent slewing and waiting, then run it
+**************************************************************/
+#include "observingScheduler.h"
+
+#include <algorithm>	//std::reverse()
+
+/**********************************************************************
+* Function:			observingScheduler (constructor)
+* Purpose: 			Creates a scheduler for a telescope
+* Precondition:		mount should already be calibrated so its location and position are known
+* Postcondition:	Scheduler is ready to plan
+************************************************************************/
+observingScheduler::observingScheduler(coordinate &mount) : mount(mount)
+{
+}
+
+/**********************************************************************
+* Function:			loadTargets
+* Purpose: 			Reads an observing list from a text file
+* Precondition:		One target per line: RA and Dec in degrees, dwell in seconds, and optionally the julian dates
+*					of the window start and end. Blank lines and lines starting with # are ignored.
+* Postcondition:	Returns the targets, empty if the file could not be opened
+************************************************************************/
+std::vector<observingTarget> observingScheduler::loadTargets(const char *filename)
+{
+	std::vector<observingTarget> targets;
+	std::ifstream file(filename);
+	std::string line;
+
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		observingTarget target;
+		target.windowStartJd = 0;
+		target.windowEndJd = 0;
+
+		if (fields >> target.raDec.x >> target.raDec.y >> target.dwellSeconds)
+		{
+			fields >> target.windowStartJd >> target.windowEndJd;
+			targets.push_back(target);
+		}
+	}
+
+	return targets;
+}
+
+/**********************************************************************
+* Function:			plan
+* Purpose: 			Orders an observing list to minimize slewing plus waiting
+* Precondition:		Pass in the targets, the julian date the plan starts, and the julian date it must end by
+* Postcondition:	Returns an observingPlan. A greedy nearest-neighbour tour is built with the real projected
+*					times, then improved with 2-opt on a slew-time matrix. The 2-opt tour is only kept if a full
+*					re-simulation shows it is actually better, since moving targets changes their times.
+************************************************************************/
+observingPlan observingScheduler::plan(const std::vector<observingTarget> &targets, double startJd, double endJd)
+{
+	std::vector<bool> used(targets.size(), false);
+	std::vector<int> order;
+	solveRiseTimes(targets, startJd, endJd);
+	visibleFromJd = firstVisibleJd;
+	twoAxisDeg currentAltAz = mount.getCurrentAltAz();
+	double currentJd = startJd;
+
+	//Nearest neighbour - always go to whichever target can be started the soonest
+	while (1)
+	{
+		int best = -1;
+		double bestCost = 0;
+		scheduledTarget bestEntry;
+		twoAxisDeg bestEndAltAz;
+
+		for (int i = 0; i < (int)targets.size(); i++)
+		{
+			scheduledTarget entry;
+			twoAxisDeg endAltAz;
+
+			if (!used[i] && fitTarget(targets, i, currentAltAz, currentJd, endJd, entry, endAltAz))
+			{
+				double cost = entry.slewSeconds + entry.waitSeconds;
+				if (best < 0 || cost < bestCost)
+				{
+					best = i;
+					bestCost = cost;
+					bestEntry = entry;
+					bestEndAltAz = endAltAz;
+				}
+			}
+		}
+
+		if (best < 0)
+		{
+			break;
+		}
+
+		used[best] = true;
+		order.push_back(best);
+		currentAltAz = bestEndAltAz;
+		currentJd = bestEntry.endJd;
+	}
+
+	//Targets that never fit are handed to the simulation at the end so they are reported as skipped
+	std::vector<int> leftovers;
+	for (int i = 0; i < (int)targets.size(); i++)
+	{
+		if (!used[i])
+		{
+			leftovers.push_back(i);
+		}
+	}
+
+	std::vector<int> greedyOrder = order;
+	greedyOrder.insert(greedyOrder.end(), leftovers.begin(), leftovers.end());
+	observingPlan greedyPlan = simulate(targets, greedyOrder, startJd, endJd);
+
+	int count = (int)order.size();
+	if (count < 3)
+	{
+		return greedyPlan;
+	}
+
+	//Slew-time matrix between the positions each target has when the greedy plan visits it, node 0 is the mount
+	std::vector<twoAxisDeg> positions(count + 1);
+	positions[0] = mount.getCurrentAltAz();
+	for (int i = 0; i < count; i++)
+	{
+		positions[i + 1] = altAzAt(targets[greedyPlan.order[i].index], greedyPlan.order[i].startJd);
+	}
+
+	std::vector<double> cost((count + 1) * (count + 1));
+	for (int i = 0; i <= count; i++)
+	{
+		for (int j = 0; j <= count; j++)
+		{
+			slewPlan slew = mount.planSlew(positions[i], positions[j]);
+			cost[i * (count + 1) + j] = (i == j) ? 0 : (slew.reachable ? mount.estimateSlewSeconds(positions[i], slew) : UNREACHABLE_SLEW_SECONDS);
+		}
+	}
+
+	//2-opt on an open path starting at the mount - reverse path[i..j] when it shortens the total
+	std::vector<int> path(count + 1);
+	for (int i = 0; i <= count; i++)
+	{
+		path[i] = i;
+	}
+
+	bool improved = true;
+	for (int pass = 0; improved && pass < MAX_TWO_OPT_PASSES; pass++)
+	{
+		improved = false;
+		for (int i = 1; i < count; i++)
+		{
+			for (int j = i + 1; j <= count; j++)
+			{
+				double before = cost[path[i - 1] * (count + 1) + path[i]];
+				double after = cost[path[i - 1] * (count + 1) + path[j]];
+				if (j < count)
+				{
+					before += cost[path[j] * (count + 1) + path[j + 1]];
+					after += cost[path[i] * (count + 1) + path[j + 1]];
+				}
+
+				if (after < before - 1e-9)
+				{
+					std::reverse(path.begin() + i, path.begin() + j + 1);
+					improved = true;
+				}
+			}
+		}
+	}
+
+	std::vector<int> improvedOrder;
+	for (int i = 1; i <= count; i++)
+	{
+		improvedOrder.push_back(greedyPlan.order[path[i] - 1].index);
+	}
+	improvedOrder.insert(improvedOrder.end(), leftovers.begin(), leftovers.end());
+	observingPlan improvedPlan = simulate(targets, improvedOrder, startJd, endJd);
+
+	//Never give up a target to save time, otherwise keep whichever is faster
+	if (improvedPlan.skipped.size() < greedyPlan.skipped.size() ||
+		(improvedPlan.skipped.size() == greedyPlan.skipped.size() && planCost(improvedPlan) < planCost(greedyPlan)))
+	{
+		return improvedPlan;
+	}
+
+	return greedyPlan;
+}
+
+/**********************************************************************
+* Function:			execute
+* Purpose: 			Runs a plan on the telescope
+* Precondition:		Pass in the same target list used for plan() and the plan it returned
+* Postcondition:	Every scheduled target has been slewed to and tracked, waiting for a target is spent
+*					tracking it so the mount is ready the moment it rises or its window opens
+************************************************************************/
+void observingScheduler::execute(const std::vector<observingTarget> &targets, const observingPlan &plan)
+{
+	for (int i = 0; i < (int)plan.order.size(); i++)
+	{
+		const scheduledTarget &entry = plan.order[i];
+		const observingTarget &target = targets[entry.index];
+
+		//Stay until the planned end, or the full dwell if the plan is running late
+		double trackSeconds = (entry.endJd - sidereal::getJulianDate()) * SECONDS_PER_DAY;
+		if (trackSeconds < target.dwellSeconds)
+		{
+			trackSeconds = target.dwellSeconds;
+		}
+
+		cout << "Target " << (i + 1) << " of " << plan.order.size() << " - RA: " << target.raDec.x << " Dec: " << target.raDec.y << endl;
+		mount.gotoCoordsDeg(target.raDec, trackSeconds);
+	}
+
+	cout << "Observing list finished" << endl;
+}
+
+/**********************************************************************
+* Function:			simulate
+* Purpose: 			Walks through a visiting order using the slew model and projected times
+* Precondition:		Pass in the targets, an order of indexes into targets, and the start and end julian dates
+* Postcondition:	Returns the resulting plan, targets that do not fit when their turn comes are skipped
+************************************************************************/
+observingPlan observingScheduler::simulate(const std::vector<observingTarget> &targets, const std::vector<int> &order, double startJd, double endJd)
+{
+	observingPlan result;
+	twoAxisDeg currentAltAz = mount.getCurrentAltAz();
+	double currentJd = startJd;
+
+	result.totalSlewSeconds = 0;
+	result.totalWaitSeconds = 0;
+	visibleFromJd = firstVisibleJd;
+
+	for (int i = 0; i < (int)order.size(); i++)
+	{
+		scheduledTarget entry;
+		twoAxisDeg endAltAz;
+
+		if (fitTarget(targets, order[i], currentAltAz, currentJd, endJd, entry, endAltAz))
+		{
+			entry.index = order[i];
+			result.order.push_back(entry);
+			result.totalSlewSeconds += entry.slewSeconds;
+			result.totalWaitSeconds += entry.waitSeconds;
+			currentAltAz = endAltAz;
+			currentJd = entry.endJd;
+		}
+		else
+		{
+			result.skipped.push_back(order[i]);
+		}
+	}
+
+	return result;
+}
+
+/**********************************************************************
+* Function:			fitTarget
+* Purpose: 			Checks if a target can be observed after the mount finishes at fromAltAz / fromJd
+* Precondition:		Pass in the target list and the index to check, fromAltAz is Alt / unwrapped Az in degrees.
+*					fromJd must not go backwards between calls until visibleFromJd is reset.
+* Postcondition:	Returns true and fills entry and endAltAz (where the mount is left) if the slew, any waiting,
+*					and the whole dwell fit inside the target's window, the night, and the altitude and cable-wrap
+*					limits
+************************************************************************/
+bool observingScheduler::fitTarget(const std::vector<observingTarget> &targets, int index, twoAxisDeg fromAltAz, double fromJd, double endJd, scheduledTarget &entry, twoAxisDeg &endAltAz)
+{
+	const observingTarget &target = targets[index];
+	double lastJd = endJd;
+	if (target.windowEndJd > 0 && target.windowEndJd < lastJd)
+	{
+		lastJd = target.windowEndJd;
+	}
+
+	//Slew from where the mount is to where the target is now
+	slewPlan slew = mount.planSlew(fromAltAz, altAzAt(target, fromJd));
+	if (!slew.reachable)
+	{
+		return false;
+	}
+	entry.slewSeconds = mount.estimateSlewSeconds(fromAltAz, slew);
+	double arriveJd = fromJd + entry.slewSeconds / SECONDS_PER_DAY;
+
+	//Wait for the window to open
+	double startJd = arriveJd;
+	if (target.windowStartJd > startJd)
+	{
+		startJd = target.windowStartJd;
+	}
+
+	//Skip ahead to where an earlier search found the target rising
+	if (startJd < visibleFromJd[index])
+	{
+		startJd = visibleFromJd[index];
+	}
+	if (startJd > lastJd)
+	{
+		return false;
+	}
+
+	//Wait for the target to rise above the altitude limit
+	if (!isVisible(target, startJd))
+	{
+		do
+		{
+			startJd += RISE_SEARCH_STEP_SECONDS / SECONDS_PER_DAY;
+			if (startJd > lastJd)
+			{
+				visibleFromJd[index] = startJd;
+				return false;
+			}
+		} while (!isVisible(target, startJd));
+
+		visibleFromJd[index] = startJd;
+	}
+
+	double finishJd = startJd + target.dwellSeconds / SECONDS_PER_DAY;
+	if (finishJd > lastJd || !isVisible(target, finishJd))
+	{
+		return false;
+	}
+
+	entry.waitSeconds = (startJd - arriveJd) * SECONDS_PER_DAY;
+	entry.startJd = startJd;
+	entry.endJd = finishJd;
+
+	//Tracking keeps the azimuth continuous with the slew, so unwrap the end position against it
+	twoAxisDeg arrivedAltAz;
+	arrivedAltAz.x = slew.altDeg;
+	arrivedAltAz.y = slew.azDeg;
+	slewPlan finish = mount.planSlew(arrivedAltAz, altAzAt(target, finishJd));
+	if (!finish.reachable)
+	{
+		return false;
+	}
+	endAltAz.x = finish.altDeg;
+	endAltAz.y = finish.azDeg;
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			isVisible
+* Purpose: 			Checks a target against the mount's altitude limits at a time
+* Precondition:		Pass in a target and a julian date
+* Postcondition:	Returns true if the target's altitude is inside the limits
+************************************************************************/
+bool observingScheduler::isVisible(const observingTarget &target, double julianDate)
+{
+	slewLimits limits = mount.getSlewLimits();
+	double alt = altAzAt(target, julianDate).x;
+
+	return alt >= limits.minAltDeg && alt <= limits.maxAltDeg;
+}
+
+/**********************************************************************
+* Function:			altAzAt
+* Purpose: 			Projects a target to Alt / Az at a time
+* Precondition:		Pass in a target and a julian date
+* Postcondition:	Returns twoAxisDeg with x = Alt, y = Az (0 - 360) in degrees
+************************************************************************/
+twoAxisDeg observingScheduler::altAzAt(const observingTarget &target, double julianDate)
+{
+	return mount.equatorialToLocal(target.raDec.x, target.raDec.y, mount.getLatLongDeg(), julianDate);
+}
+
+/**********************************************************************
+* Function:			planCost
+* Purpose: 			Total time a plan spends not observing
+* Precondition:		Pass in a plan from simulate()
+* Postcondition:	Returns slew plus wait seconds
+************************************************************************/
+double observingScheduler::planCost(const observingPlan &plan)
+{
+	return plan.totalSlewSeconds + plan.totalWaitSeconds;
+}
+
+/**********************************************************************
+* Function:			solveRiseTimes
+* Purpose: 			Finds when every target first clears the altitude limit before any slews are modeled
+* Precondition:		Pass in the targets and the window of the plan
+* Postcondition:	firstVisibleJd holds 0 for targets already up at startJd, just after the rise for targets that
+*					rise later, and past endJd for targets that never rise, so fitTarget() skips straight to the
+*					rise instead of searching for it and drops targets that never come up without searching
+************************************************************************/
+void observingScheduler::solveRiseTimes(const std::vector<observingTarget> &targets, double startJd, double endJd)
+{
+	std::vector<twoAxisDeg> raDec;
+	for (int i = 0; i < (int)targets.size(); i++)
+	{
+		raDec.push_back(targets[i].raDec);
+	}
+
+	visibilityPlanner planner(mount.getLatLongDeg(), startJd, endJd, mount.getSlewLimits().minAltDeg);
+	std::vector<targetEvents> events = planner.solve(raDec);
+
+	firstVisibleJd.assign(targets.size(), 0);
+	for (int i = 0; i < (int)targets.size(); i++)
+	{
+		if (events[i].neverUp)
+		{
+			firstVisibleJd[i] = endJd + 1;
+		}
+		else if (events[i].riseJd != NO_EVENT && planner.altitudeDeg(raDec[i], startJd) < mount.getSlewLimits().minAltDeg)
+		{
+			firstVisibleJd[i] = events[i].riseJd + RISE_MARGIN_SECONDS / SECONDS_PER_DAY;
+		}
+	}
+}
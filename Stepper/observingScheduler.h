@@ -0,0 +1,104 @@
+/*************************************************************
+* Filename:			observingScheduler.h
+* Purpose:			Order a night's observing list so the least time is spent slewing and waiting, then run it
+**************************************************************/
+#pragma once
+
+#include <vector>			//std::vector
+#include <fstream>			//std::ifstream
+#include <sstream>			//std::istringstream
+#include <string>			//std::string, getline()
+#include "coordinate.h"		//twoAxisDeg, equatorialToLocal(), slew model
+#include "visibilityPlanner.h"	//Rise times of the whole list at once
+
+#define RISE_SEARCH_STEP_SECONDS 300.0		//Resolution used when waiting for a target to rise
+#define RISE_MARGIN_SECONDS 1.0				//Start this long after a solved rise so the target is clearly up
+#define MAX_TWO_OPT_PASSES 50
+#define UNREACHABLE_SLEW_SECONDS 1e9		//Cost of a move the cable-wrap does not allow, so 2-opt never picks it
+
+/************************************************************************
+* Struct: 		observingTarget
+* Purpose:		One entry of the observing list
+* Data members:	raDec			- x = RA, y = Dec in degrees
+*				dwellSeconds	- How long to track the target once there
+*				windowStartJd	- Earliest julian date to start, 0 for no limit
+*				windowEndJd		- Latest julian date to finish, 0 for no limit
+*************************************************************************/
+typedef struct observingTarget
+{
+	twoAxisDeg raDec;
+	double dwellSeconds;
+	double windowStartJd;
+	double windowEndJd;
+} observingTarget;
+
+/************************************************************************
+* Struct: 		scheduledTarget
+* Purpose:		One entry of a finished plan
+* Data members:	index			- Index into the target list passed to plan()
+*				slewSeconds		- Modeled time to slew from the previous entry
+*				waitSeconds		- Time spent waiting for the target's window or for it to rise
+*				startJd			- Julian date the dwell starts
+*				endJd			- Julian date the dwell ends
+*************************************************************************/
+typedef struct scheduledTarget
+{
+	int index;
+	double slewSeconds;
+	double waitSeconds;
+	double startJd;
+	double endJd;
+} scheduledTarget;
+
+/************************************************************************
+* Struct: 		observingPlan
+* Purpose:		Ordered plan produced by observingScheduler
+* Data members:	order				- Targets in the order to visit them
+*				skipped				- Indexes of targets that could not fit into their visibility window
+*				totalSlewSeconds	- Sum of modeled slew times
+*				totalWaitSeconds	- Sum of waiting times
+*************************************************************************/
+typedef struct observingPlan
+{
+	std::vector<scheduledTarget> order;
+	std::vector<int> skipped;
+	double totalSlewSeconds;
+	double totalWaitSeconds;
+} observingPlan;
+
+/************************************************************************
+* Class: 		observingScheduler
+* Purpose:		Finds a visiting order for an observing list with a nearest-neighbour tour improved by 2-opt,
+*				using the mount's slew model and Alt / Az positions at the projected times
+* Data members:	mount	- Calibrated telescope used for coordinates, limits, and for running the plan
+*
+* Methods:		loadTargets
+*				plan
+*				execute
+*************************************************************************/
+class observingScheduler
+{
+	public:
+		observingScheduler(coordinate &mount);
+
+		//Reads an observing list, one target per line: RA(deg) Dec(deg) dwell(s) [windowStartJd windowEndJd]
+		static std::vector<observingTarget> loadTargets(const char *filename);
+
+		//Plans the list starting at startJd, nothing may run past endJd
+		observingPlan plan(const std::vector<observingTarget> &targets, double startJd, double endJd);
+
+		//Slews to and tracks every target of a plan in order
+		void execute(const std::vector<observingTarget> &targets, const observingPlan &plan);
+
+	private:
+		observingPlan simulate(const std::vector<observingTarget> &targets, const std::vector<int> &order, double startJd, double endJd);
+		bool fitTarget(const std::vector<observingTarget> &targets, int index, twoAxisDeg fromAltAz, double fromJd, double endJd, scheduledTarget &entry, twoAxisDeg &endAltAz);
+		bool isVisible(const observingTarget &target, double julianDate);
+		twoAxisDeg altAzAt(const observingTarget &target, double julianDate);
+		double planCost(const observingPlan &plan);
+		void solveRiseTimes(const std::vector<observingTarget> &targets, double startJd, double endJd);
+
+		coordinate &mount;
+		std::vector<double> visibleFromJd;		//Per target, earliest time found so far that it can start, times only move forward within one pass
+		std::vector<double> firstVisibleJd;		//Per target, when it first rises above the altitude limit, what each pass starts visibleFromJd at
+};
@@ -0,0 +1,214 @@
+/*************************************************************
+* Filename:			pecTable.cpp
+* Purpose:			Periodic error correction, record the repeating gearbox error once and play it back while tracking
+**************************************************************/
+#include "pecTable.h"
+
+#include <stdio.h>		//fopen(), fread(), fwrite()
+
+/**********************************************************************
+* Function:			pecTable (constructor)
+* Purpose: 			Creates an empty table for the default gearbox
+* Precondition:		None
+* Postcondition:	Every correction is 0 until a table is recorded or loaded
+************************************************************************/
+pecTable::pecTable() : pecTable(DEFAULT_PEC_PERIOD_STEPS)
+{
+}
+
+/**********************************************************************
+* Function:			pecTable (constructor override)
+* Purpose: 			Creates an empty table for an error period
+* Precondition:		Pass in the microsteps in one error period, at least PEC_TABLE_BINS
+* Postcondition:	Every correction is 0 until a table is recorded or loaded
+************************************************************************/
+pecTable::pecTable(int64_t periodSteps)
+{
+	this->periodSteps = (periodSteps < PEC_TABLE_BINS) ? PEC_TABLE_BINS : periodSteps;
+	clear();
+}
+
+/**********************************************************************
+* Function:			clear
+* Purpose: 			Forgets the table
+* Precondition:		None
+* Postcondition:	Every correction is 0 and recording has stopped
+************************************************************************/
+void pecTable::clear()
+{
+	for (int i = 0; i <= PEC_TABLE_BINS; i++)
+	{
+		table[i] = 0;
+	}
+	for (int i = 0; i < PEC_TABLE_BINS; i++)
+	{
+		sums[i] = 0;
+		counts[i] = 0;
+	}
+	recording = false;
+	valid = false;
+}
+
+/**********************************************************************
+* Function:			startRecording
+* Purpose: 			Starts collecting corrections
+* Precondition:		None
+* Postcondition:	Samples from any earlier recording are dropped, the current table is still played back
+************************************************************************/
+void pecTable::startRecording()
+{
+	for (int i = 0; i < PEC_TABLE_BINS; i++)
+	{
+		sums[i] = 0;
+		counts[i] = 0;
+	}
+	recording = true;
+}
+
+/**********************************************************************
+* Function:			record
+* Purpose: 			Adds one measured correction
+* Precondition:		Pass in the axis position in microsteps and the microsteps the axis had to be moved to be on
+*					target there, the opposite of the pointing error
+* Postcondition:	The sample is added to the nearest bin, ignored if not recording
+************************************************************************/
+void pecTable::record(int64_t steps, double correctionSteps)
+{
+	if (!recording)
+	{
+		return;
+	}
+
+	int64_t bin = ((phaseOf(steps) * PEC_TABLE_BINS + periodSteps / 2) / periodSteps) % PEC_TABLE_BINS;
+	sums[bin] += correctionSteps;
+	counts[bin]++;
+}
+
+/**********************************************************************
+* Function:			finishRecording
+* Purpose: 			Turns the collected samples into the table
+* Precondition:		Call after recording at least part of one period, several whole periods average out noise
+* Postcondition:	Returns true and replaces the table if any sample was recorded. Empty bins are interpolated
+*					from their neighbours and the mean is removed, a constant offset is not periodic error.
+************************************************************************/
+bool pecTable::finishRecording()
+{
+	recording = false;
+
+	int first = -1;
+	for (int i = 0; i < PEC_TABLE_BINS && first < 0; i++)
+	{
+		if (counts[i] > 0)
+		{
+			first = i;
+		}
+	}
+	if (first < 0)
+	{
+		return false;
+	}
+
+	//Walk once around the circle from the first filled bin, filling gaps between each pair of filled bins
+	int previous = first;
+	for (int n = 1; n <= PEC_TABLE_BINS; n++)
+	{
+		int i = (first + n) % PEC_TABLE_BINS;
+		if (counts[i] == 0)
+		{
+			continue;
+		}
+
+		double from = sums[previous] / counts[previous];
+		double to = sums[i] / counts[i];
+		int gap = (i - previous + PEC_TABLE_BINS) % PEC_TABLE_BINS;
+		if (gap == 0)
+		{
+			gap = PEC_TABLE_BINS;
+		}
+		for (int k = 0; k < gap; k++)
+		{
+			table[(previous + k) % PEC_TABLE_BINS] = (float)(from + (to - from) * k / gap);
+		}
+		previous = i;
+	}
+
+	double mean = 0;
+	for (int i = 0; i < PEC_TABLE_BINS; i++)
+	{
+		mean += table[i];
+	}
+	mean /= PEC_TABLE_BINS;
+	for (int i = 0; i < PEC_TABLE_BINS; i++)
+	{
+		table[i] -= (float)mean;
+	}
+	table[PEC_TABLE_BINS] = table[0];
+
+	valid = true;
+	return true;
+}
+
+/**********************************************************************
+* Function:			save
+* Purpose: 			Writes the table to a file
+* Precondition:		Pass in the file path
+* Postcondition:	Returns true if the whole table was written
+************************************************************************/
+bool pecTable::save(const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	pecFileHeader header;
+	header.magic = PEC_FILE_MAGIC;
+	header.version = PEC_FILE_VERSION;
+	header.bins = PEC_TABLE_BINS;
+	header.padding = 0;
+	header.periodSteps = periodSteps;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(table, sizeof(float), PEC_TABLE_BINS, file) == PEC_TABLE_BINS;
+
+	return (fclose(file) == 0) && written;
+}
+
+/**********************************************************************
+* Function:			load
+* Purpose: 			Reads a table saved by save()
+* Precondition:		Pass in the file path
+* Postcondition:	Returns true and replaces the table if the file matches this layout and error period,
+*					otherwise the table is left as it was
+************************************************************************/
+bool pecTable::load(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	pecFileHeader header;
+	float loaded[PEC_TABLE_BINS];
+	bool read = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == PEC_FILE_MAGIC && header.version == PEC_FILE_VERSION &&
+		header.bins == PEC_TABLE_BINS && header.periodSteps == periodSteps &&
+		fread(loaded, sizeof(float), PEC_TABLE_BINS, file) == PEC_TABLE_BINS;
+	fclose(file);
+
+	if (!read)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < PEC_TABLE_BINS; i++)
+	{
+		table[i] = loaded[i];
+	}
+	table[PEC_TABLE_BINS] = table[0];
+	valid = true;
+
+	return true;
+}
@@ -0,0 +1,111 @@
+/*************************************************************
+* Filename:			pecTable.h
+* Purpose:			Periodic error correction, record the repeating gearbox error once and play it back while tracking
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t, uint32_t
+
+#define PEC_TABLE_BINS 256
+#define PEC_FILE_MAGIC 0x43455053		//"SPEC"
+#define PEC_FILE_VERSION 1
+
+//One turn of the 100:1 gearbox output at 1600 microsteps, the error repeats with this period
+#define DEFAULT_PEC_PERIOD_STEPS 160000
+#define DEFAULT_ALT_PEC_PATH "pecAlt.bin"
+#define DEFAULT_AZ_PEC_PATH "pecAz.bin"
+
+/************************************************************************
+* Enum: 		pecMode
+* Purpose:		What the tracking loop does with the PEC tables
+* Values:		PEC_OFF			- Tables are ignored
+*				PEC_RECORD		- Corrections are collected into the tables
+*				PEC_PLAYBACK	- Table corrections are added to the tracking target
+*************************************************************************/
+enum pecMode
+{
+	PEC_OFF,
+	PEC_RECORD,
+	PEC_PLAYBACK
+};
+
+/************************************************************************
+* Struct: 		pecFileHeader
+* Purpose:		Start of a saved table, followed by PEC_TABLE_BINS floats
+* Data members:	magic / version	- Identifies the file layout
+*				bins			- Number of table entries
+*				periodSteps		- Microsteps in one error period
+*************************************************************************/
+typedef struct pecFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t bins;
+	uint32_t padding;
+	int64_t periodSteps;
+} pecFileHeader;
+
+/************************************************************************
+* Class: 		pecTable
+* Purpose:		Correction of one axis against its phase in the error period. The phase comes straight from
+*				the exact microstep counter, so playback is one modulo, one multiply and one interpolation.
+* Data members:	periodSteps	- Microsteps in one error period
+*				table		- Correction in microsteps at each bin, the extra last entry repeats the first
+*				sums / counts	- Samples collected per bin while recording
+*				recording	- True between startRecording and finishRecording
+*				valid		- True once a table was recorded or loaded
+*
+* Methods:		startRecording
+*				record
+*				finishRecording
+*				correction
+*				phaseOf
+*				isRecording
+*				isValid
+*				clear
+*				getPeriodSteps
+*				save
+*				load
+*************************************************************************/
+class pecTable
+{
+	public:
+		pecTable();
+		pecTable(int64_t periodSteps);
+
+		void startRecording();
+		void record(int64_t steps, double correctionSteps);
+		bool finishRecording();
+
+		//Hot path - interpolated correction in microsteps at an axis position
+		double correction(int64_t steps)
+		{
+			int64_t scaled = phaseOf(steps) * PEC_TABLE_BINS;
+			int64_t bin = scaled / periodSteps;
+			double fraction = (double)(scaled - bin * periodSteps) / (double)periodSteps;
+
+			return table[bin] + (table[bin + 1] - table[bin]) * fraction;
+		}
+
+		int64_t phaseOf(int64_t steps)
+		{
+			int64_t phase = steps % periodSteps;
+			return (phase < 0) ? phase + periodSteps : phase;
+		}
+
+		bool isRecording() { return recording; }
+		bool isValid() { return valid; }
+		void clear();
+		int64_t getPeriodSteps() { return periodSteps; }
+
+		bool save(const char *path);
+		bool load(const char *path);
+
+	private:
+		int64_t periodSteps;
+		float table[PEC_TABLE_BINS + 1];
+		double sums[PEC_TABLE_BINS];
+		uint32_t counts[PEC_TABLE_BINS];
+		bool recording;
+		bool valid;
+};
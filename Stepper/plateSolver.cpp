@@ -0,0 +1,424 @@
+/*************************************************************
+* Filename:			plateSolver.cpp
+* Purpose:			Find where a finder camera is pointed from the stars it sees, with no starting guess
+**************************************************************/
+#include "plateSolver.h"
+#include "sidereal.h"		//DEG_TO_RAD, RAD_TO_DEG
+
+#include <fstream>		//std::ifstream
+#include <sstream>		//std::istringstream
+#include <string>		//std::string, getline()
+#include <algorithm>	//std::sort()
+#include <chrono>		//std::chrono::steady_clock
+#include <stdio.h>		//fopen(), fprintf()
+#include <math.h>		//sin(), cos(), atan2(), hypot()
+
+/**********************************************************************
+* Function:			fitSimilarity
+* Purpose: 			Least squares rotation, scale and offset from one set of points to another
+* Precondition:		Pass in n >= 2 points (zx, zy) and where they should land (wx, wy)
+* Postcondition:	transform holds a and b of w = a * z + b as complex numbers: re(a), im(a), re(b), im(b)
+************************************************************************/
+static void fitSimilarity(const double *zx, const double *zy, const double *wx, const double *wy, int n, double transform[4])
+{
+	double zMeanX = 0, zMeanY = 0, wMeanX = 0, wMeanY = 0;
+	for (int i = 0; i < n; i++)
+	{
+		zMeanX += zx[i];
+		zMeanY += zy[i];
+		wMeanX += wx[i];
+		wMeanY += wy[i];
+	}
+	zMeanX /= n;
+	zMeanY /= n;
+	wMeanX /= n;
+	wMeanY /= n;
+
+	//a = sum((w - wMean) * conj(z - zMean)) / sum(|z - zMean|^2)
+	double re = 0, im = 0, norm = 0;
+	for (int i = 0; i < n; i++)
+	{
+		double dzx = zx[i] - zMeanX;
+		double dzy = zy[i] - zMeanY;
+		double dwx = wx[i] - wMeanX;
+		double dwy = wy[i] - wMeanY;
+		re += dwx * dzx + dwy * dzy;
+		im += dwy * dzx - dwx * dzy;
+		norm += dzx * dzx + dzy * dzy;
+	}
+
+	transform[0] = (norm > 0) ? re / norm : 0;
+	transform[1] = (norm > 0) ? im / norm : 0;
+	transform[2] = wMeanX - (transform[0] * zMeanX - transform[1] * zMeanY);
+	transform[3] = wMeanY - (transform[0] * zMeanY + transform[1] * zMeanX);
+}
+
+/**********************************************************************
+* Function:			plateSolver (constructor)
+* Purpose: 			Creates a solver
+* Precondition:		index must be open and outlive the solver
+* Postcondition:	Ready to solve
+************************************************************************/
+plateSolver::plateSolver(starIndex &index) : index(index)
+{
+}
+
+/**********************************************************************
+* Function:			solve
+* Purpose: 			Finds where a frame is pointed
+* Precondition:		Pass in the frame's centroids
+* Postcondition:	Returns the first pointing that enough catalog stars agree with. The frame is tried as
+*					seen and then mirrored, and quads from the brightest stars are tried first.
+************************************************************************/
+plateSolution plateSolver::solve(const centroidList &frame)
+{
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	plateSolution solution;
+	solution.solved = false;
+	solution.tried = 0;
+	solution.matched = 0;
+
+	std::vector<int> brightest(frame.stars.size());
+	for (int i = 0; i < (int)brightest.size(); i++)
+	{
+		brightest[i] = i;
+	}
+	std::sort(brightest.begin(), brightest.end(), [&frame](int a, int b) { return frame.stars[a].flux > frame.stars[b].flux; });
+	int count = (brightest.size() < SOLVER_IMAGE_STARS) ? (int)brightest.size() : SOLVER_IMAGE_STARS;
+
+	for (int parity = 0; parity < 2 && !solution.solved; parity++)
+	{
+		double xSign = parity ? -1 : 1;
+
+		//Every set of four, growing outward from the brightest stars
+		for (int d = 3; d < count && !solution.solved; d++)
+		{
+			for (int c = 2; c < d && !solution.solved; c++)
+			{
+				for (int b = 1; b < c && !solution.solved; b++)
+				{
+					for (int a = 0; a < b && !solution.solved; a++)
+					{
+						int members[4] = { brightest[a], brightest[b], brightest[c], brightest[d] };
+						double x[4];
+						double y[4];
+						for (int i = 0; i < 4; i++)
+						{
+							x[i] = xSign * frame.stars[members[i]].x;
+							y[i] = frame.stars[members[i]].y;
+						}
+
+						int order[4];
+						double code[4];
+						if (!starIndex::quadCode(x, y, order, code))
+						{
+							continue;
+						}
+
+						//Noise can flip which way A / B and C / D were picked when it was close, so try both
+						int variants = 1;
+						int orders[4][4];
+						double codes[4][4];
+						for (int i = 0; i < 4; i++)
+						{
+							orders[0][i] = order[i];
+							codes[0][i] = code[i];
+						}
+						if (fabs(code[0] + code[2] - 1) < SOLVER_CODE_TOLERANCE)
+						{
+							int swapped[4] = { order[1], order[0], order[3], order[2] };
+							double swappedCode[4] = { 1 - code[2], 1 - code[3], 1 - code[0], 1 - code[1] };
+							for (int i = 0; i < 4; i++)
+							{
+								orders[variants][i] = swapped[i];
+								codes[variants][i] = swappedCode[i];
+							}
+							variants++;
+						}
+						for (int v = variants - 1; v >= 0; v--)
+						{
+							if (fabs(codes[v][0] - codes[v][2]) < SOLVER_CODE_TOLERANCE)
+							{
+								int swapped[4] = { orders[v][0], orders[v][1], orders[v][3], orders[v][2] };
+								double swappedCode[4] = { codes[v][2], codes[v][3], codes[v][0], codes[v][1] };
+								for (int i = 0; i < 4; i++)
+								{
+									orders[variants][i] = swapped[i];
+									codes[variants][i] = swappedCode[i];
+								}
+								variants++;
+							}
+						}
+
+						for (int v = 0; v < variants && !solution.solved; v++)
+						{
+							double quadX[4];
+							double quadY[4];
+							int low[4];
+							int high[4];
+							for (int i = 0; i < 4; i++)
+							{
+								quadX[i] = x[orders[v][i]];
+								quadY[i] = y[orders[v][i]];
+								low[i] = starIndex::codeBin(codes[v][i] - SOLVER_CODE_TOLERANCE);
+								high[i] = starIndex::codeBin(codes[v][i] + SOLVER_CODE_TOLERANCE);
+							}
+
+							//Every bin the code could have fallen in, at most 2 per value since the tolerance is under one bin
+							int bins[4];
+							for (bins[0] = low[0]; bins[0] <= high[0] && !solution.solved; bins[0]++)
+							for (bins[1] = low[1]; bins[1] <= high[1] && !solution.solved; bins[1]++)
+							for (bins[2] = low[2]; bins[2] <= high[2] && !solution.solved; bins[2]++)
+							for (bins[3] = low[3]; bins[3] <= high[3] && !solution.solved; bins[3]++)
+							{
+								const indexQuad *first;
+								const indexQuad *last;
+								index.findQuads(starIndex::codeKey(bins), first, last);
+
+								for (const indexQuad *quad = first; quad != last && !solution.solved; quad++)
+								{
+									if (fabs(quad->code[0] - codes[v][0]) < SOLVER_CODE_TOLERANCE &&
+										fabs(quad->code[1] - codes[v][1]) < SOLVER_CODE_TOLERANCE &&
+										fabs(quad->code[2] - codes[v][2]) < SOLVER_CODE_TOLERANCE &&
+										fabs(quad->code[3] - codes[v][3]) < SOLVER_CODE_TOLERANCE)
+									{
+										solution.tried++;
+										checkQuad(*quad, quadX, quadY, xSign, frame, solution);
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	solution.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return solution;
+}
+
+/**********************************************************************
+* Function:			checkQuad
+* Purpose: 			Tests one catalog quad against the frame
+* Precondition:		Pass in the quad, the matching frame points in the same A, B, C, D order with x already
+*					multiplied by xSign, the frame, and the solution to fill
+* Postcondition:	Returns true and fills solution if enough catalog stars land on centroids. The fit is then
+*					redone with every matched star, projected about the frame's own center.
+************************************************************************/
+bool plateSolver::checkQuad(const indexQuad &quad, const double x[4], const double y[4], double xSign, const centroidList &frame, plateSolution &solution)
+{
+	const indexStar &a = index.getStar(quad.stars[0]);
+	double center[3] = { a.x, a.y, a.z };
+	double transform[4];
+	double xi[4];
+	double eta[4];
+
+	//Frame center on the sky from the four stars, projected first about star A then about the center itself
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			const indexStar &star = index.getStar(quad.stars[i]);
+			double vector[3] = { star.x, star.y, star.z };
+			if (!starIndex::toTangent(vector, center, xi[i], eta[i]))
+			{
+				return false;
+			}
+		}
+		fitSimilarity(x, y, xi, eta, 4, transform);
+
+		//The four stars have to fit the shape, not just the code
+		for (int i = 0; i < 4; i++)
+		{
+			double fitXi = transform[0] * x[i] - transform[1] * y[i] + transform[2];
+			double fitEta = transform[0] * y[i] + transform[1] * x[i] + transform[3];
+			if (hypot(fitXi - xi[i], fitEta - eta[i]) > SOLVER_MATCH_PIXELS * hypot(transform[0], transform[1]))
+			{
+				return false;
+			}
+		}
+
+		double cx = xSign * frame.width / 2.0;
+		double cy = frame.height / 2.0;
+		double centerXi = transform[0] * cx - transform[1] * cy + transform[2];
+		double centerEta = transform[0] * cy + transform[1] * cx + transform[3];
+		double moved[3];
+		starIndex::fromTangent(centerXi, centerEta, center, moved);
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = moved[i];
+		}
+	}
+
+	std::vector<uint32_t> matchedStars;
+	std::vector<int> matchedCentroids;
+	if (matchStars(center, transform, xSign, frame, matchedStars, matchedCentroids) < SOLVER_MIN_MATCHES)
+	{
+		return false;
+	}
+
+	//Refit with every match, then move the center onto the frame's center again
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int n = (int)matchedStars.size();
+		std::vector<double> zx(n), zy(n), wx(n), wy(n);
+		for (int i = 0; i < n; i++)
+		{
+			const indexStar &star = index.getStar(matchedStars[i]);
+			double vector[3] = { star.x, star.y, star.z };
+			starIndex::toTangent(vector, center, wx[i], wy[i]);
+			zx[i] = xSign * frame.stars[matchedCentroids[i]].x;
+			zy[i] = frame.stars[matchedCentroids[i]].y;
+		}
+		fitSimilarity(zx.data(), zy.data(), wx.data(), wy.data(), n, transform);
+
+		double cx = xSign * frame.width / 2.0;
+		double cy = frame.height / 2.0;
+		double moved[3];
+		starIndex::fromTangent(transform[0] * cx - transform[1] * cy + transform[2], transform[0] * cy + transform[1] * cx + transform[3], center, moved);
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = moved[i];
+		}
+	}
+
+	solution.solved = true;
+	solution.raDec = starIndex::toRaDec(center);
+	solution.rotationDeg = atan2(transform[1], transform[0]) * RAD_TO_DEG;
+	solution.arcsecPerPixel = hypot(transform[0], transform[1]) * ARCSEC_PER_RAD;
+	solution.mirrored = (xSign < 0);
+	solution.matched = (int)matchedStars.size();
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			matchStars
+* Purpose: 			Pairs catalog stars that fall in the frame with centroids
+* Precondition:		Pass in the frame center as a unit vector, the transform from frame points (x multiplied by
+*					xSign) to the plane about that center, and the frame
+* Postcondition:	Returns the number of pairs, each centroid is used at most once
+************************************************************************/
+int plateSolver::matchStars(const double center[3], const double transform[4], double xSign, const centroidList &frame,
+	std::vector<uint32_t> &matchedStars, std::vector<int> &matchedCentroids)
+{
+	double scale = hypot(transform[0], transform[1]);
+	double radius = hypot(frame.width, frame.height) / 2.0 * scale * 1.1;
+	double dec = asin(center[2]);
+	double minZ = sin((dec - radius < -M_PI / 2) ? -M_PI / 2 : dec - radius);
+	double maxZ = sin((dec + radius > M_PI / 2) ? M_PI / 2 : dec + radius);
+	double cosRadius = cos(radius);
+	double normSquared = scale * scale;
+	std::vector<bool> used(frame.stars.size(), false);
+
+	matchedStars.clear();
+	matchedCentroids.clear();
+
+	uint32_t first;
+	uint32_t last;
+	index.findStars(minZ, maxZ, first, last);
+	for (uint32_t s = first; s < last; s++)
+	{
+		const indexStar &star = index.getStar(s);
+		double vector[3] = { star.x, star.y, star.z };
+		double xi;
+		double eta;
+		if (vector[0] * center[0] + vector[1] * center[1] + vector[2] * center[2] < cosRadius || !starIndex::toTangent(vector, center, xi, eta))
+		{
+			continue;
+		}
+
+		//z = (w - b) / a
+		double dx = xi - transform[2];
+		double dy = eta - transform[3];
+		double px = xSign * (dx * transform[0] + dy * transform[1]) / normSquared;
+		double py = (dy * transform[0] - dx * transform[1]) / normSquared;
+		if (px < 0 || py < 0 || px > frame.width || py > frame.height)
+		{
+			continue;
+		}
+
+		int nearest = -1;
+		double nearestDistance = SOLVER_MATCH_PIXELS;
+		for (int i = 0; i < (int)frame.stars.size(); i++)
+		{
+			double distance = hypot(frame.stars[i].x - px, frame.stars[i].y - py);
+			if (!used[i] && distance < nearestDistance)
+			{
+				nearest = i;
+				nearestDistance = distance;
+			}
+		}
+
+		if (nearest >= 0)
+		{
+			used[nearest] = true;
+			matchedStars.push_back(s);
+			matchedCentroids.push_back(nearest);
+		}
+	}
+
+	return (int)matchedStars.size();
+}
+
+/**********************************************************************
+* Function:			loadCentroids
+* Purpose: 			Reads a frame's centroids from a text file
+* Precondition:		The first line holds the frame width and height in pixels, then one star per line: x y flux.
+*					Blank lines and lines starting with # are ignored.
+* Postcondition:	Returns true if the frame size was read
+************************************************************************/
+bool plateSolver::loadCentroids(const char *path, centroidList &frame)
+{
+	std::ifstream file(path);
+	std::string line;
+	bool sized = false;
+
+	frame.stars.clear();
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		if (!sized)
+		{
+			sized = (bool)(fields >> frame.width >> frame.height);
+			continue;
+		}
+
+		centroid star;
+		if (fields >> star.x >> star.y >> star.flux)
+		{
+			frame.stars.push_back(star);
+		}
+	}
+
+	return sized;
+}
+
+/**********************************************************************
+* Function:			saveCentroids
+* Purpose: 			Writes a frame's centroids in the format loadCentroids() reads
+* Precondition:		Pass in the frame and the file path
+* Postcondition:	Returns true if the file was written
+************************************************************************/
+bool plateSolver::saveCentroids(const centroidList &frame, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool written = fprintf(file, "#width height, then x y flux\n%d %d\n", frame.width, frame.height) > 0;
+	for (size_t i = 0; i < frame.stars.size() && written; i++)
+	{
+		written = fprintf(file, "%.3f %.3f %.1f\n", frame.stars[i].x, frame.stars[i].y, frame.stars[i].flux) > 0;
+	}
+
+	return (fclose(file) == 0) && written;
+}
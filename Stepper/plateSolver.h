@@ -0,0 +1,96 @@
+/*************************************************************
+* Filename:			plateSolver.h
+* Purpose:			Find where a finder camera is pointed from the stars it sees, with no starting guess
+**************************************************************/
+#pragma once
+
+#include <vector>			//std::vector
+#include "starIndex.h"		//starIndex, quad codes, projections
+
+#define SOLVER_IMAGE_STARS 12				//Brightest centroids that quads are made from
+#define SOLVER_CODE_TOLERANCE 0.01			//Largest difference in any code value for a quad to be tried
+#define SOLVER_MATCH_PIXELS 3.0				//A catalog star this close to a centroid is a match
+#define SOLVER_MIN_MATCHES 6				//Matches needed to accept a pointing
+#define ARCSEC_PER_RAD 206264.806
+
+/************************************************************************
+* Struct: 		centroid
+* Purpose:		One star found in a frame
+* Data members:	x / y	- Pixel position, x right and y down from the top left corner
+*				flux	- Brightness, only the order matters
+*************************************************************************/
+typedef struct centroid
+{
+	double x;
+	double y;
+	double flux;
+} centroid;
+
+/************************************************************************
+* Struct: 		centroidList
+* Purpose:		Every star found in one frame
+* Data members:	width / height	- Frame size in pixels
+*				stars			- Centroids, in any order
+*************************************************************************/
+typedef struct centroidList
+{
+	int width;
+	int height;
+	std::vector<centroid> stars;
+} centroidList;
+
+/************************************************************************
+* Struct: 		plateSolution
+* Purpose:		Result of solve()
+* Data members:	solved			- False if no pointing was found, nothing else is set then
+*				raDec			- Sky position of the center of the frame in degrees
+*				rotationDeg		- Angle from the frame's x axis to east
+*				arcsecPerPixel	- Plate scale
+*				mirrored		- True if the optics flip the image
+*				matched			- Catalog stars found in the frame
+*				tried			- Candidate quads checked against the catalog
+*				seconds			- Time taken
+*************************************************************************/
+typedef struct plateSolution
+{
+	bool solved;
+	twoAxisDeg raDec;
+	double rotationDeg;
+	double arcsecPerPixel;
+	bool mirrored;
+	int matched;
+	int tried;
+	double seconds;
+} plateSolution;
+
+/************************************************************************
+* Class: 		plateSolver
+* Purpose:		Lost in space plate solving. Every set of four of the brightest centroids is turned into a
+*				quad code, and quads with the same code are looked up in the index. Each hit gives a rotation,
+*				scale and offset from the frame to the sky, which is accepted once enough other catalog stars
+*				land on centroids. Neither the pointing, the scale, nor the rotation needs to be known.
+* Data members:	index	- Open index to search
+*
+* Methods:		solve
+*				loadCentroids
+*				saveCentroids
+*************************************************************************/
+class plateSolver
+{
+	public:
+		plateSolver(starIndex &index);
+
+		plateSolution solve(const centroidList &frame);
+
+		//Centroid text file: the frame's width and height on the first line, then one star per line: x y flux
+		static bool loadCentroids(const char *path, centroidList &frame);
+		static bool saveCentroids(const centroidList &frame, const char *path);
+
+	private:
+		bool checkQuad(const indexQuad &quad, const double x[4], const double y[4], double xSign, const centroidList &frame,
+			plateSolution &solution);
+		int matchStars(const double center[3], const double transform[4], double xSign, const centroidList &frame,
+			std::vector<uint32_t> &matchedStars, std::vector<int> &matchedCentroids);
+
+		starIndex &index;
+};
@@ -6,6 +6,10 @@
 * Purpose:			Calculates local sidereal time
 **************************************************************/
 #include "sidereal.h"
+#include "fastTrig.h"	//trigWrapTwoPi()
+
+//Time reads use the system clock until a simulation replaces it
+std::atomic<clockSource *> sidereal::clock(systemClock::instance());
 
 /**********************************************************************
 * Function:			displayTmMMDDYYYY
@@ -138,14 +142,14 @@ double sidereal::dmsToDeg(double degrees, double minutes, double seconds)
 ************************************************************************/
 tm sidereal::getGMT()
 {
-	time_t m_rawTime;
-	//Get time
-	time(&m_rawTime);
+	//Get time from the current clock
+	time_t m_rawTime = (time_t)floor(getClock()->unixSeconds());
 
-	//Set timeInfo struct equal to return value of gmtime()
-	tm *timeInfo = gmtime(&m_rawTime);
+	//Fill timeInfo with gmtime_r(), plain gmtime() shares one buffer between threads
+	tm timeInfo;
+	gmtime_r(&m_rawTime, &timeInfo);
 
-	return *timeInfo;
+	return timeInfo;
 }
 
 /**********************************************************************
@@ -182,10 +186,15 @@ double sidereal::getLMST(double rads, double longitudeEast)
 double sidereal::getJulianDate()
 {
 	double julianDate;
-	struct tm timeInfo = getGMT();
+
+	//One clock read for both the calendar fields and the fraction of the current second
+	double unixSeconds = getClock()->unixSeconds();
+	time_t rawTime = (time_t)floor(unixSeconds);
+	struct tm timeInfo;
+	gmtime_r(&rawTime, &timeInfo);
 
 	//Create a variable for amount of days this year including the fractional current day (current time, noon = .5 of a day), The + 1 on tm_yday is to account for it starting at 0 instead of 1 for Jan 1st.
-	double days = (timeInfo.tm_yday + 1)+ (((timeInfo.tm_hour)) / 24.0) + (timeInfo.tm_min / 1440.0) + (timeInfo.tm_sec / 86400.0);
+	double days = (timeInfo.tm_yday + 1)+ (((timeInfo.tm_hour)) / 24.0) + (timeInfo.tm_min / 1440.0) + ((timeInfo.tm_sec + (unixSeconds - rawTime)) / 86400.0);
 
 	//Correct for Leap year if applicable
 	if (__isleap(timeInfo.tm_year) != 0)
@@ -209,21 +218,25 @@ double sidereal::getJulianDate()
 ************************************************************************/
 double sidereal::getGMSTinRads()
 {
-	//Get julian date and convert to j2000, then divide by centuries
-	double t = ((getJulianDate() - 2451545.0) / 36525.0);
-
-	//Formula for GMST from IAU 2000 expressed in seconds, and converted to Rads
-	double GMST = getERA() + (0.014506 + (4612.156534 * t) + (1.3915817 * t * t) - (0.00000044 * t * t * t) - (0.000029956 * t * t * t * t) - (0.0000000368 * t * t * t * t * t)) / 60.0 / 60.0 * (M_PI / 180.0);
+	return getGMSTinRads(getJulianDate());
+}
 
-	GMST = fmod(GMST, 2 * M_PI);
+/**********************************************************************
+* Function:			getGMSTinRads (override)
+* Purpose: 			Calculate GMST at a given julian date and return it as a double in Radians
+* Precondition:		Pass in a julian date, Ex: getJulianDate() + seconds / SECONDS_PER_DAY for a time in the future
+* Postcondition:	Returns a double containing GMST in radians
+************************************************************************/
+double sidereal::getGMSTinRads(double julianDate)
+{
+	//Convert julian date to j2000, then divide by centuries
+	double t = ((julianDate - 2451545.0) / 36525.0);
 
-	//Correct if negative
-	if (GMST < 0)
-	{
-		GMST += 2 * M_PI;
-	}
+	//Formula for GMST from IAU 2000 expressed in seconds, and converted to Rads
+	double GMST = getERA(julianDate) + (0.014506 + (4612.156534 * t) + (1.3915817 * t * t) - (0.00000044 * t * t * t) - (0.000029956 * t * t * t * t) - (0.0000000368 * t * t * t * t * t)) / 60.0 / 60.0 * (M_PI / 180.0);
 
-	return GMST;
+	//Reduce to [0, 2 pi)
+	return trigWrapTwoPi(GMST);
 }
 
 /**********************************************************************
@@ -235,15 +248,20 @@ double sidereal::getGMSTinRads()
 ************************************************************************/
 double sidereal::getERA()
 {
-	double theta = (2 * M_PI * (OFFSET + EARTHS_ROTATIONAL_SPEED * (getJulianDate() - 2451545.0)));
+	return getERA(getJulianDate());
+}
 
-	theta = fmod(theta, 2 * M_PI);
-	if (theta < 0)
-	{
-		theta += 2 * M_PI;
-	}
+/**********************************************************************
+* Function:			getERA (override)
+* Purpose: 			Calculate the Earth's Rotation Angle (ERA) at a given julian date
+* Precondition:		Pass in a julian date
+* Postcondition:	Returns a double containing the ERA in radians
+************************************************************************/
+double sidereal::getERA(double julianDate)
+{
+	double theta = (2 * M_PI * (OFFSET + EARTHS_ROTATIONAL_SPEED * (julianDate - 2451545.0)));
 
-	return theta;
+	return trigWrapTwoPi(theta);
 }
 
 /**********************************************************************
@@ -290,3 +308,25 @@ double sidereal::getGMSTinDEG()
 
 	return GMST;
 }
+
+/**********************************************************************
+* Function:			setClock
+* Purpose: 			Replaces the clock every time read goes through
+* Precondition:		Pass in a clock that outlives its use, or nullptr for the system clock
+* Postcondition:	Later reads from every thread use the new clock
+************************************************************************/
+void sidereal::setClock(clockSource *clock)
+{
+	sidereal::clock.store((clock != nullptr) ? clock : systemClock::instance());
+}
+
+/**********************************************************************
+* Function:			getClock
+* Purpose: 			Returns the clock time reads go through
+* Precondition:		None
+* Postcondition:	Returns the system clock unless setClock() replaced it
+************************************************************************/
+clockSource *sidereal::getClock()
+{
+	return clock.load(std::memory_order_relaxed);
+}
@@ -9,10 +9,14 @@
 
 #include <iostream> //For cout
 #include <math.h>	//M_PI, floor()
-#include <time.h>	//time(), time_t, tm, and __isleap()
+#include <time.h>	//time_t, tm, and __isleap()
+#include "clockSource.h"	//Where the time of day is read from
 
 #define EARTHS_ROTATIONAL_SPEED 1.00273781191135448
 #define OFFSET 0.7790572732640
+#define SECONDS_PER_DAY 86400.0
+#define DEG_TO_RAD (M_PI / 180.0)
+#define RAD_TO_DEG (180.0 / M_PI)
 
 using std::cout;
 using std::endl;
@@ -61,6 +65,8 @@ typedef struct hourMinuteSeconds
 *				getERA
 *				getERAcomplex
 *				getGMSTinDEG
+*				setClock
+*				getClock
 *************************************************************************/
 class sidereal
 {
@@ -91,7 +97,17 @@ class sidereal
 
 		//Sidereal time - Ordered most accurate to least accurate
 		static double getGMSTinRads();	//Returns Greenwich Mean Sidereal Time (GMST) in radians. Precisely in tune with apparant local sidereal time calculations
+		static double getGMSTinRads(double julianDate);	//GMST in radians at any julian date, used for planning ahead
 		static double getERA();			//Returns Earth Rotation Angle (ERA) in radians
+		static double getERA(double julianDate);		//ERA in radians at any julian date
 		static double getERAcomplex();	//Another method of getting Earth's Rotation Angle (ERA) in radians
 		static double getGMSTinDEG();	//Returns Greenwich Mean Sidereal Time (GMST) in degrees
+
+		/******************************** Clock **************************************/
+		//Every time read above goes through this clock, the system clock unless a simulation replaces it
+		static void setClock(clockSource *clock);
+		static clockSource *getClock();
+
+	private:
+		static std::atomic<clockSource *> clock;
 };
@@ -0,0 +1,775 @@
+/*************************************************************
+* Filename:			simulations.cpp
+* Purpose:			Benchmarks and simulations run from the command line, none of them need the mount
+**************************************************************/
+#include "simulations.h"
+#include "trigCheck.h"			//trigCheck, TRIG_CHECK_DEFAULT_STRIDE
+#include "mountDaemon.h"		//mountDaemon
+#include "stepScheduler.h"		//stepScheduler
+#include "axisDriver.h"			//axisDriver, azKinematics
+#include "visibilityPlanner.h"	//visibilityPlanner
+#include "surveyPlanner.h"		//surveyPlanner
+#include "pecTable.h"			//pecTable, DEFAULT_PEC_PERIOD_STEPS
+#include "sidereal.h"			//cout, endl, DEG_TO_RAD, RAD_TO_DEG, SECONDS_PER_DAY
+
+#include <string>		//std::string
+#include <stdlib.h>		//atoi(), atof()
+#include <time.h>		//clock_gettime(), CLOCK_THREAD_CPUTIME_ID
+#include <chrono>		//std::chrono::steady_clock
+#include <iomanip>		//std::setw, std::setfill
+#include <math.h>		//sin(), cos(), asin(), acos(), hypot(), pow(), log10(), llround()
+
+#define UNIX_EPOCH_JD 2440587.5
+
+/**********************************************************************
+* Function:			run
+* Purpose: 			The one entry point main() hands every test mode to
+* Precondition:		Pass in main's argc and argv
+* Postcondition:	Runs the mode named by argv[1] and returns the exit code, 1 with the usage if its arguments
+*					are wrong. Returns NOT_A_TEST_MODE without doing anything if argv[1] is not a test mode.
+************************************************************************/
+int simulations::run(int argc, char *argv[])
+{
+	std::string mode = (argc > 1) ? argv[1] : "";
+
+	//Benchmark several mounts on software pins, no hardware needed: --bench-mounts N [seconds]
+	if (mode == "--bench-mounts")
+	{
+		if (argc < 3 || argc > 4)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int maxMounts = atoi(argv[2]);
+		double seconds = (argc > 3) ? atof(argv[3]) : 5;
+
+		//Six software pins per mount
+		if (maxMounts > SOFT_GPIO_PINS / 6)
+		{
+			maxMounts = SOFT_GPIO_PINS / 6;
+		}
+		mountBenchmark(maxMounts, seconds);
+		return 0;
+	}
+
+	//Compare relative pulse delays with absolute deadlines on software pins: --bench-timing [seconds]
+	if (mode == "--bench-timing")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		timingBenchmark((argc > 2) ? atof(argv[2]) : 2);
+		return 0;
+	}
+
+	//Track through a whole night on a virtual clock: --simulate-night [hours] [tick seconds]
+	if (mode == "--simulate-night")
+	{
+		if (argc > 4)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		double hours = (argc > 2) ? atof(argv[2]) : SIM_DEFAULT_HOURS;
+		double tickSeconds = (argc > 3) ? atof(argv[3]) : SIM_DEFAULT_TICK_SECONDS;
+		nightSimulation::benchmark(hours, (tickSeconds > 0) ? tickSeconds : SIM_DEFAULT_TICK_SECONDS);
+		return 0;
+	}
+
+	//Rise, transit and set times of random targets over one night: --plan-night [targets]
+	if (mode == "--plan-night")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int count = (argc > 2) ? atoi(argv[2]) : PLAN_DEFAULT_TARGETS;
+		planBenchmark((count > 0) ? count : PLAN_DEFAULT_TARGETS);
+		return 0;
+	}
+
+	//Solve synthetic star fields from a synthetic catalog: --solve-sim [fields]
+	if (mode == "--solve-sim")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int fields = (argc > 2) ? atoi(argv[2]) : SOLVE_SIM_DEFAULT_FIELDS;
+		solveSimulation((fields > 0) ? fields : SOLVE_SIM_DEFAULT_FIELDS);
+		return 0;
+	}
+
+	//Record and play back a simulated gearbox error, no hardware needed: --pec-sim [periods]
+	if (mode == "--pec-sim")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int periods = (argc > 2) ? atoi(argv[2]) : 3;
+		pecSimulation(DEFAULT_PEC_PERIOD_STEPS, (periods > 0) ? periods : 1);
+		nightSimulation::pecBenchmark((periods > 0) ? periods : 1);
+		return 0;
+	}
+
+	//Guide a simulated mount on synthetic frames streamed through a pipe: --guide-sim [frames]
+	if (mode == "--guide-sim")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int frames = (argc > 2) ? atoi(argv[2]) : 0;
+		nightSimulation::guideBenchmark((frames > 0) ? frames : GUIDE_SIM_DEFAULT_FRAMES);
+		return 0;
+	}
+
+	//Compare the polynomial trig with libm: --check-trig [stride], 1 tries every float
+	if (mode == "--check-trig")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		int stride = (argc > 2) ? atoi(argv[2]) : 0;
+		trigCheck::run((stride > 0) ? stride : TRIG_CHECK_DEFAULT_STRIDE);
+		return 0;
+	}
+
+	//Plan and run a mosaic on software pins, against a goto per tile: --survey-sim [dwell seconds]
+	if (mode == "--survey-sim")
+	{
+		if (argc > 3)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		double dwellSeconds = (argc > 2) ? atof(argv[2]) : 0;
+		surveySimulation((dwellSeconds > 0) ? dwellSeconds : SURVEY_SIM_DEFAULT_DWELL_SECONDS);
+		return 0;
+	}
+
+	return NOT_A_TEST_MODE;
+}
+
+/**********************************************************************
+* Function:			printUsage
+* Purpose: 			Prints every test mode and its arguments
+* Precondition:		Pass in argv[0]
+* Postcondition:	One line per mode under a heading
+************************************************************************/
+void simulations::printUsage(const char *program)
+{
+	cout << "Test modes, no hardware needed:" << endl;
+	cout << "       " << program << " --bench-mounts N [seconds]" << endl;
+	cout << "       " << program << " --bench-timing [seconds]" << endl;
+	cout << "       " << program << " --simulate-night [hours] [tick seconds]" << endl;
+	cout << "       " << program << " --plan-night [targets]" << endl;
+	cout << "       " << program << " --solve-sim [fields]" << endl;
+	cout << "       " << program << " --pec-sim [periods]" << endl;
+	cout << "       " << program << " --guide-sim [frames]" << endl;
+	cout << "       " << program << " --check-trig [stride]" << endl;
+	cout << "       " << program << " --survey-sim [dwell seconds]" << endl;
+}
+
+/**********************************************************************
+* Function:			mountBenchmark
+* Purpose: 			Measures how step throughput scales with the number of mounts
+* Precondition:		Pass in the largest mount count and how long to run each count in seconds
+* Postcondition:	Prints total and per mount steps per second for 1, 2, 4 ... maxMounts mounts. Software pins
+*					with no delays are used, so this is the cost of the stepping loop itself.
+************************************************************************/
+void simulations::mountBenchmark(int maxMounts, double seconds)
+{
+	twoAxisDeg latLong;
+	latLong.x = 42.224869;
+	latLong.y = -121.781669;
+
+	//Far from the calibration star so every mount keeps slewing for the whole run
+	twoAxisDeg target;
+	target.x = sidereal::hmsToDeg(13, 23, 14.6);
+	target.y = sidereal::dmsToDeg(20, 0, 0);
+	std::vector<twoAxisDeg> targets(1, target);
+
+	cout << "Mounts\tSteps/s\t\tSteps/s per mount" << endl;
+
+	//1, 2, 4 ... and finally maxMounts itself
+	for (int count = 1; count <= maxMounts; count = (count < maxMounts && count * 2 > maxMounts) ? maxMounts : count * 2)
+	{
+		softGpioDriver pins;
+		mountDaemon daemon(&pins);
+
+		//Six pins per mount
+		for (int i = 0; i < count; i++)
+		{
+			mountConfig config = defaultMountConfig();
+			config.name = "bench";
+			config.azPins.ena = i * 6;
+			config.azPins.dir = i * 6 + 1;
+			config.azPins.pul = i * 6 + 2;
+			config.altPins.ena = i * 6 + 3;
+			config.altPins.dir = i * 6 + 4;
+			config.altPins.pul = i * 6 + 5;
+			config.stateFilePath = nullptr;
+			config.altPecPath = nullptr;
+			config.azPecPath = nullptr;
+			daemon.addMount(config);
+		}
+		daemon.calibrateAll(latLong);
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		daemon.start(targets, seconds);
+		daemon.join();
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		uint64_t steps = 0;
+		for (int i = 0; i < count; i++)
+		{
+			steps += pins.getPulses(i * 6 + 2) + pins.getPulses(i * 6 + 5);
+		}
+
+		cout << count << "\t" << (uint64_t)(steps / elapsed) << "\t" << (uint64_t)(steps / elapsed / count) << endl;
+	}
+}
+
+/**********************************************************************
+* Function:			timingBenchmark
+* Purpose: 			Shows the drift of relative delays against absolute deadlines
+* Precondition:		Pass in how long to run each in seconds
+* Postcondition:	Prints the step rate reached against the planned rate, CPU use, and missed deadlines for
+*					pulses timed with delayMicros() and with a stepScheduler, both on software pins that sleep
+************************************************************************/
+void simulations::timingBenchmark(double seconds)
+{
+	softGpioDriver pins;
+	pins.setRealDelays(true);
+	mountConfig config = defaultMountConfig();
+
+	cout << "Spin before each deadline: " << stepScheduler::getSpinNanos() / 1000.0 << "us" << endl;
+	cout << "Timing\t\tSteps/s\tPlanned\tCPU %\tMissed" << endl;
+
+	for (int absolute = 0; absolute < 2; absolute++)
+	{
+		stepScheduler scheduler(&pins);
+		axisDriver<azKinematics> driver(&pins, config.azPins, &scheduler);
+		uint64_t steps = 0;
+
+		timespec cpuBegin, cpuEnd;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuBegin);
+		int64_t begin = stepScheduler::now();
+		int64_t end = begin + (int64_t)(seconds * 1e9);
+		scheduler.resync();
+
+		while (stepScheduler::now() < end)
+		{
+			if (absolute)
+			{
+				driver.step(1);
+			}
+			else
+			{
+				pins.write(config.azPins.pul, PI_HIGH);
+				pins.delayMicros(azKinematics::pulseDelayMicros);
+				pins.write(config.azPins.pul, PI_LOW);
+				pins.delayMicros(azKinematics::pulseDelayMicros);
+			}
+			steps++;
+		}
+
+		double elapsed = (stepScheduler::now() - begin) / 1e9;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+		double cpu = (cpuEnd.tv_sec - cpuBegin.tv_sec) + (cpuEnd.tv_nsec - cpuBegin.tv_nsec) / 1e9;
+
+		cout << (absolute ? "Deadlines" : "Relative") << "\t" << (uint64_t)(steps / elapsed) << "\t" << azKinematics::maxStepRate
+			<< "\t" << (int)(100.0 * cpu / elapsed) << "\t" << scheduler.getMissed() << endl;
+	}
+}
+
+/**********************************************************************
+* Function:			printUtc
+* Purpose: 			Prints the time of day of a julian date
+* Precondition:		Pass in a label and a julian date, or NO_EVENT
+* Postcondition:	Prints one line, HH:MM:SS UTC or "none"
+************************************************************************/
+static void printUtc(const char *label, double julianDate)
+{
+	cout << label;
+	if (julianDate == NO_EVENT)
+	{
+		cout << "none" << endl;
+		return;
+	}
+
+	long seconds = lround(fmod(julianDate - UNIX_EPOCH_JD, 1.0) * SECONDS_PER_DAY) % (long)SECONDS_PER_DAY;
+	cout << std::setfill('0') << std::setw(2) << seconds / 3600 << ":" << std::setw(2) << (seconds / 60) % 60 << ":"
+		<< std::setw(2) << seconds % 60 << std::setfill(' ') << " UTC" << endl;
+}
+
+/**********************************************************************
+* Function:			planBenchmark
+* Purpose: 			Solves a random target list over one night from the test site
+* Precondition:		Pass in how many targets to generate
+* Postcondition:	Prints the night's events, the time taken on one thread and on the pool, the time the same
+*					curves take through equatorialToLocal one sample at a time, and the largest difference
+*					from equatorialToLocal in the curves and at the refined rise, set and transit times
+************************************************************************/
+void simulations::planBenchmark(int targetCount)
+{
+	twoAxisDeg latLong;
+	latLong.x = sidereal::dmsToDeg(42, 13, 29.53);
+	latLong.y = -sidereal::dmsToDeg(121, 46, 54.01);
+
+	double startJd = PLAN_BENCH_START_UNIX / SECONDS_PER_DAY + UNIX_EPOCH_JD;
+	double endJd = startJd + PLAN_BENCH_HOURS / 24.0;
+	double horizonDeg = 0;
+
+	//Uniform over the sky
+	std::mt19937 random(37);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::vector<twoAxisDeg> targets(targetCount);
+	for (int i = 0; i < targetCount; i++)
+	{
+		targets[i].x = 360.0 * unit(random);
+		targets[i].y = asin(2.0 * unit(random) - 1.0) * RAD_TO_DEG;
+	}
+
+	visibilityPlanner serial(latLong, startJd, endJd, horizonDeg, nullptr);
+	visibilityPlanner parallel(latLong, startJd, endJd, horizonDeg);
+
+	nightEvents night = parallel.getNightEvents();
+	printUtc("Sunset:              ", night.sunsetJd);
+	printUtc("Civil dusk:          ", night.civilDuskJd);
+	printUtc("Nautical dusk:       ", night.nauticalDuskJd);
+	printUtc("Astronomical dusk:   ", night.astronomicalDuskJd);
+	printUtc("Astronomical dawn:   ", night.astronomicalDawnJd);
+	printUtc("Nautical dawn:       ", night.nauticalDawnJd);
+	printUtc("Civil dawn:          ", night.civilDawnJd);
+	printUtc("Sunrise:             ", night.sunriseJd);
+
+	std::vector<float> curves;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::vector<targetEvents> serialEvents = serial.solve(targets, &curves);
+	double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	begin = std::chrono::steady_clock::now();
+	std::vector<targetEvents> events = parallel.solve(targets, &curves);
+	double parallelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	//The old way, every sample of every target through the scalar conversion
+	const std::vector<double> &samples = parallel.getSampleJd();
+	double curveError = 0;
+	begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < targetCount; i++)
+	{
+		for (int j = 0; j < (int)samples.size(); j++)
+		{
+			double error = fabs(parallel.altitudeDeg(targets[i], samples[j]) - curves[i * samples.size() + j]);
+			if (error > curveError)
+			{
+				curveError = error;
+			}
+		}
+	}
+	double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	//Refined events should sit on the horizon and the meridian
+	double eventError = 0;
+	int up = 0;
+	int neverUp = 0;
+	int mismatched = 0;
+	for (int i = 0; i < targetCount; i++)
+	{
+		const targetEvents &e = events[i];
+		double crossings[2] = { e.riseJd, e.setJd };
+		for (int k = 0; k < 2; k++)
+		{
+			if (crossings[k] != NO_EVENT && fabs(parallel.altitudeDeg(targets[i], crossings[k]) - horizonDeg) > eventError)
+			{
+				eventError = fabs(parallel.altitudeDeg(targets[i], crossings[k]) - horizonDeg);
+			}
+		}
+		if (e.transitJd != NO_EVENT)
+		{
+			double hourAngle = sidereal::getLMST(sidereal::getGMSTinRads(e.transitJd), latLong.y) - targets[i].x;
+			hourAngle = fabs(remainder(hourAngle, 360.0)) * cos(targets[i].y * DEG_TO_RAD);
+			if (hourAngle > eventError)
+			{
+				eventError = hourAngle;
+			}
+		}
+
+		if (e.riseJd != serialEvents[i].riseJd || e.setJd != serialEvents[i].setJd || e.transitJd != serialEvents[i].transitJd)
+		{
+			mismatched++;
+		}
+		if (e.darkHours > 0)
+		{
+			up++;
+		}
+		if (e.neverUp)
+		{
+			neverUp++;
+		}
+	}
+
+	cout << targetCount << " targets, " << samples.size() << " samples each over " << PLAN_BENCH_HOURS << " hours" << endl;
+	cout << "One thread:  " << serialSeconds * 1000.0 << " ms" << endl;
+	cout << workPool::instance()->getThreadCount() << " threads:   " << parallelSeconds * 1000.0 << " ms" << endl;
+	cout << "Scalar curves only: " << scalarSeconds * 1000.0 << " ms" << endl;
+	cout << "Largest curve difference from equatorialToLocal: " << curveError * 3600.0 << " arcsec" << endl;
+	cout << "Largest event error: " << eventError * 3600.0 << " arcsec" << endl;
+	cout << "Up while dark: " << up << " Never up: " << neverUp << " Threads disagreeing: " << mismatched << endl;
+}
+
+/**********************************************************************
+* Function:			synthesizeCatalog
+* Purpose: 			Makes up a sky for testing without a real catalog
+* Precondition:		Pass in the number of stars, the faintest magnitude, and a seed
+* Postcondition:	Returns stars spread evenly over the sphere. Like the real sky, each magnitude has about
+*					three times as many stars as the one before.
+************************************************************************/
+std::vector<catalogStar> simulations::synthesizeCatalog(int count, double faintestMag, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::vector<catalogStar> catalog(count);
+	double brightest = pow(10.0, 0.47 * -1.5);
+	double faintest = pow(10.0, 0.47 * faintestMag);
+
+	for (int i = 0; i < count; i++)
+	{
+		catalog[i].raDeg = 360.0 * unit(random);
+		catalog[i].decDeg = asin(2.0 * unit(random) - 1.0) * RAD_TO_DEG;
+		catalog[i].mag = (float)(log10(brightest + (faintest - brightest) * unit(random)) / 0.47);
+	}
+
+	return catalog;
+}
+
+/**********************************************************************
+* Function:			synthesizeField
+* Purpose: 			Makes the centroids a finder camera would see
+* Precondition:		Pass in an open index, where the frame is centered, its rotation, whether the optics
+*					mirror it, and the random generator
+* Postcondition:	Returns the catalog stars down to SOLVE_SIM_DETECT_MAG with centroid noise, some stars
+*					missing, and a few false stars added
+************************************************************************/
+centroidList simulations::synthesizeField(starIndex &index, twoAxisDeg centerRaDec, double rotationDeg, bool mirrored, std::mt19937 &random)
+{
+	std::normal_distribution<double> noise(0.0, SOLVE_SIM_NOISE_PIXELS);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	centroidList frame;
+	frame.width = SOLVE_SIM_WIDTH;
+	frame.height = SOLVE_SIM_HEIGHT;
+
+	double center[3];
+	starIndex::toVector(centerRaDec, center);
+	double scale = SOLVE_SIM_ARCSEC_PER_PIXEL / ARCSEC_PER_RAD;
+	double cosRotation = cos(rotationDeg * DEG_TO_RAD);
+	double sinRotation = sin(rotationDeg * DEG_TO_RAD);
+	double radius = hypot(frame.width, frame.height) / 2.0 * scale;
+	double dec = centerRaDec.y * DEG_TO_RAD;
+
+	uint32_t first;
+	uint32_t last;
+	index.findStars(sin((dec - radius < -M_PI / 2) ? -M_PI / 2 : dec - radius), sin((dec + radius > M_PI / 2) ? M_PI / 2 : dec + radius), first, last);
+	for (uint32_t s = first; s < last; s++)
+	{
+		const indexStar &star = index.getStar(s);
+		double vector[3] = { star.x, star.y, star.z };
+		double xi;
+		double eta;
+		if (star.mag > SOLVE_SIM_DETECT_MAG || !starIndex::toTangent(vector, center, xi, eta) || unit(random) < SOLVE_SIM_MISSING_FRACTION)
+		{
+			continue;
+		}
+
+		//Undo the rotation and scale, then the mirror
+		double x = (xi * cosRotation + eta * sinRotation) / scale;
+		double y = (eta * cosRotation - xi * sinRotation) / scale;
+		centroid found;
+		found.x = frame.width / 2.0 + (mirrored ? -x : x) + noise(random);
+		found.y = frame.height / 2.0 + y + noise(random);
+		found.flux = 1000.0 * pow(10.0, -0.4 * (star.mag - SOLVE_SIM_DETECT_MAG)) * (1.0 + 0.05 * noise(random) / SOLVE_SIM_NOISE_PIXELS);
+
+		if (found.x >= 0 && found.y >= 0 && found.x < frame.width && found.y < frame.height)
+		{
+			frame.stars.push_back(found);
+		}
+	}
+
+	for (int i = 0; i < SOLVE_SIM_FALSE_STARS; i++)
+	{
+		centroid fake;
+		fake.x = unit(random) * frame.width;
+		fake.y = unit(random) * frame.height;
+		fake.flux = 1000.0 * (1.0 + 3.0 * unit(random));
+		frame.stars.push_back(fake);
+	}
+
+	return frame;
+}
+
+/**********************************************************************
+* Function:			solveSimulation
+* Purpose: 			Builds an index from a synthetic catalog and solves random fields from it
+* Precondition:		Pass in how many fields to solve
+* Postcondition:	Prints the index size and build time, how many fields solved, the solve times and the
+*					pointing error. The catalog, index, and last field are left in the working directory so
+*					--solve can be tried on them.
+************************************************************************/
+void simulations::solveSimulation(int fields)
+{
+	std::vector<catalogStar> catalog = synthesizeCatalog(SOLVE_SIM_CATALOG_STARS, SOLVE_SIM_FAINTEST_MAG, 38);
+	starIndex::saveCatalog(catalog, SOLVE_SIM_CATALOG_PATH);
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	starIndex index;
+	if (!starIndex::build(catalog, SOLVE_SIM_INDEX_PATH) || !index.open(SOLVE_SIM_INDEX_PATH))
+	{
+		cout << "Could not write " << SOLVE_SIM_INDEX_PATH << endl;
+		return;
+	}
+	double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	cout << index.getStarCount() << " stars, " << index.getQuadCount() << " quads, " << index.getFileBytes() / 1048576.0
+		<< " MB index built in " << buildSeconds << " s" << endl;
+
+	plateSolver solver(index);
+	std::mt19937 random(380);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	int solved = 0;
+	int wrong = 0;
+	double totalSeconds = 0;
+	double maxSeconds = 0;
+	double totalError = 0;
+	double maxError = 0;
+	int totalStars = 0;
+	centroidList frame;
+	twoAxisDeg truth;
+
+	for (int i = 0; i < fields; i++)
+	{
+		truth.x = 360.0 * unit(random);
+		truth.y = asin(2.0 * unit(random) - 1.0) * RAD_TO_DEG;
+		frame = synthesizeField(index, truth, 360.0 * unit(random), unit(random) < 0.5, random);
+		totalStars += (int)frame.stars.size();
+
+		plateSolution solution = solver.solve(frame);
+		totalSeconds += solution.seconds;
+		if (solution.seconds > maxSeconds)
+		{
+			maxSeconds = solution.seconds;
+		}
+		if (!solution.solved)
+		{
+			continue;
+		}
+
+		double expected[3];
+		double found[3];
+		starIndex::toVector(truth, expected);
+		starIndex::toVector(solution.raDec, found);
+		double dot = expected[0] * found[0] + expected[1] * found[1] + expected[2] * found[2];
+		double error = acos((dot > 1) ? 1 : dot) * ARCSEC_PER_RAD;
+
+		//Anything more than a pixel off is a false match
+		if (error > SOLVE_SIM_ARCSEC_PER_PIXEL)
+		{
+			wrong++;
+			continue;
+		}
+
+		solved++;
+		totalError += error;
+		if (error > maxError)
+		{
+			maxError = error;
+		}
+	}
+
+	cout << "Solved " << solved << " of " << fields << " fields, " << wrong << " wrong, " << (double)totalStars / fields
+		<< " stars per field" << endl;
+	cout << "Solve time: average " << totalSeconds / fields * 1000.0 << " ms, worst " << maxSeconds * 1000.0 << " ms" << endl;
+	if (solved > 0)
+	{
+		cout << "Pointing error: average " << totalError / solved << " arcsec, worst " << maxError << " arcsec" << endl;
+	}
+
+	plateSolver::saveCentroids(frame, SOLVE_SIM_FIELD_PATH);
+	cout << "Last field is in " << SOLVE_SIM_FIELD_PATH << ", centered at RA " << truth.x << " Dec " << truth.y << endl;
+}
+
+/**********************************************************************
+* Function:			pecSimulation
+* Purpose: 			Checks record and playback against a simulated gearbox
+* Precondition:		Pass in the error period in microsteps and how many periods to record
+* Postcondition:	Prints the RMS and peak tracking error with PEC off and with playback, and the cost of one
+*					playback lookup. Recording sees one microstep of measurement noise.
+************************************************************************/
+void simulations::pecSimulation(int64_t periodSteps, int cycles)
+{
+	periodicErrorModel gearbox(periodSteps, 20.0);
+	pecTable pec(periodSteps);
+
+	//Record at every microstep the axis passes through
+	pec.startRecording();
+	for (int64_t steps = 0; steps < periodSteps * cycles; steps++)
+	{
+		pec.record(steps, -gearbox.measure(steps, 1.0));
+	}
+	pec.finishRecording();
+
+	//Track one more period, the axis is commanded to the target plus the correction
+	double offSquares = 0, onSquares = 0, offPeak = 0, onPeak = 0;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int64_t target = 0; target < periodSteps; target++)
+	{
+		int64_t commanded = target + llround(pec.correction(target));
+		double off = gearbox.errorSteps(target);
+		double on = (double)(commanded - target) + gearbox.errorSteps(commanded);
+
+		offSquares += off * off;
+		onSquares += on * on;
+		offPeak = (fabs(off) > offPeak) ? fabs(off) : offPeak;
+		onPeak = (fabs(on) > onPeak) ? fabs(on) : onPeak;
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	cout << "PEC\tRMS steps\tPeak steps" << endl;
+	cout << "Off\t" << sqrt(offSquares / periodSteps) << "\t\t" << offPeak << endl;
+	cout << "On\t" << sqrt(onSquares / periodSteps) << "\t\t" << onPeak << endl;
+	cout << "Playback and model: " << elapsed / periodSteps * 1e9 << " ns per step" << endl;
+}
+
+/**********************************************************************
+* Function:			advanceClock
+* Purpose: 			Moves the virtual clock on by the time the pulses since the last call took
+* Precondition:		Pass in the clock, the software pins and config of the mount, and the pulse counts of the
+*					last call
+* Postcondition:	The clock moved on by every new pulse at its axis' fine rate, or by SURVEY_SIM_IDLE_SECONDS
+*					if none were made. The simulated mount has no mode pins, so every pulse is a fine one.
+************************************************************************/
+static void advanceClock(virtualClock &clock, softGpioDriver &pins, mountConfig &config, uint64_t &altPulses, uint64_t &azPulses)
+{
+	uint64_t alt = pins.getPulses(config.altPins.pul);
+	uint64_t az = pins.getPulses(config.azPins.pul);
+	double seconds = (double)(alt - altPulses) * altKinematics::secondsPerStep + (double)(az - azPulses) * azKinematics::secondsPerStep;
+	altPulses = alt;
+	azPulses = az;
+
+	clock.advance((seconds > 0) ? seconds : SURVEY_SIM_IDLE_SECONDS);
+}
+
+/**********************************************************************
+* Function:			surveySimulation
+* Purpose: 			Runs a survey with the real tracking code on software pins and a virtual clock
+* Precondition:		Pass in the dwell on each tile in seconds
+* Postcondition:	Plans a region high in the east from the test site and prints the plan, then runs it as one
+*					track and, from the same start, as a goto per tile in rows, and prints both simulated times
+************************************************************************/
+void simulations::surveySimulation(double dwellSeconds)
+{
+	twoAxisDeg latLong;
+	latLong.x = sidereal::dmsToDeg(42, 13, 29.53);
+	latLong.y = -sidereal::dmsToDeg(121, 46, 54.01);
+
+	virtualClock clock(SIM_START_UNIX);
+	sidereal::setClock(&clock);
+
+	//An hour east of the meridian and about 70 degrees up, where azimuth moves cost the most
+	surveyRegion region;
+	region.centerRaDec.x = fmod(sidereal::getLMST(sidereal::getGMSTinRads(), latLong.y) + 15.0, 360.0);
+	region.centerRaDec.y = SURVEY_SIM_DEC_DEG;
+	region.widthDeg = SURVEY_SIM_WIDTH_DEG;
+	region.heightDeg = SURVEY_SIM_HEIGHT_DEG;
+
+	surveyField field;
+	field.widthDeg = SURVEY_SIM_FOV_WIDTH_DEG;
+	field.heightDeg = SURVEY_SIM_FOV_HEIGHT_DEG;
+	field.overlap = SURVEY_DEFAULT_OVERLAP;
+	field.dwellSeconds = dwellSeconds;
+
+	//The modeled mount, software pins with no delays and nothing saved to disk, starting on the region's center
+	softGpioDriver pins;
+	mountConfig config = defaultMountConfig();
+	config.name = "simulation";
+	config.stateFilePath = nullptr;
+	config.altPecPath = nullptr;
+	config.azPecPath = nullptr;
+	coordinate mount(config, &pins);
+	mount.calibrate(latLong, region.centerRaDec);
+
+	surveyPlanner survey(mount);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	surveyPlan plan = survey.plan(region, field, sidereal::getJulianDate());
+	double planSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	surveyPlanner::printPlan(plan);
+	cout << "Planned in " << planSeconds * 1000.0 << "ms" << endl;
+	if (plan.tiles.empty())
+	{
+		sidereal::setClock(nullptr);
+		return;
+	}
+
+	//One track, moved on at the end of each dwell
+	uint64_t altPulses = pins.getPulses(config.altPins.pul);
+	uint64_t azPulses = pins.getPulses(config.azPins.pul);
+	survey.begin(plan);
+	while (survey.isActive())
+	{
+		survey.update(1);
+		advanceClock(clock, pins, config, altPulses, azPulses);
+	}
+	double surveySeconds = survey.getElapsedSeconds();
+
+	//From the same start, what gotoCoordsDeg does for each tile: a new track, slewed to, dwelt on and stopped
+	clock.set(SIM_START_UNIX);
+	mount.calibrate(latLong, region.centerRaDec);
+	surveyPlan raster = survey.planRaster(region, field, sidereal::getJulianDate());
+	double rasterStartJd = sidereal::getJulianDate();
+	for (int i = 0; i < (int)raster.tiles.size(); i++)
+	{
+		mount.beginTrack(raster.tiles[i].raDec, -1);
+		int pulses;
+		do
+		{
+			pulses = mount.updateTrack(1);
+			advanceClock(clock, pins, config, altPulses, azPulses);
+		} while (pulses > 0);
+
+		double dwellEndJd = sidereal::getJulianDate() + dwellSeconds / SECONDS_PER_DAY;
+		while (sidereal::getJulianDate() < dwellEndJd)
+		{
+			mount.updateTrack(1);
+			advanceClock(clock, pins, config, altPulses, azPulses);
+		}
+		mount.endTrack();
+	}
+	double rasterSeconds = (sidereal::getJulianDate() - rasterStartJd) * SECONDS_PER_DAY;
+	double dwellTotal = plan.tiles.size() * dwellSeconds;
+
+	cout << "Serpentine, one track: " << surveySeconds << "s simulated, " << plan.totalSeconds << "s planned, "
+		<< surveySeconds - dwellTotal << "s moving" << endl;
+	cout << "Rows, goto per tile: " << rasterSeconds << "s simulated, " << raster.totalSeconds << "s planned, "
+		<< rasterSeconds - raster.tiles.size() * dwellSeconds << "s moving" << endl;
+
+	sidereal::setClock(nullptr);
+}
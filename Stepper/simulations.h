@@ -0,0 +1,90 @@
+/*************************************************************
+* Filename:			simulations.h
+* Purpose:			Benchmarks and simulations run from the command line, none of them need the mount
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//int64_t
+#include <vector>			//std::vector
+#include <random>			//std::mt19937
+#include "nightSimulation.h"	//nightSimulation, virtual clock, software pins
+#include "starIndex.h"		//starIndex, catalogStar
+#include "plateSolver.h"	//centroidList
+
+#define NOT_A_TEST_MODE -1					//run() was not given one of its modes
+
+//Rise / transit / set times for --plan-night
+#define PLAN_DEFAULT_TARGETS 5000
+#define PLAN_BENCH_START_UNIX 1792454400.0	//10/20/2026 00:00 UTC, late afternoon at the test site
+#define PLAN_BENCH_HOURS 16.0
+
+//Synthetic finder camera and sky used by --solve-sim
+#define SOLVE_SIM_CATALOG_STARS 20000
+#define SOLVE_SIM_FAINTEST_MAG 7.0
+#define SOLVE_SIM_DETECT_MAG 6.5			//Faintest star the camera sees
+#define SOLVE_SIM_WIDTH 1280
+#define SOLVE_SIM_HEIGHT 960
+#define SOLVE_SIM_ARCSEC_PER_PIXEL 20.0		//About 7 x 5 degrees
+#define SOLVE_SIM_NOISE_PIXELS 0.3			//Centroid error
+#define SOLVE_SIM_MISSING_FRACTION 0.1		//Stars lost to clouds, trees and the edge of the frame
+#define SOLVE_SIM_FALSE_STARS 3				//Hot pixels and satellites
+#define SOLVE_SIM_DEFAULT_FIELDS 200
+#define SOLVE_SIM_CATALOG_PATH "simCatalog.txt"
+#define SOLVE_SIM_INDEX_PATH "simStars.idx"
+#define SOLVE_SIM_FIELD_PATH "simField.txt"
+
+//Region, field and timing of --survey-sim
+#define SURVEY_SIM_WIDTH_DEG 8.0
+#define SURVEY_SIM_HEIGHT_DEG 5.0
+#define SURVEY_SIM_DEC_DEG 30.0
+#define SURVEY_SIM_FOV_WIDTH_DEG 1.2
+#define SURVEY_SIM_FOV_HEIGHT_DEG 0.8
+#define SURVEY_SIM_DEFAULT_DWELL_SECONDS 10.0
+#define SURVEY_SIM_IDLE_SECONDS 0.02		//Virtual time between updates once on a tile, the controller's track period
+
+/************************************************************************
+* Class: 		simulations
+* Purpose:		Every benchmark and simulation mode of the program, kept out of the classes they exercise.
+*				Each runs the production code on software pins, a virtual clock, or synthetic data.
+* Data members:	none
+*
+* Methods:		run
+*				printUsage
+*				mountBenchmark
+*				timingBenchmark
+*				planBenchmark
+*				solveSimulation
+*				pecSimulation
+*				surveySimulation
+*				synthesizeCatalog
+*				synthesizeField
+*************************************************************************/
+class simulations
+{
+	public:
+		//Runs the mode named by argv[1], or returns NOT_A_TEST_MODE if it is not one of these
+		static int run(int argc, char *argv[]);
+		static void printUsage(const char *program);
+
+		//Measures total step throughput with 1, 2, 4 ... maxMounts mounts on software pins
+		static void mountBenchmark(int maxMounts, double seconds);
+
+		//Compares relative delays with absolute deadlines on software pins with real timing
+		static void timingBenchmark(double seconds);
+
+		//Solves a random target list over one night with visibilityPlanner
+		static void planBenchmark(int targetCount);
+
+		//Builds an index from a synthetic catalog and plate solves synthetic fields from it
+		static void solveSimulation(int fields);
+
+		//Records a simulated gearbox and prints the tracking error with and without playback
+		static void pecSimulation(int64_t periodSteps, int cycles);
+
+		//Plans and runs a survey on software pins and a virtual clock, against a goto per tile
+		static void surveySimulation(double dwellSeconds);
+
+	private:
+		static std::vector<catalogStar> synthesizeCatalog(int count, double faintestMag, unsigned seed);
+		static centroidList synthesizeField(starIndex &index, twoAxisDeg centerRaDec, double rotationDeg, bool mirrored, std::mt19937 &random);
+};
@@ -0,0 +1,167 @@
+/*************************************************************
+* Filename:			slewPlanner.cpp
+* Purpose:			Choose the shortest Alt / Az path to a target while respecting cable-wrap and altitude limits
+**************************************************************/
+#include "slewPlanner.h"
+
+/**********************************************************************
+* Function:			slewPlanner (constructor)
+* Purpose: 			Creates a planner with the default limits and the cables neutral at North (0 degrees)
+* Precondition:		None
+* Postcondition:	Planner is ready to use
+************************************************************************/
+slewPlanner::slewPlanner()
+{
+	limits.cableWrapDeg = DEFAULT_CABLE_WRAP_DEG;
+	limits.minAltDeg = DEFAULT_MIN_ALT_DEG;
+	limits.maxAltDeg = DEFAULT_MAX_ALT_DEG;
+	neutralAzDeg = 0;
+}
+
+/**********************************************************************
+* Function:			slewPlanner (constructor override)
+* Purpose: 			Creates a planner with custom limits and the cables neutral at North (0 degrees)
+* Precondition:		Pass in an initialized slewLimits struct
+* Postcondition:	Planner is ready to use
+************************************************************************/
+slewPlanner::slewPlanner(slewLimits limits)
+{
+	this->limits = limits;
+	neutralAzDeg = 0;
+}
+
+/**********************************************************************
+* Function:			setLimits
+* Purpose: 			Changes the mechanical limits used for planning
+* Precondition:		cableWrapDeg should be at least 180 so every azimuth can be reached
+* Postcondition:	Following plans respect the new limits
+************************************************************************/
+void slewPlanner::setLimits(slewLimits limits)
+{
+	this->limits = limits;
+}
+
+/**********************************************************************
+* Function:			getLimits
+* Purpose: 			Returns the mechanical limits used for planning
+* Precondition:		None
+* Postcondition:	Returns a copy of the slewLimits struct
+************************************************************************/
+slewLimits slewPlanner::getLimits()
+{
+	return limits;
+}
+
+/**********************************************************************
+* Function:			setCableNeutral
+* Purpose: 			Sets the unwrapped azimuth where the cables hang freely
+* Precondition:		Pass in the mount azimuth in degrees, normally the position at calibration
+* Postcondition:	The cable-wrap window is centered on azDeg
+************************************************************************/
+void slewPlanner::setCableNeutral(double azDeg)
+{
+	neutralAzDeg = azDeg;
+}
+
+/**********************************************************************
+* Function:			getCableNeutral
+* Purpose: 			Returns the unwrapped azimuth where the cables hang freely
+* Precondition:		None
+* Postcondition:	Returns degrees
+************************************************************************/
+double slewPlanner::getCableNeutral()
+{
+	return neutralAzDeg;
+}
+
+/**********************************************************************
+* Function:			plan
+* Purpose: 			Finds the fastest reachable mount position for a target
+* Precondition:		Current azimuth in unwrapped mount degrees, target Alt in degrees and Az in 0 - 360 degrees
+* Postcondition:	Returns a slewPlan, the azimuth is the closest wrap of the target to the current position
+*					that stays inside the cable-wrap window. The altitude move is the same whichever wrap is
+*					picked, so only the azimuth decides between them.
+************************************************************************/
+slewPlan slewPlanner::plan(double currentAzDeg, double targetAltDeg, double targetAzDeg)
+{
+	slewPlan result;
+
+	result.altDeg = clampAlt(targetAltDeg, result.altClamped);
+	result.azDeg = nearestAllowedAz(targetAzDeg, currentAzDeg, result.reachable);
+
+	return result;
+}
+
+/**********************************************************************
+* Function:			replan
+* Purpose: 			Updates the target of a slew that is already moving
+* Precondition:		Pass in the previous plan and the newest target Alt / Az
+* Postcondition:	Returns a slewPlan whose azimuth is the wrap closest to the previous plan. A target moving
+*					across North (359 -> 1 degrees) keeps going the same way instead of reversing a full turn.
+*					If that would pass the cable limit the plan unwinds the other way, and if neither way fits
+*					reachable is false.
+************************************************************************/
+slewPlan slewPlanner::replan(slewPlan previous, double targetAltDeg, double targetAzDeg)
+{
+	slewPlan result;
+
+	result.altDeg = clampAlt(targetAltDeg, result.altClamped);
+	result.azDeg = nearestAllowedAz(targetAzDeg, previous.azDeg, result.reachable);
+
+	return result;
+}
+
+/**********************************************************************
+* Function:			nearestAllowedAz
+* Purpose: 			Finds the wrap of targetAzDeg (targetAzDeg + 360 * k) that is closest to referenceAzDeg
+*					and inside the cable-wrap window
+* Precondition:		targetAzDeg in degrees, referenceAzDeg in unwrapped mount degrees
+* Postcondition:	Returns the chosen azimuth, found is false if no wrap fits and the limit was used instead
+************************************************************************/
+double slewPlanner::nearestAllowedAz(double targetAzDeg, double referenceAzDeg, bool &found)
+{
+	double minAz = neutralAzDeg - limits.cableWrapDeg;
+	double maxAz = neutralAzDeg + limits.cableWrapDeg;
+
+	//Wrap of the target closest to the reference
+	double best = targetAzDeg + 360.0 * floor((referenceAzDeg - targetAzDeg) / 360.0 + 0.5);
+
+	found = true;
+	if (best >= minAz && best <= maxAz)
+	{
+		return best;
+	}
+
+	//Closest wrap is past a limit, try one turn the other way
+	double other = (best > maxAz) ? best - 360.0 : best + 360.0;
+	if (other >= minAz && other <= maxAz)
+	{
+		return other;
+	}
+
+	//Window is smaller than a full turn, stop at the nearest limit
+	found = false;
+	return (best > maxAz) ? maxAz : minAz;
+}
+
+/**********************************************************************
+* Function:			clampAlt
+* Purpose: 			Keeps a target altitude inside the altitude limits
+* Precondition:		targetAltDeg in degrees
+* Postcondition:	Returns the clamped altitude, clamped is true if it had to be changed
+************************************************************************/
+double slewPlanner::clampAlt(double targetAltDeg, bool &clamped)
+{
+	clamped = true;
+	if (targetAltDeg < limits.minAltDeg)
+	{
+		return limits.minAltDeg;
+	}
+	if (targetAltDeg > limits.maxAltDeg)
+	{
+		return limits.maxAltDeg;
+	}
+
+	clamped = false;
+	return targetAltDeg;
+}
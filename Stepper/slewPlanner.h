@@ -0,0 +1,82 @@
+/*************************************************************
+* Filename:			slewPlanner.h
+* Purpose:			Choose the shortest Alt / Az path to a target while respecting cable-wrap and altitude limits
+**************************************************************/
+#pragma once
+
+#include <cmath>		//floor()
+
+//Default limits - cable may wind this far either side of where the mount was calibrated
+#define DEFAULT_CABLE_WRAP_DEG 270.0
+#define DEFAULT_MIN_ALT_DEG 0.0
+#define DEFAULT_MAX_ALT_DEG 90.0
+
+/************************************************************************
+* Struct: 		slewLimits
+* Purpose:		Holds the mechanical limits of the mount used when planning a slew
+* Data members:	cableWrapDeg	- How far the azimuth axis may turn either side of its neutral position
+*				minAltDeg		- Lowest altitude the tube is allowed to point
+*				maxAltDeg		- Highest altitude the tube is allowed to point
+*************************************************************************/
+typedef struct slewLimits
+{
+	double cableWrapDeg;
+	double minAltDeg;
+	double maxAltDeg;
+} slewLimits;
+
+/************************************************************************
+* Struct: 		slewPlan
+* Purpose:		Holds the mount-space target chosen by slewPlanner
+* Data members:	altDeg		- Target altitude, clamped into the altitude limits
+*				azDeg		- Target azimuth in unwrapped mount degrees (may be < 0 or >= 360)
+*				altClamped	- True if the real target is outside the altitude limits
+*				reachable	- False if no wrap of the target azimuth fits the cable-wrap window, azDeg is then
+*							  the nearest limit and the target must not be slewed to
+*************************************************************************/
+typedef struct slewPlan
+{
+	double altDeg;
+	double azDeg;
+	bool altClamped;
+	bool reachable;
+} slewPlan;
+
+/************************************************************************
+* Class: 		slewPlanner
+* Purpose:		Maps a 0 - 360 azimuth target onto the unwrapped mount azimuth that is reached the
+*				fastest without winding the cables past their limit
+* Data members:	limits			- Mechanical limits of the mount
+*				neutralAzDeg	- Unwrapped azimuth where the cables are not wound at all
+*
+* Methods:		setLimits
+*				getLimits
+*				setCableNeutral
+*				getCableNeutral
+*				plan
+*				replan
+*************************************************************************/
+class slewPlanner
+{
+	public:
+		slewPlanner();
+		slewPlanner(slewLimits limits);
+
+		void setLimits(slewLimits limits);
+		slewLimits getLimits();
+		void setCableNeutral(double azDeg);
+		double getCableNeutral();
+
+		//Plans a new slew from the current mount position
+		slewPlan plan(double currentAzDeg, double targetAltDeg, double targetAzDeg);
+
+		//Updates a slew already in progress, keeping the target continuous as it moves across north
+		slewPlan replan(slewPlan previous, double targetAltDeg, double targetAzDeg);
+
+	private:
+		double nearestAllowedAz(double targetAzDeg, double referenceAzDeg, bool &found);
+		double clampAlt(double targetAltDeg, bool &clamped);
+
+		slewLimits limits;
+		double neutralAzDeg;
+};
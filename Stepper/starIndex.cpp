@@ -0,0 +1,498 @@
+/*************************************************************
+* Filename:			starIndex.cpp
+* Purpose:			Star catalog and a memory-mapped index of star quads for blind plate solving
+**************************************************************/
+#include "starIndex.h"
+#include "sidereal.h"		//DEG_TO_RAD, RAD_TO_DEG
+
+#include <fstream>		//std::ifstream
+#include <sstream>		//std::istringstream
+#include <string>		//std::string, getline()
+#include <algorithm>	//std::sort(), std::lower_bound(), std::equal_range()
+#include <array>		//std::array
+#include <set>			//std::set
+#include <stdio.h>		//fopen(), fwrite()
+#include <math.h>		//sin(), cos(), atan2(), asin()
+#include <fcntl.h>		//open()
+#include <unistd.h>		//::close()
+#include <sys/mman.h>	//mmap(), munmap()
+#include <sys/stat.h>	//fstat()
+
+/**********************************************************************
+* Function:			starIndex (constructor)
+* Purpose: 			Creates an index with no file open
+* Precondition:		None
+* Postcondition:	open() must succeed before anything is looked up
+************************************************************************/
+starIndex::starIndex()
+{
+	mapping = nullptr;
+	mappedBytes = 0;
+	header = nullptr;
+	stars = nullptr;
+	quads = nullptr;
+}
+
+/**********************************************************************
+* Function:			~starIndex (destructor)
+* Purpose: 			Unmaps the index
+* Precondition:		None
+* Postcondition:	Memory of the index is released
+************************************************************************/
+starIndex::~starIndex()
+{
+	close();
+}
+
+/**********************************************************************
+* Function:			loadCatalog
+* Purpose: 			Reads a star catalog from a text file
+* Precondition:		One star per line: RA and Dec in degrees and the magnitude. Blank lines and lines starting
+*					with # are ignored.
+* Postcondition:	Returns the stars, empty if the file could not be opened
+************************************************************************/
+std::vector<catalogStar> starIndex::loadCatalog(const char *path)
+{
+	std::vector<catalogStar> catalog;
+	std::ifstream file(path);
+	std::string line;
+
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		catalogStar star;
+		if (fields >> star.raDeg >> star.decDeg >> star.mag)
+		{
+			catalog.push_back(star);
+		}
+	}
+
+	return catalog;
+}
+
+/**********************************************************************
+* Function:			saveCatalog
+* Purpose: 			Writes a catalog in the format loadCatalog() reads
+* Precondition:		Pass in the stars and the file path
+* Postcondition:	Returns true if the file was written
+************************************************************************/
+bool starIndex::saveCatalog(const std::vector<catalogStar> &catalog, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool written = fprintf(file, "#RA(deg) Dec(deg) magnitude\n") > 0;
+	for (size_t i = 0; i < catalog.size() && written; i++)
+	{
+		written = fprintf(file, "%.6f %.6f %.2f\n", catalog[i].raDeg, catalog[i].decDeg, catalog[i].mag) > 0;
+	}
+
+	return (fclose(file) == 0) && written;
+}
+
+/**********************************************************************
+* Function:			build
+* Purpose: 			Writes an index file for a catalog
+* Precondition:		Pass in the catalog and the file to write
+* Postcondition:	Returns true if the file was written. Each star is paired with its QUAD_NEIGHBOURS
+*					brightest neighbours inside QUAD_MAX_SCALE_DEG, and every way of adding three of them to it
+*					is a quad if its widest pair is inside the scale limits. Bright stars are the ones a finder
+*					camera sees, so its brightest few stars usually make at least one of these quads.
+************************************************************************/
+bool starIndex::build(const std::vector<catalogStar> &catalog, const char *path)
+{
+	//Unit vectors in order of z, so neighbours are found from a band of the array
+	std::vector<indexStar> sorted(catalog.size());
+	for (size_t i = 0; i < catalog.size(); i++)
+	{
+		double vector[3];
+		twoAxisDeg raDec;
+		raDec.x = catalog[i].raDeg;
+		raDec.y = catalog[i].decDeg;
+		toVector(raDec, vector);
+
+		sorted[i].x = vector[0];
+		sorted[i].y = vector[1];
+		sorted[i].z = vector[2];
+		sorted[i].mag = catalog[i].mag;
+		sorted[i].padding = 0;
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const indexStar &a, const indexStar &b) { return a.z < b.z; });
+
+	double maxScale = QUAD_MAX_SCALE_DEG * DEG_TO_RAD;
+	double minScale = QUAD_MIN_SCALE_DEG * DEG_TO_RAD;
+	double cosMax = cos(maxScale);
+	std::vector<indexQuad> quads;
+	std::set<std::array<uint32_t, 4>> seen;
+
+	for (uint32_t a = 0; a < (uint32_t)sorted.size(); a++)
+	{
+		const indexStar &center = sorted[a];
+		double centerVector[3] = { center.x, center.y, center.z };
+		double dec = asin(center.z);
+		double minZ = sin((dec - maxScale < -M_PI / 2) ? -M_PI / 2 : dec - maxScale);
+		double maxZ = sin((dec + maxScale > M_PI / 2) ? M_PI / 2 : dec + maxScale);
+
+		//Brightest neighbours within the largest quad
+		std::vector<uint32_t> neighbours;
+		auto low = std::lower_bound(sorted.begin(), sorted.end(), minZ, [](const indexStar &s, double z) { return s.z < z; });
+		for (auto it = low; it != sorted.end() && it->z <= maxZ; it++)
+		{
+			uint32_t b = (uint32_t)(it - sorted.begin());
+			if (b != a && it->x * center.x + it->y * center.y + it->z * center.z >= cosMax)
+			{
+				neighbours.push_back(b);
+			}
+		}
+
+		size_t keep = (neighbours.size() < QUAD_NEIGHBOURS) ? neighbours.size() : QUAD_NEIGHBOURS;
+		std::partial_sort(neighbours.begin(), neighbours.begin() + keep, neighbours.end(),
+			[&sorted](uint32_t i, uint32_t j) { return sorted[i].mag < sorted[j].mag; });
+
+		for (size_t i = 0; i < keep; i++)
+		{
+			for (size_t j = i + 1; j < keep; j++)
+			{
+				for (size_t k = j + 1; k < keep; k++)
+				{
+					uint32_t ids[4] = { a, neighbours[i], neighbours[j], neighbours[k] };
+					double x[4];
+					double y[4];
+					for (int n = 0; n < 4; n++)
+					{
+						double vector[3] = { sorted[ids[n]].x, sorted[ids[n]].y, sorted[ids[n]].z };
+						toTangent(vector, centerVector, x[n], y[n]);
+					}
+
+					int order[4];
+					double code[4];
+					if (!quadCode(x, y, order, code))
+					{
+						continue;
+					}
+
+					double base = hypot(x[order[1]] - x[order[0]], y[order[1]] - y[order[0]]);
+					std::array<uint32_t, 4> members = { ids[0], ids[1], ids[2], ids[3] };
+					std::sort(members.begin(), members.end());
+					if (base < minScale || base > maxScale || !seen.insert(members).second)
+					{
+						continue;
+					}
+
+					indexQuad quad;
+					int bins[4];
+					for (int n = 0; n < 4; n++)
+					{
+						quad.stars[n] = ids[order[n]];
+						quad.code[n] = (float)code[n];
+						bins[n] = codeBin(code[n]);
+					}
+					quad.key = codeKey(bins);
+					quads.push_back(quad);
+				}
+			}
+		}
+	}
+
+	std::sort(quads.begin(), quads.end(), [](const indexQuad &a, const indexQuad &b) { return a.key < b.key; });
+
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	indexHeader fileHeader;
+	fileHeader.magic = STAR_INDEX_MAGIC;
+	fileHeader.version = STAR_INDEX_VERSION;
+	fileHeader.starCount = (uint32_t)sorted.size();
+	fileHeader.quadCount = (uint32_t)quads.size();
+	fileHeader.minScaleDeg = QUAD_MIN_SCALE_DEG;
+	fileHeader.maxScaleDeg = QUAD_MAX_SCALE_DEG;
+
+	bool written = fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+		fwrite(sorted.data(), sizeof(indexStar), sorted.size(), file) == sorted.size() &&
+		fwrite(quads.data(), sizeof(indexQuad), quads.size(), file) == quads.size();
+
+	return (fclose(file) == 0) && written;
+}
+
+/**********************************************************************
+* Function:			open
+* Purpose: 			Maps an index file built by build()
+* Precondition:		Pass in the file path
+* Postcondition:	Returns true if the file has this layout and its size matches its counts, any index that
+*					was open is closed first
+************************************************************************/
+bool starIndex::open(const char *path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(indexHeader))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const indexHeader *fileHeader = (const indexHeader *)map;
+	size_t expected = sizeof(indexHeader) + (size_t)fileHeader->starCount * sizeof(indexStar) +
+		(size_t)fileHeader->quadCount * sizeof(indexQuad);
+	if (fileHeader->magic != STAR_INDEX_MAGIC || fileHeader->version != STAR_INDEX_VERSION || expected != (size_t)info.st_size)
+	{
+		munmap(map, (size_t)info.st_size);
+		return false;
+	}
+
+	mapping = map;
+	mappedBytes = (size_t)info.st_size;
+	header = fileHeader;
+	stars = (const indexStar *)(header + 1);
+	quads = (const indexQuad *)(stars + header->starCount);
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			close
+* Purpose: 			Unmaps the index
+* Precondition:		None
+* Postcondition:	No index is open, pointers from findQuads() and getStar() are no longer valid
+************************************************************************/
+void starIndex::close()
+{
+	if (mapping != nullptr)
+	{
+		munmap(mapping, mappedBytes);
+	}
+	mapping = nullptr;
+	mappedBytes = 0;
+	header = nullptr;
+	stars = nullptr;
+	quads = nullptr;
+}
+
+/**********************************************************************
+* Function:			findQuads
+* Purpose: 			Looks up every quad with one hash key
+* Precondition:		An index must be open
+* Postcondition:	first and last point into the mapping, equal if there are none
+************************************************************************/
+void starIndex::findQuads(uint32_t key, const indexQuad *&first, const indexQuad *&last)
+{
+	first = std::lower_bound(quads, quads + header->quadCount, key, [](const indexQuad &q, uint32_t k) { return q.key < k; });
+	last = first;
+	while (last != quads + header->quadCount && last->key == key)
+	{
+		last++;
+	}
+}
+
+/**********************************************************************
+* Function:			findStars
+* Purpose: 			Looks up the stars in a band of declination
+* Precondition:		An index must be open, pass in the band as z = sin(Dec)
+* Postcondition:	Stars first to last - 1 are inside the band
+************************************************************************/
+void starIndex::findStars(double minZ, double maxZ, uint32_t &first, uint32_t &last)
+{
+	first = (uint32_t)(std::lower_bound(stars, stars + header->starCount, minZ, [](const indexStar &s, double z) { return s.z < z; }) - stars);
+	last = (uint32_t)(std::upper_bound(stars, stars + header->starCount, maxZ, [](double z, const indexStar &s) { return z < s.z; }) - stars);
+}
+
+/**********************************************************************
+* Function:			quadCode
+* Purpose: 			Describes the shape of four points with four numbers
+* Precondition:		Pass in the points on a plane
+* Postcondition:	Returns false if the points are on top of each other. Otherwise A and B are the widest pair,
+*					the plane is moved, turned and scaled so A = (0, 0) and B = (1, 1), and code holds C and D
+*					there as xC, yC, xD, yD. A / B and C / D are picked so xC + xD <= 1 and xC <= xD, so the same
+*					four stars give the same code however they were listed. order holds A, B, C, D.
+* Sources:			Lang et al. 2010, "Astrometry.net: Blind astrometric calibration of arbitrary astronomical images"
+************************************************************************/
+bool starIndex::quadCode(const double x[4], const double y[4], int order[4], double code[4])
+{
+	const int pairs[6][4] = { { 0, 1, 2, 3 }, { 0, 2, 1, 3 }, { 0, 3, 1, 2 }, { 1, 2, 0, 3 }, { 1, 3, 0, 2 }, { 2, 3, 0, 1 } };
+	int widest = 0;
+	double widestSquared = -1;
+	for (int i = 0; i < 6; i++)
+	{
+		double dx = x[pairs[i][1]] - x[pairs[i][0]];
+		double dy = y[pairs[i][1]] - y[pairs[i][0]];
+		if (dx * dx + dy * dy > widestSquared)
+		{
+			widestSquared = dx * dx + dy * dy;
+			widest = i;
+		}
+	}
+	if (widestSquared <= 0)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		order[i] = pairs[widest][i];
+	}
+
+	//(p - A) / (B - A) * (1 + i) as complex numbers
+	double baseX = x[order[1]] - x[order[0]];
+	double baseY = y[order[1]] - y[order[0]];
+	for (int i = 0; i < 2; i++)
+	{
+		double px = x[order[2 + i]] - x[order[0]];
+		double py = y[order[2 + i]] - y[order[0]];
+		double re = (px * baseX + py * baseY) / widestSquared;
+		double im = (py * baseX - px * baseY) / widestSquared;
+		code[2 * i] = re - im;
+		code[2 * i + 1] = re + im;
+	}
+
+	if (code[0] + code[2] > 1)
+	{
+		std::swap(order[0], order[1]);
+		for (int i = 0; i < 4; i++)
+		{
+			code[i] = 1 - code[i];
+		}
+	}
+	if (code[0] > code[2])
+	{
+		std::swap(order[2], order[3]);
+		std::swap(code[0], code[2]);
+		std::swap(code[1], code[3]);
+	}
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			codeKey
+* Purpose: 			Packs the four bins of a quad code into one key
+* Precondition:		Pass in bins from codeBin()
+* Postcondition:	Returns a key below QUAD_CODE_BINS to the 4th
+************************************************************************/
+uint32_t starIndex::codeKey(const int bins[4])
+{
+	return (uint32_t)(((bins[0] * QUAD_CODE_BINS + bins[1]) * QUAD_CODE_BINS + bins[2]) * QUAD_CODE_BINS + bins[3]);
+}
+
+/**********************************************************************
+* Function:			codeBin
+* Purpose: 			Finds the bin one coordinate of a quad code falls in
+* Precondition:		Pass in a code coordinate
+* Postcondition:	Returns 0 to QUAD_CODE_BINS - 1, values past either end go in the end bins
+************************************************************************/
+int starIndex::codeBin(double value)
+{
+	int bin = (int)floor((value - QUAD_CODE_MIN) / (QUAD_CODE_MAX - QUAD_CODE_MIN) * QUAD_CODE_BINS);
+	return (bin < 0) ? 0 : (bin >= QUAD_CODE_BINS) ? QUAD_CODE_BINS - 1 : bin;
+}
+
+/**********************************************************************
+* Function:			toVector
+* Purpose: 			Converts RA / Dec to a unit vector
+* Precondition:		Pass in RA / Dec in degrees
+* Postcondition:	vector is filled, z toward the north pole and x toward RA 0
+************************************************************************/
+void starIndex::toVector(twoAxisDeg raDec, double vector[3])
+{
+	double ra = raDec.x * DEG_TO_RAD;
+	double dec = raDec.y * DEG_TO_RAD;
+	vector[0] = cos(dec) * cos(ra);
+	vector[1] = cos(dec) * sin(ra);
+	vector[2] = sin(dec);
+}
+
+/**********************************************************************
+* Function:			toRaDec
+* Purpose: 			Converts a unit vector back to RA / Dec
+* Precondition:		Pass in a unit vector as made by toVector()
+* Postcondition:	Returns twoAxisDeg with x = RA 0 - 360, y = Dec in degrees
+************************************************************************/
+twoAxisDeg starIndex::toRaDec(const double vector[3])
+{
+	twoAxisDeg raDec;
+	raDec.x = atan2(vector[1], vector[0]) * RAD_TO_DEG;
+	if (raDec.x < 0)
+	{
+		raDec.x += 360.0;
+	}
+	raDec.y = asin((vector[2] > 1) ? 1 : (vector[2] < -1) ? -1 : vector[2]) * RAD_TO_DEG;
+
+	return raDec;
+}
+
+/**********************************************************************
+* Function:			toTangent
+* Purpose: 			Gnomonic projection, what a camera lens does to the sky
+* Precondition:		Pass in the star and the center of the projection as unit vectors
+* Postcondition:	Returns false if the star is more than 90 degrees away, otherwise xi (east) and eta (north)
+*					are set in radians on the plane touching the sphere at center
+************************************************************************/
+bool starIndex::toTangent(const double star[3], const double center[3], double &xi, double &eta)
+{
+	double dot = star[0] * center[0] + star[1] * center[1] + star[2] * center[2];
+	if (dot <= 0)
+	{
+		return false;
+	}
+
+	//East and north unit vectors at the center, RA 0 is used for east at the pole itself
+	double ra = atan2(center[1], center[0]);
+	double cosDec = sqrt(center[0] * center[0] + center[1] * center[1]);
+	double east[3] = { -sin(ra), cos(ra), 0 };
+	double north[3] = { -center[2] * cos(ra), -center[2] * sin(ra), cosDec };
+
+	xi = (star[0] * east[0] + star[1] * east[1]) / dot;
+	eta = (star[0] * north[0] + star[1] * north[1] + star[2] * north[2]) / dot;
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			fromTangent
+* Purpose: 			Inverse of toTangent(), from the camera plane back to the sky
+* Precondition:		Pass in xi / eta in radians and the center of the projection as a unit vector
+* Postcondition:	vector is filled with the unit vector of that point
+************************************************************************/
+void starIndex::fromTangent(double xi, double eta, const double center[3], double vector[3])
+{
+	double ra = atan2(center[1], center[0]);
+	double cosDec = sqrt(center[0] * center[0] + center[1] * center[1]);
+	double east[3] = { -sin(ra), cos(ra), 0 };
+	double north[3] = { -center[2] * cos(ra), -center[2] * sin(ra), cosDec };
+
+	double length = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		vector[i] = center[i] + xi * east[i] + eta * north[i];
+		length += vector[i] * vector[i];
+	}
+	length = sqrt(length);
+	for (int i = 0; i < 3; i++)
+	{
+		vector[i] /= length;
+	}
+}
@@ -0,0 +1,152 @@
+/*************************************************************
+* Filename:			starIndex.h
+* Purpose:			Star catalog and a memory-mapped index of star quads for blind plate solving
+**************************************************************/
+#pragma once
+
+#include <stdint.h>			//uint32_t
+#include <stddef.h>			//size_t
+#include <vector>			//std::vector
+#include "coordinate.h"		//twoAxisDeg
+
+#define STAR_INDEX_MAGIC 0x58444953		//"SIDX"
+#define STAR_INDEX_VERSION 1
+#define STAR_INDEX_DEFAULT_PATH "stars.idx"
+
+//Quads are built to fit a finder camera field, a few degrees across
+#define QUAD_MIN_SCALE_DEG 1.0			//Shortest base pair, smaller quads are too sensitive to centroid noise
+#define QUAD_MAX_SCALE_DEG 4.0			//Longest base pair, larger ones would not fit in the frame
+#define QUAD_NEIGHBOURS 10				//Brightest neighbours of each star that quads are made from
+
+//Each of the 4 code values is binned for the hash key
+#define QUAD_CODE_MIN -0.25
+#define QUAD_CODE_MAX 1.25
+#define QUAD_CODE_BINS 64
+
+/************************************************************************
+* Struct: 		catalogStar
+* Purpose:		One line of a catalog
+* Data members:	raDeg / decDeg	- Position in degrees
+*				mag				- Visual magnitude
+*************************************************************************/
+typedef struct catalogStar
+{
+	double raDeg;
+	double decDeg;
+	float mag;
+} catalogStar;
+
+/************************************************************************
+* Struct: 		indexHeader
+* Purpose:		Start of an index file, followed by starCount indexStar then quadCount indexQuad
+* Data members:	magic / version		- Identify the layout
+*				starCount			- Stars in the file
+*				quadCount			- Quads in the file
+*				minScaleDeg / maxScaleDeg	- Base pair lengths the quads were built with
+*************************************************************************/
+typedef struct indexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t starCount;
+	uint32_t quadCount;
+	double minScaleDeg;
+	double maxScaleDeg;
+} indexHeader;
+
+/************************************************************************
+* Struct: 		indexStar
+* Purpose:		A catalog star as a unit vector, stars are stored in order of z so a band of declination is
+*				one range of the array
+* Data members:	x, y, z	- Unit vector, z toward the north pole and x toward RA 0
+*				mag		- Visual magnitude
+*************************************************************************/
+typedef struct indexStar
+{
+	double x;
+	double y;
+	double z;
+	float mag;
+	uint32_t padding;
+} indexStar;
+
+/************************************************************************
+* Struct: 		indexQuad
+* Purpose:		Four stars and the shape they make, stored in order of key
+* Data members:	key		- Hash of the binned code
+*				stars	- Indexes of A, B (the widest pair) then C, D, in the order the code was made with
+*				code	- Positions of C and D in the frame where A = (0, 0) and B = (1, 1). The code does not
+*						  change with position, rotation or scale, so it is the same on the sky and in an image.
+*************************************************************************/
+typedef struct indexQuad
+{
+	uint32_t key;
+	uint32_t stars[4];
+	float code[4];
+} indexQuad;
+
+/************************************************************************
+* Class: 		starIndex
+* Purpose:		Builds an index file from a catalog and maps one for the solver. The file is mapped read only,
+*				so opening it costs nothing however large it is and the pages are shared between processes.
+* Data members:	mapping		- Start of the mapped file, nullptr if none is open
+*				mappedBytes	- Size of the mapping
+*				header		- Header inside the mapping
+*				stars		- Stars inside the mapping
+*				quads		- Quads inside the mapping
+*
+* Methods:		loadCatalog
+*				saveCatalog
+*				build
+*				open
+*				close
+*				findQuads
+*				findStars
+*				quadCode
+*				codeKey
+*				codeBin
+*				toVector / toRaDec
+*				toTangent / fromTangent
+*************************************************************************/
+class starIndex
+{
+	public:
+		starIndex();
+		~starIndex();
+
+		//Catalog text file, one star per line: RA(deg) Dec(deg) magnitude
+		static std::vector<catalogStar> loadCatalog(const char *path);
+		static bool saveCatalog(const std::vector<catalogStar> &catalog, const char *path);
+
+		static bool build(const std::vector<catalogStar> &catalog, const char *path);
+
+		bool open(const char *path);
+		void close();
+		bool isOpen() { return mapping != nullptr; }
+
+		uint32_t getStarCount() { return header->starCount; }
+		uint32_t getQuadCount() { return header->quadCount; }
+		const indexStar &getStar(uint32_t index) { return stars[index]; }
+		size_t getFileBytes() { return mappedBytes; }
+
+		//Quads whose key matches, as [first, last)
+		void findQuads(uint32_t key, const indexQuad *&first, const indexQuad *&last);
+		//Stars with z between the limits, as [first, last) indexes
+		void findStars(double minZ, double maxZ, uint32_t &first, uint32_t &last);
+
+		static bool quadCode(const double x[4], const double y[4], int order[4], double code[4]);
+		static uint32_t codeKey(const int bins[4]);
+		static int codeBin(double value);
+
+		static void toVector(twoAxisDeg raDec, double vector[3]);
+		static twoAxisDeg toRaDec(const double vector[3]);
+		static bool toTangent(const double star[3], const double center[3], double &xi, double &eta);
+		static void fromTangent(double xi, double eta, const double center[3], double vector[3]);
+
+	private:
+		void *mapping;
+		size_t mappedBytes;
+		const indexHeader *header;
+		const indexStar *stars;
+		const indexQuad *quads;
+};
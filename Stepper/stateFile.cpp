@@ -0,0 +1,221 @@
+/*************************************************************
+* Filename:			stateFile.cpp
+* Purpose:			Keep the mount state in a small memory-mapped file so a restart can resume without re-aligning
+**************************************************************/
+#include "stateFile.h"
+
+#include <fcntl.h>		//open(), O_RDWR, O_CREAT
+#include <unistd.h>		//close(), ftruncate()
+#include <sys/mman.h>	//mmap(), msync(), munmap()
+#include <sys/stat.h>	//fstat()
+#include <atomic>		//std::atomic_signal_fence()
+
+/**********************************************************************
+* Function:			stateFile (constructor)
+* Purpose: 			Creates a closed state file
+* Precondition:		None
+* Postcondition:	open() must be called before load() or save()
+************************************************************************/
+stateFile::stateFile()
+{
+	fd = -1;
+	slots = nullptr;
+	sequence = 0;
+}
+
+/**********************************************************************
+* Function:			~stateFile (destructor)
+* Purpose: 			Flushes and unmaps the file
+* Precondition:		None
+* Postcondition:	File is closed
+************************************************************************/
+stateFile::~stateFile()
+{
+	close();
+}
+
+/**********************************************************************
+* Function:			open
+* Purpose: 			Opens or creates the state file and maps it into memory
+* Precondition:		Pass in the path of the file
+* Postcondition:	Returns true if the file is mapped. A new file has two empty (invalid) slots.
+************************************************************************/
+bool stateFile::open(const char *path)
+{
+	size_t size = sizeof(stateSlot) * STATE_FILE_SLOTS;
+	struct stat info;
+
+	close();
+
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	//Grow a new or short file to hold both slots, new bytes read as zero so the slots are invalid
+	if (fstat(fd, &info) != 0 || ((size_t)info.st_size < size && ftruncate(fd, size) != 0))
+	{
+		close();
+		return false;
+	}
+
+	void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapped == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	slots = (stateSlot *)mapped;
+
+	//Continue numbering after the newest valid slot
+	sequence = 0;
+	for (int i = 0; i < STATE_FILE_SLOTS; i++)
+	{
+		if (isValid(&slots[i]) && slots[i].sequence > sequence)
+		{
+			sequence = slots[i].sequence;
+		}
+	}
+
+	return true;
+}
+
+/**********************************************************************
+* Function:			close
+* Purpose: 			Flushes and unmaps the file
+* Precondition:		None
+* Postcondition:	File is closed, safe to call more than once
+************************************************************************/
+void stateFile::close()
+{
+	if (slots != nullptr)
+	{
+		msync(slots, sizeof(stateSlot) * STATE_FILE_SLOTS, MS_SYNC);
+		munmap(slots, sizeof(stateSlot) * STATE_FILE_SLOTS);
+		slots = nullptr;
+	}
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+/**********************************************************************
+* Function:			isOpen
+* Purpose: 			Checks if the file is mapped
+* Precondition:		None
+* Postcondition:	Returns true if load() and save() can be used
+************************************************************************/
+bool stateFile::isOpen()
+{
+	return slots != nullptr;
+}
+
+/**********************************************************************
+* Function:			load
+* Purpose: 			Reads the newest valid state
+* Precondition:		open() returned true
+* Postcondition:	Returns true and fills state if a slot passed its checksum, otherwise returns false
+************************************************************************/
+bool stateFile::load(mountState &state)
+{
+	const stateSlot *newest = nullptr;
+
+	if (slots == nullptr)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < STATE_FILE_SLOTS; i++)
+	{
+		if (isValid(&slots[i]) && (newest == nullptr || slots[i].sequence > newest->sequence))
+		{
+			newest = &slots[i];
+		}
+	}
+
+	if (newest == nullptr)
+	{
+		return false;
+	}
+
+	state = newest->state;
+	return true;
+}
+
+/**********************************************************************
+* Function:			save
+* Purpose: 			Stores a new state
+* Precondition:		open() returned true
+* Postcondition:	The slot not holding the newest state is overwritten and checksummed last, so a crash part way
+*					through leaves the previous state loadable. No system call is made, call flush() to force
+*					the page to disk.
+************************************************************************/
+void stateFile::save(const mountState &state)
+{
+	if (slots == nullptr)
+	{
+		return;
+	}
+
+	sequence++;
+	stateSlot *slot = &slots[sequence % STATE_FILE_SLOTS];
+
+	//Invalidate first so a torn write can never pass as the newest slot, fences stop the compiler reordering the stores
+	slot->checksum = 0;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	slot->magic = STATE_FILE_MAGIC;
+	slot->version = STATE_FILE_VERSION;
+	slot->sequence = sequence;
+	slot->state = state;
+	slot->padding = 0;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	slot->checksum = checksum(slot);
+}
+
+/**********************************************************************
+* Function:			flush
+* Purpose: 			Forces the mapped state to disk
+* Precondition:		open() returned true
+* Postcondition:	State survives a power loss, not only a process crash
+************************************************************************/
+void stateFile::flush()
+{
+	if (slots != nullptr)
+	{
+		msync(slots, sizeof(stateSlot) * STATE_FILE_SLOTS, MS_SYNC);
+	}
+}
+
+/**********************************************************************
+* Function:			checksum
+* Purpose: 			FNV-1a hash of a slot up to the checksum field
+* Precondition:		Pass in a slot
+* Postcondition:	Returns the 32 bit hash
+************************************************************************/
+uint32_t stateFile::checksum(const stateSlot *slot)
+{
+	const uint8_t *bytes = (const uint8_t *)slot;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < offsetof(stateSlot, checksum); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**********************************************************************
+* Function:			isValid
+* Purpose: 			Checks that a slot is a complete save of this file layout
+* Precondition:		Pass in a slot
+* Postcondition:	Returns true if the magic, version, and checksum all match
+************************************************************************/
+bool stateFile::isValid(const stateSlot *slot)
+{
+	return slot->magic == STATE_FILE_MAGIC && slot->version == STATE_FILE_VERSION && slot->checksum == checksum(slot);
+}
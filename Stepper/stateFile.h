@@ -0,0 +1,102 @@
+/*************************************************************
+* Filename:			stateFile.h
+* Purpose:			Keep the mount state in a small memory-mapped file so a restart can resume without re-aligning
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t, uint32_t, uint64_t
+#include <stddef.h>		//size_t
+#include "slewPlanner.h"	//slewLimits
+
+#define STATE_FILE_PATH "mountState.bin"
+#define STATE_FILE_MAGIC 0x4D4E5453		//"STNM"
+#define STATE_FILE_VERSION 2
+#define STATE_FILE_SLOTS 2
+
+/************************************************************************
+* Struct: 		mountState
+* Purpose:		Everything needed to resume pointing after a restart
+* Data members:	latDeg / longDeg		- Observer location in degrees
+*				altSteps / azSteps		- Exact microstep counters of each axis
+*				altMotorSteps / azMotorSteps	- Motor shaft phase of each axis, keeps PEC tables lined up
+*				cableNeutralAzDeg		- Unwrapped azimuth where the cables hang freely
+*				limits					- Cable-wrap and altitude limits
+*				targetRaDeg / targetDecDeg	- Target being tracked
+*				calibrated				- 1 once calibrate() has run
+*				tracking				- 1 while a target is being tracked
+*				motorsEnabled			- 1 while the drivers hold the motors, positions are lost when they are released
+*************************************************************************/
+typedef struct mountState
+{
+	double latDeg;
+	double longDeg;
+	int64_t altSteps;
+	int64_t azSteps;
+	int64_t altMotorSteps;
+	int64_t azMotorSteps;
+	double cableNeutralAzDeg;
+	slewLimits limits;
+	double targetRaDeg;
+	double targetDecDeg;
+	int32_t calibrated;
+	int32_t tracking;
+	int32_t motorsEnabled;
+	int32_t reserved;
+} mountState;
+
+/************************************************************************
+* Struct: 		stateSlot
+* Purpose:		One copy of the state on disk. Two slots are written in turn so a crash in the middle of a
+*				write always leaves the other one intact.
+* Data members:	magic / version	- Identifies the file layout
+*				sequence		- Increases on every save, the valid slot with the highest sequence wins
+*				state			- The saved state
+*				checksum		- FNV-1a over everything before it
+*************************************************************************/
+typedef struct stateSlot
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sequence;
+	mountState state;
+	uint32_t checksum;
+	uint32_t padding;
+} stateSlot;
+
+/************************************************************************
+* Class: 		stateFile
+* Purpose:		Memory-maps the state file. Saving is a plain memory write into the older slot plus a checksum,
+*				the kernel writes the page back, so it is cheap enough to do on every move.
+* Data members:	fd			- File descriptor of the open file, -1 when closed
+*				slots		- Mapped slots
+*				sequence	- Sequence number of the newest slot
+*
+* Methods:		open
+*				close
+*				isOpen
+*				load
+*				save
+*				flush
+*************************************************************************/
+class stateFile
+{
+	public:
+		stateFile();
+		~stateFile();
+
+		bool open(const char *path);
+		void close();
+		bool isOpen();
+
+		bool load(mountState &state);
+		void save(const mountState &state);
+		void flush();
+
+	private:
+		static uint32_t checksum(const stateSlot *slot);
+		bool isValid(const stateSlot *slot);
+
+		int fd;
+		stateSlot *slots;
+		uint64_t sequence;
+};
@@ -0,0 +1,140 @@
+/*************************************************************
+* Filename:			stepScheduler.cpp
+* Purpose:			Time step pulses against absolute deadlines so the step rate does not drift
+**************************************************************/
+#include "stepScheduler.h"
+
+#include <time.h>			//clock_gettime(), clock_nanosleep(), TIMER_ABSTIME
+#include <errno.h>			//EINTR
+#include <algorithm>		//std::sort()
+#include <vector>			//std::vector
+
+/**********************************************************************
+* Function:			stepScheduler (constructor)
+* Purpose: 			Creates a scheduler for one mount
+* Precondition:		Pass in the gpio driver the mount pulses, it must outlive the scheduler
+* Postcondition:	The first edge is timed from when it is made
+************************************************************************/
+stepScheduler::stepScheduler(gpioDriver *gpio) : gpio(gpio), missed(0), edges(0)
+{
+	deadline = 0;
+	restart = true;
+}
+
+/**********************************************************************
+* Function:			resync
+* Purpose: 			Ends a run of pulses
+* Precondition:		Call when the mount stops pulsing for a while, like when it is on target
+* Postcondition:	The next edge is timed from when it is made, the idle time is not counted as missed
+************************************************************************/
+void stepScheduler::resync()
+{
+	restart = true;
+}
+
+/**********************************************************************
+* Function:			edge
+* Purpose: 			Holds the level just written until its deadline
+* Precondition:		Call right after writing a pin, pass in how long the level should last
+* Postcondition:	Returns at the previous deadline plus intervalMicros. A late edge is counted as missed and,
+*					if it is more than a whole interval late, the deadlines restart from now rather than
+*					sending a burst of short pulses to catch up.
+************************************************************************/
+void stepScheduler::edge(unsigned intervalMicros)
+{
+	edges.fetch_add(1, std::memory_order_relaxed);
+	if (!gpio->hasRealTiming())
+	{
+		return;
+	}
+
+	int64_t interval = (int64_t)intervalMicros * 1000;
+	int64_t time = now();
+	if (restart)
+	{
+		deadline = time;
+		restart = false;
+	}
+	deadline += interval;
+
+	if (time > deadline + MISSED_DEADLINE_NANOS)
+	{
+		missed.fetch_add(1, std::memory_order_relaxed);
+		if (time > deadline + interval)
+		{
+			deadline = time;
+		}
+		return;
+	}
+
+	//Sleep until just before the deadline, then spin the rest so the wake-up latency does not show. If the
+	//spin would take the whole interval just sleep, a busy core costs more than a slightly late edge.
+	int64_t spin = getSpinNanos();
+	if (spin >= interval)
+	{
+		spin = 0;
+	}
+	int64_t wake = deadline - spin;
+	if (wake > time)
+	{
+		timespec until;
+		until.tv_sec = wake / 1000000000;
+		until.tv_nsec = wake % 1000000000;
+		//Only a signal is worth sleeping again for, any other error falls through to the bounded spin
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR)
+		{
+		}
+	}
+	while (now() < deadline)
+	{
+	}
+}
+
+/**********************************************************************
+* Function:			now
+* Purpose: 			Returns the time deadlines are measured in
+* Precondition:		None
+* Postcondition:	Returns CLOCK_MONOTONIC in nanoseconds
+************************************************************************/
+int64_t stepScheduler::now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**********************************************************************
+* Function:			getSpinNanos
+* Purpose: 			Returns how long before a deadline the sleep ends
+* Precondition:		None
+* Postcondition:	Measured on the first call, which takes about 10ms, and kept for the whole program
+************************************************************************/
+int64_t stepScheduler::getSpinNanos()
+{
+	static const int64_t spin = measureSpin();
+	return spin;
+}
+
+/**********************************************************************
+* Function:			measureSpin
+* Purpose: 			Measures how late clock_nanosleep wakes up
+* Precondition:		None
+* Postcondition:	Returns the 99th percentile lateness plus SPIN_MARGIN_NANOS, at most SPIN_MAX_NANOS
+************************************************************************/
+int64_t stepScheduler::measureSpin()
+{
+	std::vector<int64_t> late;
+	for (int i = 0; i < SPIN_CALIBRATION_SAMPLES; i++)
+	{
+		int64_t wake = now() + 100000;
+		timespec until;
+		until.tv_sec = wake / 1000000000;
+		until.tv_nsec = wake % 1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr);
+		late.push_back(now() - wake);
+	}
+	std::sort(late.begin(), late.end());
+
+	int64_t spin = late[late.size() * 99 / 100] + SPIN_MARGIN_NANOS;
+	return (spin > SPIN_MAX_NANOS) ? SPIN_MAX_NANOS : spin;
+}
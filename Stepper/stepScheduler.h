@@ -0,0 +1,59 @@
+/*************************************************************
+* Filename:			stepScheduler.h
+* Purpose:			Time step pulses against absolute deadlines so the step rate does not drift
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t, uint64_t
+#include <atomic>		//std::atomic
+#include "gpioDriver.h"	//gpioDriver
+
+#define SPIN_CALIBRATION_SAMPLES 100
+#define SPIN_MAX_NANOS 30000			//Never spin longer than this, a longer wake-up latency is slept through and shows as lateness
+#define SPIN_MARGIN_NANOS 5000			//Added to the measured wake-up latency
+#define MISSED_DEADLINE_NANOS 10000		//An edge this late counts as missed
+
+/************************************************************************
+* Class: 		stepScheduler
+* Purpose:		Holds each pin level until an absolute deadline, the previous deadline plus the planned
+*				interval, instead of sleeping for the interval from whenever the last wait ended. Waits
+*				sleep in clock_nanosleep(TIMER_ABSTIME) and spin only for the last few microseconds, the
+*				wake-up latency measured once per program up to SPIN_MAX_NANOS. An interval no longer than
+*				that is slept through whole, spinning all of it would keep a core busy for every pulse.
+*				One scheduler is shared by both axes of a mount since their pulses are made one after
+*				the other.
+* Data members:	gpio		- Timing is skipped if its pins have no real timing
+*				deadline	- CLOCK_MONOTONIC nanoseconds of the last edge
+*				restart		- The next edge starts a new run of pulses, timed from now
+*				missed		- Edges that came later than MISSED_DEADLINE_NANOS
+*				edges		- Edges timed
+*
+* Methods:		resync
+*				edge
+*				getMissed
+*				getEdges
+*				now
+*				getSpinNanos
+*************************************************************************/
+class stepScheduler
+{
+	public:
+		stepScheduler(gpioDriver *gpio);
+
+		void resync();
+		void edge(unsigned intervalMicros);
+		uint64_t getMissed() { return missed.load(std::memory_order_relaxed); }
+		uint64_t getEdges() { return edges.load(std::memory_order_relaxed); }
+
+		static int64_t now();
+		static int64_t getSpinNanos();
+
+	private:
+		static int64_t measureSpin();
+
+		gpioDriver *gpio;
+		int64_t deadline;
+		bool restart;
+		std::atomic<uint64_t> missed;
+		std::atomic<uint64_t> edges;
+};
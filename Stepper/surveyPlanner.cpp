@@ -0,0 +1,404 @@
+/*************************************************************
+* Filename:			surveyPlanner.cpp
+* Purpose:			Cover a rectangle of sky with a mosaic of tiles, visited in one continuous track
+**************************************************************/
+#include "surveyPlanner.h"
+#include "sidereal.h"			//DEG_TO_RAD, SECONDS_PER_DAY
+
+#include <math.h>		//cos(), ceil(), fmod(), fabs()
+
+/**********************************************************************
+* Function:			spreadTiles
+* Purpose: 			Places tiles evenly across one axis of the region
+* Precondition:		Pass in the ends of the axis, the field on that axis and the largest step between tiles, in
+*					the same degrees
+* Postcondition:	Returns the tile centers, the first and last flush with the ends. A span no wider than the
+*					field gets one tile in the middle. Empty if it would take more than SURVEY_MAX_TILES.
+************************************************************************/
+static std::vector<double> spreadTiles(double low, double high, double fieldDeg, double stepDeg)
+{
+	std::vector<double> centers;
+	double span = high - low;
+	if (span <= fieldDeg)
+	{
+		centers.push_back((low + high) / 2.0);
+		return centers;
+	}
+
+	//The small tolerance keeps a span that is a whole number of steps from rounding up to an extra tile
+	double steps = ceil((span - fieldDeg) / stepDeg - 1e-9);
+	if (steps >= SURVEY_MAX_TILES)
+	{
+		return centers;
+	}
+
+	int count = (int)steps + 1;
+	double spacing = (span - fieldDeg) / (count - 1);
+	for (int i = 0; i < count; i++)
+	{
+		centers.push_back(low + fieldDeg / 2.0 + i * spacing);
+	}
+
+	return centers;
+}
+
+/**********************************************************************
+* Function:			surveyPlanner (constructor)
+* Purpose: 			Sets up a planner for one telescope
+* Precondition:		Pass in a calibrated telescope, it must outlive the planner
+* Postcondition:	Nothing is running until begin()
+************************************************************************/
+surveyPlanner::surveyPlanner(coordinate &mount) : mount(mount)
+{
+	running = {};
+	tileIndex = 0;
+	arrived = false;
+	dwellEndJd = 0;
+	startedJd = 0;
+	finishedJd = 0;
+	active = false;
+}
+
+/**********************************************************************
+* Function:			plan
+* Purpose: 			Finds the fastest serpentine over a region
+* Precondition:		Pass in the region, the field of each tile, and the julian date the survey starts
+* Postcondition:	Returns the plan with the least total time out of both orientations and all four start
+*					corners, timed from where the mount points now. rasterSeconds is filled in for comparison.
+*					The plan has no tiles if the field is not usable or the region reaches past
+*					SURVEY_MAX_DEC_DEG.
+************************************************************************/
+surveyPlan surveyPlanner::plan(surveyRegion region, surveyField field, double startJd)
+{
+	surveyPlan best = {};
+	best.dwellSeconds = field.dwellSeconds;
+
+	for (int orientation = 0; orientation < 2; orientation++)
+	{
+		bool alongRa = (orientation == 0);
+		std::vector<std::vector<twoAxisDeg>> lines = layoutLines(region, field, alongRa);
+		if (lines.empty())
+		{
+			continue;
+		}
+
+		for (int corner = 0; corner < SURVEY_CORNERS; corner++)
+		{
+			surveyPlan candidate = timeOrder(lines, alongRa, corner, true, field.dwellSeconds, startJd);
+			if (best.tiles.empty() || candidate.totalSeconds < best.totalSeconds)
+			{
+				best = candidate;
+			}
+		}
+	}
+
+	if (!best.tiles.empty())
+	{
+		best.rasterSeconds = planRaster(region, field, startJd).totalSeconds;
+	}
+
+	return best;
+}
+
+/**********************************************************************
+* Function:			planRaster
+* Purpose: 			Plans a region the way a list of gotos would cover it
+* Precondition:		Pass in the region, the field of each tile, and the julian date the survey starts
+* Postcondition:	Returns rows along RA from the lowest Dec, each run from the lowest RA, so every row ends
+*					with a move back across the region
+************************************************************************/
+surveyPlan surveyPlanner::planRaster(surveyRegion region, surveyField field, double startJd)
+{
+	std::vector<std::vector<twoAxisDeg>> lines = layoutLines(region, field, true);
+	if (lines.empty())
+	{
+		surveyPlan empty = {};
+		empty.dwellSeconds = field.dwellSeconds;
+		return empty;
+	}
+
+	return timeOrder(lines, true, 0, false, field.dwellSeconds, startJd);
+}
+
+/**********************************************************************
+* Function:			begin
+* Purpose: 			Starts running a plan
+* Precondition:		Pass in a plan from plan() or planRaster()
+* Postcondition:	The mount starts slewing to the first tile, the moves are made by update(). isActive() is
+*					false if the plan has no tiles.
+************************************************************************/
+void surveyPlanner::begin(const surveyPlan &plan)
+{
+	running = plan;
+	tileIndex = 0;
+	arrived = false;
+	startedJd = sidereal::getJulianDate();
+	finishedJd = startedJd;
+	active = !running.tiles.empty();
+
+	if (active)
+	{
+		mount.beginTrack(running.tiles[0].raDec, -1);
+	}
+}
+
+/**********************************************************************
+* Function:			update
+* Purpose: 			Moves the survey on, the body of its loop
+* Precondition:		begin() must have been called, pass in the most pulses per axis to make before returning
+* Postcondition:	Returns how many pulses were made, the same as coordinate::updateTrack(). The dwell on a tile
+*					starts the first time the mount is on it, not when it was planned, so a late slew never
+*					shortens it. Once it ends the track is moved to the next tile, and after the last one it is
+*					stopped. isActive() turns false then, or if tracking was stopped some other way.
+************************************************************************/
+int surveyPlanner::update(int maxPulses)
+{
+	if (!active)
+	{
+		return 0;
+	}
+
+	double julianDate = sidereal::getJulianDate();
+	if (arrived && julianDate >= dwellEndJd)
+	{
+		tileIndex++;
+		if (tileIndex == (int)running.tiles.size())
+		{
+			mount.endTrack();
+			finishedJd = julianDate;
+			active = false;
+			return 0;
+		}
+
+		mount.retarget(running.tiles[tileIndex].raDec);
+		arrived = false;
+	}
+
+	int pulses = mount.updateTrack(maxPulses);
+	if (!mount.isTracking())
+	{
+		finishedJd = sidereal::getJulianDate();
+		active = false;
+		return pulses;
+	}
+
+	//A short slice means both axes caught up with the tile
+	if (!arrived && pulses < maxPulses)
+	{
+		arrived = true;
+		dwellEndJd = sidereal::getJulianDate() + running.dwellSeconds / SECONDS_PER_DAY;
+	}
+
+	return pulses;
+}
+
+/**********************************************************************
+* Function:			getElapsedSeconds
+* Purpose: 			Time the running survey has taken
+* Precondition:		begin() must have been called
+* Postcondition:	Returns seconds from begin() until now, or until the survey ended
+************************************************************************/
+double surveyPlanner::getElapsedSeconds()
+{
+	double endJd = active ? sidereal::getJulianDate() : finishedJd;
+	return (endJd - startedJd) * SECONDS_PER_DAY;
+}
+
+/**********************************************************************
+* Function:			printPlan
+* Purpose: 			Prints the shape and time of a survey
+* Precondition:		Pass in a plan from plan()
+* Postcondition:	Tile count, orientation, first tile, and the modeled times are printed
+************************************************************************/
+void surveyPlanner::printPlan(const surveyPlan &plan)
+{
+	if (plan.tiles.empty())
+	{
+		cout << "Region could not be tiled, the field must be larger than 0 with overlap under 1, and the region inside Dec +/-"
+			<< SURVEY_MAX_DEC_DEG << endl;
+		return;
+	}
+
+	cout << "Survey: " << plan.tiles.size() << " tiles in " << plan.lines << (plan.alongRa ? " rows along RA" : " columns along Dec")
+		<< ", starting at RA " << plan.tiles[0].raDec.x << " Dec " << plan.tiles[0].raDec.y << endl;
+	cout << "Slewing: " << plan.totalSlewSeconds << "s Dwelling: " << plan.tiles.size() * plan.dwellSeconds
+		<< "s Total: " << plan.totalSeconds << "s" << endl;
+	if (plan.rasterSeconds > 0)
+	{
+		cout << "One goto per tile in rows: " << plan.rasterSeconds << "s" << endl;
+	}
+	if (plan.outOfLimits > 0)
+	{
+		cout << plan.outOfLimits << " tiles are outside the altitude or cable-wrap limits at their planned time" << endl;
+	}
+}
+
+/**********************************************************************
+* Function:			layoutLines
+* Purpose: 			Tiles a region in the celestial frame
+* Precondition:		Pass in the region, the field of each tile, and true for rows of constant Dec or false for
+*					columns of constant RA
+* Postcondition:	Returns the lines of the mosaic, each in order of increasing RA or Dec, with neighbours
+*					overlapping by at least field.overlap. Empty if the field is not usable, the region reaches
+*					past SURVEY_MAX_DEC_DEG, or it would take more than SURVEY_MAX_TILES.
+************************************************************************/
+std::vector<std::vector<twoAxisDeg>> surveyPlanner::layoutLines(surveyRegion region, surveyField field, bool alongRa)
+{
+	std::vector<std::vector<twoAxisDeg>> lines;
+	if (field.widthDeg <= 0 || field.heightDeg <= 0 || field.overlap < 0 || field.overlap >= 1 ||
+		region.widthDeg < 0 || region.heightDeg < 0)
+	{
+		return lines;
+	}
+
+	double decLow = region.centerRaDec.y - region.heightDeg / 2.0;
+	std::vector<double> decs = spreadTiles(decLow, decLow + region.heightDeg, field.heightDeg, field.heightDeg * (1.0 - field.overlap));
+	if (decs.empty() || fabs(region.centerRaDec.y) + region.heightDeg / 2.0 > SURVEY_MAX_DEC_DEG)
+	{
+		return lines;
+	}
+
+	//The region's width is on the sky at its center, RA degrees get narrower toward the pole
+	double raSpan = region.widthDeg / cos(region.centerRaDec.y * DEG_TO_RAD);
+	double raLow = region.centerRaDec.x - raSpan / 2.0;
+
+	//RA steps are sized at the poleward edge of the tiles they separate, where the overlap is least. Columns
+	//share one set of RA steps, so theirs is the edge of the whole mosaic.
+	double mosaicEdgeDeg = 0;
+	for (int i = 0; i < (int)decs.size(); i++)
+	{
+		double edgeDeg = fabs(decs[i]) + field.heightDeg / 2.0;
+		mosaicEdgeDeg = (edgeDeg > mosaicEdgeDeg) ? edgeDeg : mosaicEdgeDeg;
+	}
+	if (mosaicEdgeDeg > SURVEY_MAX_DEC_DEG)
+	{
+		return lines;
+	}
+
+	int tiles = 0;
+	if (alongRa)
+	{
+		for (int i = 0; i < (int)decs.size(); i++)
+		{
+			double cosEdge = cos((fabs(decs[i]) + field.heightDeg / 2.0) * DEG_TO_RAD);
+			std::vector<double> ras = spreadTiles(raLow, raLow + raSpan, field.widthDeg / cosEdge, field.widthDeg * (1.0 - field.overlap) / cosEdge);
+
+			std::vector<twoAxisDeg> row;
+			for (int j = 0; j < (int)ras.size(); j++)
+			{
+				twoAxisDeg tile;
+				tile.x = fmod(ras[j] + 360.0, 360.0);
+				tile.y = decs[i];
+				row.push_back(tile);
+			}
+			tiles += (int)row.size();
+			lines.push_back(row);
+		}
+	}
+	else
+	{
+		double cosEdge = cos(mosaicEdgeDeg * DEG_TO_RAD);
+		std::vector<double> ras = spreadTiles(raLow, raLow + raSpan, field.widthDeg / cosEdge, field.widthDeg * (1.0 - field.overlap) / cosEdge);
+
+		for (int j = 0; j < (int)ras.size(); j++)
+		{
+			std::vector<twoAxisDeg> column;
+			for (int i = 0; i < (int)decs.size(); i++)
+			{
+				twoAxisDeg tile;
+				tile.x = fmod(ras[j] + 360.0, 360.0);
+				tile.y = decs[i];
+				column.push_back(tile);
+			}
+			tiles += (int)column.size();
+			lines.push_back(column);
+		}
+	}
+
+	//A line that could not be spread, or too many tiles, leaves nothing worth running
+	for (int i = 0; i < (int)lines.size(); i++)
+	{
+		if (lines[i].empty())
+		{
+			tiles = SURVEY_MAX_TILES + 1;
+		}
+	}
+	if (tiles > SURVEY_MAX_TILES)
+	{
+		lines.clear();
+	}
+
+	return lines;
+}
+
+/**********************************************************************
+* Function:			timeOrder
+* Purpose: 			Orders the tiles of a mosaic and times the survey with the mount's slew model
+* Precondition:		Pass in the lines from layoutLines() and their orientation, the start corner (bit 0 runs the
+*					first line backwards, bit 1 starts from the last line), true for a serpentine or false to
+*					run every line the same way, the dwell, and the julian date the survey starts
+* Postcondition:	Returns the plan. Each slew is aimed at where the tile is once the slew ends and starts from
+*					where tracking the last tile left the mount, so the sky turning during the survey is counted.
+************************************************************************/
+surveyPlan surveyPlanner::timeOrder(const std::vector<std::vector<twoAxisDeg>> &lines, bool alongRa, int corner, bool serpentine, double dwellSeconds, double startJd)
+{
+	surveyPlan result = {};
+	result.lines = (int)lines.size();
+	result.alongRa = alongRa;
+	result.dwellSeconds = dwellSeconds;
+
+	bool lastLineFirst = (corner & 2) != 0;
+	bool firstBackwards = (corner & 1) != 0;
+	twoAxisDeg fromAltAz = mount.getCurrentAltAz();
+	double julianDate = startJd;
+
+	for (int i = 0; i < (int)lines.size(); i++)
+	{
+		const std::vector<twoAxisDeg> &line = lines[lastLineFirst ? lines.size() - 1 - i : i];
+		bool backwards = firstBackwards != (serpentine && (i % 2 == 1));
+
+		for (int j = 0; j < (int)line.size(); j++)
+		{
+			surveyTile tile;
+			tile.raDec = line[backwards ? line.size() - 1 - j : j];
+
+			//Once toward where the tile is now, then again toward where it will be when that slew ends
+			slewPlan slew = mount.planSlew(fromAltAz, altAzAt(tile.raDec, julianDate));
+			tile.slewSeconds = mount.estimateSlewSeconds(fromAltAz, slew);
+			slew = mount.planSlew(fromAltAz, altAzAt(tile.raDec, julianDate + tile.slewSeconds / SECONDS_PER_DAY));
+			tile.slewSeconds = mount.estimateSlewSeconds(fromAltAz, slew);
+			tile.startJd = julianDate + tile.slewSeconds / SECONDS_PER_DAY;
+			tile.endJd = tile.startJd + dwellSeconds / SECONDS_PER_DAY;
+
+			//Tracking keeps the azimuth continuous with the slew, so unwrap the end position against it
+			twoAxisDeg arrivedAltAz;
+			arrivedAltAz.x = slew.altDeg;
+			arrivedAltAz.y = slew.azDeg;
+			slewPlan finish = mount.planSlew(arrivedAltAz, altAzAt(tile.raDec, tile.endJd));
+			fromAltAz.x = finish.altDeg;
+			fromAltAz.y = finish.azDeg;
+
+			if (slew.altClamped || finish.altClamped || !slew.reachable || !finish.reachable)
+			{
+				result.outOfLimits++;
+			}
+			result.totalSlewSeconds += tile.slewSeconds;
+			julianDate = tile.endJd;
+			result.tiles.push_back(tile);
+		}
+	}
+
+	result.totalSeconds = (julianDate - startJd) * SECONDS_PER_DAY;
+	return result;
+}
+
+/**********************************************************************
+* Function:			altAzAt
+* Purpose: 			Projects a tile to Alt / Az at a time
+* Precondition:		Pass in the tile RA / Dec in degrees and a julian date
+* Postcondition:	Returns twoAxisDeg with x = Alt, y = Az (0 - 360) in degrees
+************************************************************************/
+twoAxisDeg surveyPlanner::altAzAt(twoAxisDeg raDec, double julianDate)
+{
+	return coordinate::equatorialToLocal(raDec.x, raDec.y, mount.getLatLongDeg(), julianDate);
+}
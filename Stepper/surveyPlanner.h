@@ -0,0 +1,143 @@
+/*************************************************************
+* Filename:			surveyPlanner.h
+* Purpose:			Cover a rectangle of sky with a mosaic of tiles, visited in one continuous track
+**************************************************************/
+#pragma once
+
+#include <vector>			//std::vector
+#include "coordinate.h"		//twoAxisDeg, equatorialToLocal(), slew model, retarget()
+
+#define SURVEY_MAX_DEC_DEG 85.0				//Regions reaching closer to a pole need more RA tiles than they are worth
+#define SURVEY_MAX_TILES 10000
+#define SURVEY_DEFAULT_OVERLAP 0.1			//Fraction of the field shared with each neighbour
+#define SURVEY_DEFAULT_DWELL_SECONDS 30.0
+#define SURVEY_CORNERS 4					//Start corners tried for each orientation
+
+/************************************************************************
+* Struct: 		surveyRegion
+* Purpose:		Rectangle of sky to cover, square to the RA / Dec grid
+* Data members:	centerRaDec	- x = RA, y = Dec in degrees
+*				widthDeg	- Extent along RA, measured on the sky at the center's Dec
+*				heightDeg	- Extent along Dec
+*************************************************************************/
+typedef struct surveyRegion
+{
+	twoAxisDeg centerRaDec;
+	double widthDeg;
+	double heightDeg;
+} surveyRegion;
+
+/************************************************************************
+* Struct: 		surveyField
+* Purpose:		What each tile of the mosaic sees and how long it stays
+* Data members:	widthDeg		- Field of view along RA, on the sky
+*				heightDeg		- Field of view along Dec
+*				overlap			- Fraction of the field shared with each neighbour, 0 to under 1
+*				dwellSeconds	- Time tracked on each tile once the mount arrives
+*************************************************************************/
+typedef struct surveyField
+{
+	double widthDeg;
+	double heightDeg;
+	double overlap;
+	double dwellSeconds;
+} surveyField;
+
+/************************************************************************
+* Struct: 		surveyTile
+* Purpose:		One tile of a planned survey
+* Data members:	raDec		- x = RA, y = Dec of the tile center in degrees
+*				slewSeconds	- Modeled time to move here from the previous tile
+*				startJd		- Julian date the dwell starts
+*				endJd		- Julian date the dwell ends and the mount moves on
+*************************************************************************/
+typedef struct surveyTile
+{
+	twoAxisDeg raDec;
+	double slewSeconds;
+	double startJd;
+	double endJd;
+} surveyTile;
+
+/************************************************************************
+* Struct: 		surveyPlan
+* Purpose:		Tiles of a survey in the order to visit them
+* Data members:	tiles				- Tile order, empty if the region could not be tiled
+*				lines				- Rows or columns of the mosaic
+*				alongRa				- True if each line runs along RA at one Dec, false if along Dec at one RA
+*				dwellSeconds		- Time on each tile
+*				outOfLimits			- Tiles outside the altitude or cable-wrap limits at their planned time
+*				totalSlewSeconds	- Sum of modeled slews, the first from wherever the mount was
+*				totalSeconds		- From the start of the plan until the last dwell ends
+*				rasterSeconds		- The same region with one goto per tile, every line in the same direction
+*************************************************************************/
+typedef struct surveyPlan
+{
+	std::vector<surveyTile> tiles;
+	int lines;
+	bool alongRa;
+	double dwellSeconds;
+	int outOfLimits;
+	double totalSlewSeconds;
+	double totalSeconds;
+	double rasterSeconds;
+} surveyPlan;
+
+/************************************************************************
+* Class: 		surveyPlanner
+* Purpose:		Tiles a region in rows of constant Dec or columns of constant RA and visits them in a serpentine,
+*				each line run the opposite way to the last so no move crosses the whole region. Every
+*				orientation and start corner is timed with the mount's slew model at the Alt / Az each tile
+*				has when the mount gets there, and the fastest is kept. The survey is run as one track that
+*				is moved to the next tile when each dwell ends, so it never stops and replans from scratch.
+* Data members:	mount		- Calibrated telescope used for coordinates, limits, and for running the survey
+*				running		- Plan being run by update()
+*				tileIndex	- Tile being slewed to or dwelt on
+*				arrived		- True once the mount reached the current tile
+*				dwellEndJd	- When the dwell on the current tile ends
+*				startedJd / finishedJd	- When begin() was called and the last dwell ended
+*				active		- True from begin() until the last dwell ends or tracking is stopped
+*
+* Methods:		plan
+*				planRaster
+*				begin
+*				update
+*				isActive
+*				getTileIndex
+*				getElapsedSeconds
+*				printPlan
+*************************************************************************/
+class surveyPlanner
+{
+	public:
+		surveyPlanner(coordinate &mount);
+
+		//Fastest serpentine over the region, starting at startJd from where the mount points
+		surveyPlan plan(surveyRegion region, surveyField field, double startJd);
+
+		//Rows along RA, all run the same way, what a goto per tile would do
+		surveyPlan planRaster(surveyRegion region, surveyField field, double startJd);
+
+		//Runs a plan on the mount in slices, the same way as beginTrack() / updateTrack()
+		void begin(const surveyPlan &plan);
+		int update(int maxPulses);
+		bool isActive() { return active; }
+		int getTileIndex() { return tileIndex; }
+		double getElapsedSeconds();
+
+		static void printPlan(const surveyPlan &plan);
+
+	private:
+		static std::vector<std::vector<twoAxisDeg>> layoutLines(surveyRegion region, surveyField field, bool alongRa);
+		surveyPlan timeOrder(const std::vector<std::vector<twoAxisDeg>> &lines, bool alongRa, int corner, bool serpentine, double dwellSeconds, double startJd);
+		twoAxisDeg altAzAt(twoAxisDeg raDec, double julianDate);
+
+		coordinate &mount;
+		surveyPlan running;
+		int tileIndex;
+		bool arrived;
+		double dwellEndJd;
+		double startedJd;
+		double finishedJd;
+		bool active;
+};
@@ -0,0 +1,333 @@
+/*************************************************************
+* Filename:			trigCheck.cpp
+* Purpose:			Checks fastTrig against libm and times both
+**************************************************************/
+#include "trigCheck.h"
+#include "fastTrig.h"			//fastTrig
+#include "workPool.h"			//workPool::parallelFor()
+#include "axisKinematics.h"		//azKinematics::stepsPerRev
+#include "sidereal.h"			//DEG_TO_RAD, RAD_TO_DEG
+
+#include <iostream>		//cout, endl
+#include <mutex>		//std::mutex
+#include <vector>		//std::vector
+#include <chrono>		//std::chrono::steady_clock
+
+using std::cout;
+using std::endl;
+
+#define TRIG_CHECK_FLOATS_PER_CHUNK 65536
+#define TRIG_CHECK_REVOLUTIONS 4			//Microstep angles are checked over this many turns each way
+#define TRIG_CHECK_WRAP_LIMIT 1.0e5			//Largest angle wrapTwoPi() is checked on, about 30 years of ERA
+#define TRIG_TIME_VALUES 65536
+#define TRIG_TIME_PASSES 200
+
+/************************************************************************
+* Struct: 		trigError
+* Purpose:		Worst difference from libm found so far
+* Data members:	worst	- Largest absolute difference, radians
+*				at		- Argument it happened at
+*				points	- Arguments tried
+*************************************************************************/
+typedef struct trigError
+{
+	double worst;
+	double at;
+	int64_t points;
+} trigError;
+
+/**********************************************************************
+* Function:			floatBits / bitsFloat
+* Purpose: 			Walk floats in order by stepping through their bit patterns
+* Precondition:		Pass in a float, or the bits of one
+* Postcondition:	Returns the same 32 bits as the other type
+************************************************************************/
+static uint32_t floatBits(float x)
+{
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+	float x;
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+/**********************************************************************
+* Function:			checkRange
+* Purpose: 			Runs one comparison over a range of arguments on every core
+* Precondition:		Pass in how many arguments, the pool, and error(i, argument) returning the difference from
+*					libm for the i-th argument and setting the argument it used, or the argument of its worst
+*					difference if it tries several
+* Postcondition:	Returns the worst difference and where it happened
+************************************************************************/
+template <typename Check>
+static trigError checkRange(int64_t count, workPool *pool, Check error)
+{
+	trigError total = { 0, 0, count };
+	std::mutex lock;
+
+	pool->parallelFor(count, TRIG_CHECK_FLOATS_PER_CHUNK, [&](int64_t begin, int64_t end)
+	{
+		trigError chunk = { 0, 0, 0 };
+		for (int64_t i = begin; i < end; i++)
+		{
+			//Checks that only set the argument along with a new worst difference leave it at 0 otherwise
+			double argument = 0;
+			double difference = error(i, argument);
+			//Written so a NaN difference counts as the worst
+			if (!(difference <= chunk.worst))
+			{
+				chunk.worst = difference;
+				chunk.at = argument;
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (!(chunk.worst <= total.worst))
+		{
+			total.worst = chunk.worst;
+			total.at = chunk.at;
+		}
+	});
+
+	return total;
+}
+
+/**********************************************************************
+* Function:			printError
+* Purpose: 			Prints one line of the check
+* Precondition:		Pass in the name of what was checked and its result
+* Postcondition:	Prints the worst difference in radians, arcseconds and microsteps
+************************************************************************/
+static void printError(const char *name, trigError error)
+{
+	double stepsPerRad = azKinematics::stepsPerRev / (2.0 * M_PI);
+	cout << name << ": " << error.points << " arguments, worst " << error.worst << " rad ("
+		<< error.worst * RAD_TO_DEG * 3600.0 << " arcsec, " << error.worst * stepsPerRad << " microsteps) at "
+		<< error.at << endl;
+}
+
+/**********************************************************************
+* Function:			altAzLibm / altAzFast
+* Purpose: 			The conversion in coordinate::equatorialToLocal() from the hour angle on, with each library
+* Precondition:		Pass in the latitude, declination and hour angle in radians
+* Postcondition:	alt and az hold the result in radians
+************************************************************************/
+static void altAzLibm(double latitude, double declination, double hourAngle, double &alt, double &az)
+{
+	double horizonY = ::sin(hourAngle) * ::cos(declination);
+	double horizonX = ::cos(hourAngle) * ::sin(latitude) * ::cos(declination) - ::sin(declination) * ::cos(latitude);
+	double height = ::sin(latitude) * ::sin(declination) + ::cos(latitude) * ::cos(declination) * ::cos(hourAngle);
+	az = ::atan2(horizonY, horizonX);
+	alt = ::atan2(height, sqrt(horizonY * horizonY + horizonX * horizonX));
+}
+
+static void altAzFast(double latitude, double declination, double hourAngle, double &alt, double &az)
+{
+	double sinLat, cosLat, sinDec, cosDec, sinHa, cosHa;
+	fastTrig::sinCos(latitude, sinLat, cosLat);
+	fastTrig::sinCos(declination, sinDec, cosDec);
+	fastTrig::sinCos(hourAngle, sinHa, cosHa);
+	double horizonY = sinHa * cosDec;
+	double horizonX = cosHa * sinLat * cosDec - sinDec * cosLat;
+	double height = sinLat * sinDec + cosLat * cosDec * cosHa;
+	az = fastTrig::atan2(horizonY, horizonX);
+	alt = fastTrig::atan2(height, sqrt(horizonY * horizonY + horizonX * horizonX));
+}
+
+/**********************************************************************
+* Function:			timeLoop
+* Purpose: 			Nanoseconds per value of a loop over many arguments
+* Precondition:		Pass in the loop body, run once over TRIG_TIME_VALUES values per call
+* Postcondition:	Returns the average time per value over TRIG_TIME_PASSES passes
+************************************************************************/
+template <typename Loop>
+static double timeLoop(Loop loop)
+{
+	loop();
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < TRIG_TIME_PASSES; pass++)
+	{
+		loop();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return seconds / ((double)TRIG_TIME_PASSES * TRIG_TIME_VALUES) * 1e9;
+}
+
+/**********************************************************************
+* Function:			run
+* Purpose: 			Compares every fastTrig function with libm and times them
+* Precondition:		Pass in the stride through each range of floats, 1 tries every float
+* Postcondition:	Prints the worst difference of each function, first over floats then over every microstep
+*					angle of the drivetrain, then the whole Alt / Az conversion, then the time per value
+************************************************************************/
+void trigCheck::run(int64_t stride)
+{
+	workPool *pool = workPool::instance();
+	double radPerStep = 2.0 * M_PI / azKinematics::stepsPerRev;
+	int64_t steps = TRIG_CHECK_REVOLUTIONS * azKinematics::stepsPerRev;
+	stride = (stride > 0) ? stride : 1;
+	cout << "Checking against libm, every " << stride << " floats, on " << pool->getThreadCount() << " threads" << endl;
+
+	//sin / cos of every float over the same turns
+	uint32_t sinLimit = floatBits((float)(TRIG_CHECK_REVOLUTIONS * 2.0 * M_PI));
+	printError("sin / cos", checkRange(sinLimit / stride + 1, pool, [&](int64_t i, double &x)
+	{
+		x = bitsFloat((uint32_t)(i * stride));
+		double sinX, cosX, sinNegative, cosNegative;
+		fastTrig::sinCos(x, sinX, cosX);
+		fastTrig::sinCos(-x, sinNegative, cosNegative);
+		return fmax(fmax(fabs(sinX - ::sin(x)), fabs(cosX - ::cos(x))),
+			fmax(fabs(sinNegative - ::sin(-x)), fabs(cosNegative - ::cos(-x))));
+	}));
+	printError("sin / cos, microsteps", checkRange(2 * steps + 1, pool, [&](int64_t i, double &x)
+	{
+		x = (i - steps) * radPerStep;
+		double sinX, cosX;
+		fastTrig::sinCos(x, sinX, cosX);
+		return fmax(fabs(sinX - ::sin(x)), fabs(cosX - ::cos(x)));
+	}));
+
+	//atan2 of every tangent in [0, 1] in each of the 8 octants
+	uint32_t oneBits = floatBits(1.0f);
+	printError("atan2", checkRange(oneBits / stride + 1, pool, [&](int64_t i, double &t)
+	{
+		t = bitsFloat((uint32_t)(i * stride));
+		double worst = 0;
+		for (int octant = 0; octant < 8; octant++)
+		{
+			double y = (octant & 1) ? -t : t;
+			double x = (octant & 2) ? -1.0 : 1.0;
+			if (octant & 4)
+			{
+				double swap = y;
+				y = x;
+				x = swap;
+			}
+			worst = fmax(worst, fabs(fastTrig::atan2(y, x) - ::atan2(y, x)));
+		}
+		return worst;
+	}));
+	printError("atan2, microsteps", checkRange(azKinematics::stepsPerRev, pool, [&](int64_t i, double &x)
+	{
+		x = i * radPerStep;
+		double y = ::sin(x);
+		double c = ::cos(x);
+		return fabs(fastTrig::atan2(y, c) - ::atan2(y, c));
+	}));
+
+	//asin of every float in [-1, 1]
+	printError("asin", checkRange(oneBits / stride + 1, pool, [&](int64_t i, double &x)
+	{
+		x = bitsFloat((uint32_t)(i * stride));
+		return fmax(fabs(fastTrig::asin(x) - ::asin(x)), fabs(fastTrig::asin(-x) - ::asin(-x)));
+	}));
+
+	//wrapTwoPi of every float up to the limit, against fmod(), which is exact
+	uint32_t wrapLimit = floatBits((float)TRIG_CHECK_WRAP_LIMIT);
+	printError("wrapTwoPi", checkRange(wrapLimit / stride + 1, pool, [&](int64_t i, double &x)
+	{
+		x = bitsFloat((uint32_t)(i * stride));
+		double worst = 0;
+		for (int sign = -1; sign <= 1; sign += 2)
+		{
+			double exact = fmod(sign * x, 2.0 * M_PI);
+			exact = (exact < 0) ? exact + 2.0 * M_PI : exact;
+			double difference = fabs(fastTrig::wrapTwoPi(sign * x) - exact);
+			worst = fmax(worst, fmin(difference, 2.0 * M_PI - difference));
+		}
+		return worst;
+	}));
+
+	//The whole Alt / Az conversion over the sky, in microsteps of each axis
+	int latitudes = 35;
+	int declinations = 179;
+	int hourAngles = 3600;
+	trigError altError = checkRange((int64_t)latitudes * declinations, pool, [&](int64_t i, double &at)
+	{
+		double latitude = (-85.0 + 5.0 * (i / declinations)) * DEG_TO_RAD;
+		double declination = (-89.0 + (i % declinations)) * DEG_TO_RAD;
+		double worst = 0;
+		for (int h = 0; h < hourAngles; h++)
+		{
+			double hourAngle = (-180.0 + h * 0.1) * DEG_TO_RAD;
+			double alt, az, altExact, azExact;
+			altAzFast(latitude, declination, hourAngle, alt, az);
+			altAzLibm(latitude, declination, hourAngle, altExact, azExact);
+			if (fabs(alt - altExact) > worst)
+			{
+				worst = fabs(alt - altExact);
+				at = altExact / DEG_TO_RAD;
+			}
+		}
+		return worst;
+	});
+	altError.points *= hourAngles;
+	printError("Alt from RA / Dec, at Alt in degrees", altError);
+	trigError azError = checkRange((int64_t)latitudes * declinations, pool, [&](int64_t i, double &at)
+	{
+		double latitude = (-85.0 + 5.0 * (i / declinations)) * DEG_TO_RAD;
+		double declination = (-89.0 + (i % declinations)) * DEG_TO_RAD;
+		double worst = 0;
+		for (int h = 0; h < hourAngles; h++)
+		{
+			double hourAngle = (-180.0 + h * 0.1) * DEG_TO_RAD;
+			double alt, az, altExact, azExact;
+			altAzFast(latitude, declination, hourAngle, alt, az);
+			altAzLibm(latitude, declination, hourAngle, altExact, azExact);
+			double difference = fabs(az - azExact);
+			difference = fmin(difference, 2.0 * M_PI - difference);
+			if (difference > worst)
+			{
+				worst = difference;
+				at = altExact / DEG_TO_RAD;
+			}
+		}
+		return worst;
+	});
+	azError.points *= hourAngles;
+	printError("Az from RA / Dec, at Alt in degrees", azError);
+
+	//Time per value, loops the compiler is free to vectorize
+	std::vector<double> input(TRIG_TIME_VALUES);
+	std::vector<double> ratio(TRIG_TIME_VALUES);
+	std::vector<double> first(TRIG_TIME_VALUES);
+	std::vector<double> second(TRIG_TIME_VALUES);
+	for (int i = 0; i < TRIG_TIME_VALUES; i++)
+	{
+		input[i] = (i - TRIG_TIME_VALUES / 2) * (4.0 * M_PI / TRIG_TIME_VALUES);
+		ratio[i] = (i - TRIG_TIME_VALUES / 2) * (2.0 / TRIG_TIME_VALUES);
+	}
+	double *in = input.data();
+	double *r = ratio.data();
+	double *a = first.data();
+	double *b = second.data();
+	int n = TRIG_TIME_VALUES;
+
+	double libmSinCos = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = ::sin(in[i]); b[i] = ::cos(in[i]); } });
+	double fastSinCos = timeLoop([&]() { for (int i = 0; i < n; i++) { fastTrig::sinCos(in[i], a[i], b[i]); } });
+	double libmAtan2 = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = ::atan2(r[i], in[i]); } });
+	double fastAtan2 = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = fastTrig::atan2(r[i], in[i]); } });
+	double libmAsin = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = ::asin(r[i]); } });
+	double fastAsin = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = fastTrig::asin(r[i]); } });
+	double libmWrap = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = fmod(in[i] * 1000.0, 2.0 * M_PI); } });
+	double fastWrap = timeLoop([&]() { for (int i = 0; i < n; i++) { a[i] = fastTrig::wrapTwoPi(in[i] * 1000.0); } });
+	double libmAltAz = timeLoop([&]() { for (int i = 0; i < n; i++) { altAzLibm(0.737, r[i], in[i], a[i], b[i]); } });
+	double fastAltAz = timeLoop([&]() { for (int i = 0; i < n; i++) { altAzFast(0.737, r[i], in[i], a[i], b[i]); } });
+
+	cout << "ns per value, libm / fast:" << endl;
+	cout << "sin + cos: " << libmSinCos << " / " << fastSinCos << endl;
+	cout << "atan2: " << libmAtan2 << " / " << fastAtan2 << endl;
+	cout << "asin: " << libmAsin << " / " << fastAsin << endl;
+	cout << "wrapTwoPi: " << libmWrap << " / " << fastWrap << endl;
+	cout << "Alt / Az: " << libmAltAz << " / " << fastAltAz << endl;
+#ifdef USE_FAST_TRIG
+	cout << "Built with USE_FAST_TRIG, tracking uses the fast functions" << endl;
+#else
+	cout << "Built without USE_FAST_TRIG, tracking uses libm" << endl;
+#endif
+}
@@ -0,0 +1,24 @@
+/*************************************************************
+* Filename:			trigCheck.h
+* Purpose:			Checks fastTrig against libm and times both
+**************************************************************/
+#pragma once
+
+#include <stdint.h>		//int64_t
+
+#define TRIG_CHECK_DEFAULT_STRIDE 64		//--check-trig tries every 64th float unless told otherwise
+
+/************************************************************************
+* Class: 		trigCheck
+* Purpose:		The error bounds quoted in fastTrig.h, measured against libm on every core, and the time
+*				each function takes in a loop the compiler is free to vectorize
+* Data members:	none
+*
+* Methods:		run
+*************************************************************************/
+class trigCheck
+{
+	public:
+		//Compares every function with libm, stride 1 tries every float in each range
+		static void run(int64_t stride);
+};
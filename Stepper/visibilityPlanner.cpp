@@ -0,0 +1,362 @@
+/*************************************************************
+* Filename:			visibilityPlanner.cpp
+* Purpose:			Altitude curves and rise / transit / set / twilight times for a whole observing list
+**************************************************************/
+#include "visibilityPlanner.h"
+#include "sidereal.h"		//getGMSTinRads(), getLMST(), DEG_TO_RAD, SECONDS_PER_DAY
+#include <math.h>			//sin(), cos(), asin(), atan2()
+
+/**********************************************************************
+* Function:			refineCrossing
+* Purpose: 			Finds where a function of time crosses zero
+* Precondition:		Pass in the function and two julian dates where it has opposite signs
+* Postcondition:	Returns the crossing, found with the Illinois variant of false position. It converges
+*					about as fast as the secant method but keeps the root bracketed like bisection.
+************************************************************************/
+template <class Function>
+static double refineCrossing(Function f, double lowJd, double highJd)
+{
+	double fLow = f(lowJd);
+	double fHigh = f(highJd);
+	double tolerance = PLAN_EVENT_TOLERANCE_SECONDS / SECONDS_PER_DAY;
+	double guess = lowJd;
+	int side = 0;
+
+	for (int i = 0; i < PLAN_MAX_REFINE_ITERATIONS && highJd - lowJd > tolerance; i++)
+	{
+		guess = (lowJd * fHigh - highJd * fLow) / (fHigh - fLow);
+		double fGuess = f(guess);
+
+		if (fGuess == 0)
+		{
+			return guess;
+		}
+
+		//Halve the end that stays put twice in a row so it cannot stall
+		if ((fGuess > 0) == (fHigh > 0))
+		{
+			highJd = guess;
+			fHigh = fGuess;
+			if (side == -1)
+			{
+				fLow /= 2;
+			}
+			side = -1;
+		}
+		else
+		{
+			lowJd = guess;
+			fLow = fGuess;
+			if (side == 1)
+			{
+				fHigh /= 2;
+			}
+			side = 1;
+		}
+	}
+
+	return (lowJd * fHigh - highJd * fLow) / (fHigh - fLow);
+}
+
+/**********************************************************************
+* Function:			visibilityPlanner (constructor)
+* Purpose: 			Works out everything that is shared by every target of the window
+* Precondition:		Pass in the site, x = latitude, y = longitude (east positive) in degrees, the window, the
+*					altitude limit in degrees, and the pool to run on, or nullptr to run on the calling thread
+* Postcondition:	Sidereal time and the sun's altitude are known at every sample of the window
+************************************************************************/
+visibilityPlanner::visibilityPlanner(twoAxisDeg latLong, double startJd, double endJd, double horizonDeg, workPool *pool)
+	: latLong(latLong), startJd(startJd), endJd(endJd), horizonDeg(horizonDeg), pool(pool)
+{
+	sinLat = sin(latLong.x * DEG_TO_RAD);
+	cosLat = cos(latLong.x * DEG_TO_RAD);
+
+	//Evenly spaced, with the last sample exactly on the end of the window
+	int intervals = (int)ceil((endJd - startJd) * SECONDS_PER_DAY / PLAN_STEP_SECONDS);
+	if (intervals < 1)
+	{
+		intervals = 1;
+	}
+
+	double sinDark = sin(ASTRONOMICAL_TWILIGHT_ALT_DEG * DEG_TO_RAD);
+	for (int i = 0; i <= intervals; i++)
+	{
+		double julianDate = startJd + (endJd - startJd) * i / intervals;
+		double lmst = lmstRads(julianDate);
+
+		sampleJd.push_back(julianDate);
+		sinLmst.push_back(sin(lmst));
+		cosLmst.push_back(cos(lmst));
+		sunSinAlt.push_back(sunSinAltitude(julianDate));
+		sunDark.push_back(sunSinAlt.back() < sinDark);
+	}
+}
+
+/**********************************************************************
+* Function:			solve
+* Purpose: 			Finds the events of every target
+* Precondition:		Pass in RA / Dec in degrees of each target, and optionally a vector for the altitude curves
+* Postcondition:	Returns one targetEvents per target in the same order. Each curve holds the altitude in
+*					degrees at every sample of getSampleJd().
+************************************************************************/
+std::vector<targetEvents> visibilityPlanner::solve(const std::vector<twoAxisDeg> &raDec, std::vector<float> *curves)
+{
+	std::vector<targetEvents> events(raDec.size());
+	size_t samples = sampleJd.size();
+	if (curves)
+	{
+		curves->assign(raDec.size() * samples, 0.0f);
+	}
+
+	auto body = [&](int64_t begin, int64_t end)
+	{
+		for (int64_t i = begin; i < end; i++)
+		{
+			solveTarget(raDec[i], events[i], curves ? curves->data() + i * samples : nullptr);
+		}
+	};
+
+	if (pool)
+	{
+		pool->parallelFor((int64_t)raDec.size(), PLAN_TARGETS_PER_CHUNK, body);
+	}
+	else
+	{
+		body(0, (int64_t)raDec.size());
+	}
+
+	return events;
+}
+
+/**********************************************************************
+* Function:			getNightEvents
+* Purpose: 			Finds sunset, sunrise, and each twilight inside the window
+* Precondition:		None
+* Postcondition:	Returns the first evening and morning crossing of each sun altitude, refined like a target's
+************************************************************************/
+nightEvents visibilityPlanner::getNightEvents()
+{
+	const double altitudes[4] = { SUNSET_ALT_DEG, CIVIL_TWILIGHT_ALT_DEG, NAUTICAL_TWILIGHT_ALT_DEG, ASTRONOMICAL_TWILIGHT_ALT_DEG };
+	double dusk[4];
+	double dawn[4];
+
+	for (int event = 0; event < 4; event++)
+	{
+		double sinEvent = sin(altitudes[event] * DEG_TO_RAD);
+		auto above = [this, sinEvent](double julianDate) { return sunSinAltitude(julianDate) - sinEvent; };
+
+		dusk[event] = NO_EVENT;
+		dawn[event] = NO_EVENT;
+		for (int i = 1; i < (int)sampleJd.size(); i++)
+		{
+			bool wasUp = sunSinAlt[i - 1] >= sinEvent;
+			bool isUp = sunSinAlt[i] >= sinEvent;
+
+			if (wasUp && !isUp && dusk[event] == NO_EVENT)
+			{
+				dusk[event] = refineCrossing(above, sampleJd[i - 1], sampleJd[i]);
+			}
+			if (!wasUp && isUp && dawn[event] == NO_EVENT)
+			{
+				dawn[event] = refineCrossing(above, sampleJd[i - 1], sampleJd[i]);
+			}
+		}
+	}
+
+	nightEvents night;
+	night.sunsetJd = dusk[0];
+	night.civilDuskJd = dusk[1];
+	night.nauticalDuskJd = dusk[2];
+	night.astronomicalDuskJd = dusk[3];
+	night.astronomicalDawnJd = dawn[3];
+	night.nauticalDawnJd = dawn[2];
+	night.civilDawnJd = dawn[1];
+	night.sunriseJd = dawn[0];
+
+	return night;
+}
+
+/**********************************************************************
+* Function:			getSampleJd
+* Purpose: 			Returns the times the altitude curves are sampled at
+* Precondition:		None
+* Postcondition:	Returns julian dates, sample j of every curve from solve() is at getSampleJd()[j]
+************************************************************************/
+const std::vector<double> &visibilityPlanner::getSampleJd()
+{
+	return sampleJd;
+}
+
+/**********************************************************************
+* Function:			altitudeDeg
+* Purpose: 			Altitude of one target at one time with the scalar conversion
+* Precondition:		Pass in RA / Dec in degrees and a julian date
+* Postcondition:	Returns degrees, exactly what equatorialToLocal gives
+************************************************************************/
+double visibilityPlanner::altitudeDeg(twoAxisDeg raDec, double julianDate)
+{
+	return coordinate::equatorialToLocal(raDec.x, raDec.y, latLong, julianDate).x;
+}
+
+/**********************************************************************
+* Function:			sunRaDec
+* Purpose: 			Low precision position of the sun
+* Precondition:		Pass in a julian date
+* Postcondition:	Returns x = RA, y = Dec in degrees, good to about 0.01 degrees between 1950 and 2050, or
+*					well under a minute of twilight time
+* Sources:			Astronomical Almanac, "Low precision formulas for the Sun"
+************************************************************************/
+twoAxisDeg visibilityPlanner::sunRaDec(double julianDate)
+{
+	double n = julianDate - 2451545.0;
+	double meanLongitude = fmod(280.460 + 0.9856474 * n, 360.0);
+	double meanAnomaly = fmod(357.528 + 0.9856003 * n, 360.0) * DEG_TO_RAD;
+	double eclipticLongitude = (meanLongitude + 1.915 * sin(meanAnomaly) + 0.020 * sin(2 * meanAnomaly)) * DEG_TO_RAD;
+	double obliquity = (23.439 - 0.0000004 * n) * DEG_TO_RAD;
+
+	twoAxisDeg raDec;
+	raDec.x = atan2(cos(obliquity) * sin(eclipticLongitude), cos(eclipticLongitude)) * RAD_TO_DEG;
+	if (raDec.x < 0)
+	{
+		raDec.x += 360.0;
+	}
+	raDec.y = asin(sin(obliquity) * sin(eclipticLongitude)) * RAD_TO_DEG;
+
+	return raDec;
+}
+
+/**********************************************************************
+* Function:			solveTarget
+* Purpose: 			Walks one target's curve and refines every crossing it brackets
+* Precondition:		Pass in RA / Dec in degrees, the events to fill, and where to write the curve or nullptr
+* Postcondition:	events is filled
+************************************************************************/
+void visibilityPlanner::solveTarget(twoAxisDeg raDec, targetEvents &events, float *curve)
+{
+	double ra = raDec.x * DEG_TO_RAD;
+	double sinDec = sin(raDec.y * DEG_TO_RAD);
+	double cosDec = cos(raDec.y * DEG_TO_RAD);
+	double sinRa = sin(ra);
+	double cosRa = cos(ra);
+	double sinHorizon = sin(horizonDeg * DEG_TO_RAD);
+
+	auto above = [this, sinDec, cosDec, ra, sinHorizon](double julianDate) { return sinAltitude(sinDec, cosDec, ra, julianDate) - sinHorizon; };
+	auto hourAngle = [this, ra](double julianDate) { return sinHourAngle(ra, julianDate); };
+
+	events.riseJd = NO_EVENT;
+	events.setJd = NO_EVENT;
+	events.transitJd = NO_EVENT;
+	events.transitAltDeg = 0;
+	events.darkHours = 0;
+
+	double maxSinAlt = -1;
+	double lastSinAlt = 0;
+	double lastSinHour = 0;
+	double lastCosHour = 0;
+	int upSamples = 0;
+	int darkSamples = 0;
+
+	for (int i = 0; i < (int)sampleJd.size(); i++)
+	{
+		//cos / sin of LMST - RA from the shared sidereal samples
+		double cosHour = cosLmst[i] * cosRa + sinLmst[i] * sinRa;
+		double sinHour = sinLmst[i] * cosRa - cosLmst[i] * sinRa;
+		double sinAlt = sinLat * sinDec + cosLat * cosDec * cosHour;
+
+		if (curve)
+		{
+			curve[i] = (float)(asin(sinAlt) * RAD_TO_DEG);
+		}
+		if (sinAlt > maxSinAlt)
+		{
+			maxSinAlt = sinAlt;
+		}
+		if (sinAlt >= sinHorizon)
+		{
+			upSamples++;
+			if (sunDark[i])
+			{
+				darkSamples++;
+			}
+		}
+
+		if (i > 0)
+		{
+			if (lastSinAlt < sinHorizon && sinAlt >= sinHorizon && events.riseJd == NO_EVENT)
+			{
+				events.riseJd = refineCrossing(above, sampleJd[i - 1], sampleJd[i]);
+			}
+			if (lastSinAlt >= sinHorizon && sinAlt < sinHorizon && events.setJd == NO_EVENT)
+			{
+				events.setJd = refineCrossing(above, sampleJd[i - 1], sampleJd[i]);
+			}
+
+			//Upper transit, the hour angle goes through 0 rather than 180
+			if (lastSinHour < 0 && sinHour >= 0 && lastCosHour > 0 && cosHour > 0 && events.transitJd == NO_EVENT)
+			{
+				events.transitJd = refineCrossing(hourAngle, sampleJd[i - 1], sampleJd[i]);
+				events.transitAltDeg = altitudeDeg(raDec, events.transitJd);
+			}
+		}
+
+		lastSinAlt = sinAlt;
+		lastSinHour = sinHour;
+		lastCosHour = cosHour;
+	}
+
+	events.maxAltDeg = asin(maxSinAlt) * RAD_TO_DEG;
+	if (events.transitJd != NO_EVENT && events.transitAltDeg > events.maxAltDeg)
+	{
+		events.maxAltDeg = events.transitAltDeg;
+	}
+	events.alwaysUp = (upSamples == (int)sampleJd.size());
+	events.neverUp = (upSamples == 0);
+
+	//To the resolution of the samples
+	events.darkHours = darkSamples * (endJd - startJd) * 24.0 / (sampleJd.size() - 1);
+}
+
+/**********************************************************************
+* Function:			sinAltitude
+* Purpose: 			sin() of a target's altitude at an exact time
+* Precondition:		Pass in sin / cos of Dec, RA in radians and a julian date
+* Postcondition:	Same sidereal time and formula as equatorialToLocal
+************************************************************************/
+double visibilityPlanner::sinAltitude(double sinDec, double cosDec, double raRads, double julianDate)
+{
+	return sinLat * sinDec + cosLat * cosDec * cos(lmstRads(julianDate) - raRads);
+}
+
+/**********************************************************************
+* Function:			sinHourAngle
+* Purpose: 			sin() of a target's hour angle, its sign tells if the target is east or west of the meridian
+* Precondition:		Pass in RA in radians and a julian date
+* Postcondition:	Returns a value from -1 to 1, negative before transit
+************************************************************************/
+double visibilityPlanner::sinHourAngle(double raRads, double julianDate)
+{
+	return sin(lmstRads(julianDate) - raRads);
+}
+
+/**********************************************************************
+* Function:			sunSinAltitude
+* Purpose: 			sin() of the Sun's altitude, used for twilight
+* Precondition:		Pass in a julian date
+* Postcondition:	Returns a value from -1 to 1
+************************************************************************/
+double visibilityPlanner::sunSinAltitude(double julianDate)
+{
+	twoAxisDeg sun = sunRaDec(julianDate);
+	return sinAltitude(sin(sun.y * DEG_TO_RAD), cos(sun.y * DEG_TO_RAD), sun.x * DEG_TO_RAD, julianDate);
+}
+
+/**********************************************************************
+* Function:			lmstRads
+* Purpose: 			Local sidereal time at the site
+* Precondition:		Pass in a julian date
+* Postcondition:	Returns radians
+************************************************************************/
+double visibilityPlanner::lmstRads(double julianDate)
+{
+	return sidereal::getLMST(sidereal::getGMSTinRads(julianDate), latLong.y) * DEG_TO_RAD;
+}
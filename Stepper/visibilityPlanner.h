@@ -0,0 +1,119 @@
+/*************************************************************
+* Filename:			visibilityPlanner.h
+* Purpose:			Altitude curves and rise / transit / set / twilight times for a whole observing list
+**************************************************************/
+#pragma once
+
+#include <vector>			//std::vector
+#include "coordinate.h"		//twoAxisDeg, equatorialToLocal()
+#include "workPool.h"		//workPool
+
+#define PLAN_STEP_SECONDS 300.0				//Spacing of the altitude curves, events are bracketed between samples
+#define PLAN_EVENT_TOLERANCE_SECONDS 0.1	//Events are refined until bracketed this closely
+#define PLAN_MAX_REFINE_ITERATIONS 60
+#define PLAN_TARGETS_PER_CHUNK 64			//Targets per job handed to the work pool
+
+//Sun altitudes of each event, sunrise / sunset is the upper limb with standard refraction
+#define SUNSET_ALT_DEG -0.833
+#define CIVIL_TWILIGHT_ALT_DEG -6.0
+#define NAUTICAL_TWILIGHT_ALT_DEG -12.0
+#define ASTRONOMICAL_TWILIGHT_ALT_DEG -18.0
+
+//Julian date of an event that does not happen inside the planned window
+#define NO_EVENT 0.0
+
+/************************************************************************
+* Struct: 		targetEvents
+* Purpose:		When one target can be seen during the planned window
+* Data members:	riseJd / setJd		- First time it crosses the horizon going up / down, NO_EVENT if it does not
+*				transitJd			- First meridian crossing above the pole, NO_EVENT if none in the window
+*				transitAltDeg		- Altitude at transitJd
+*				maxAltDeg			- Highest altitude inside the window
+*				darkHours			- Hours it is above the horizon while the sky is astronomically dark
+*				alwaysUp / neverUp	- True if it stays above / below the horizon the whole window
+*************************************************************************/
+typedef struct targetEvents
+{
+	double riseJd;
+	double setJd;
+	double transitJd;
+	double transitAltDeg;
+	double maxAltDeg;
+	double darkHours;
+	bool alwaysUp;
+	bool neverUp;
+} targetEvents;
+
+/************************************************************************
+* Struct: 		nightEvents
+* Purpose:		Sun events inside the planned window, each NO_EVENT if it does not happen
+* Data members:	sunsetJd, civilDuskJd, nauticalDuskJd, astronomicalDuskJd		- Evening, sun going down
+*				astronomicalDawnJd, nauticalDawnJd, civilDawnJd, sunriseJd	- Morning, sun coming up
+*************************************************************************/
+typedef struct nightEvents
+{
+	double sunsetJd;
+	double civilDuskJd;
+	double nauticalDuskJd;
+	double astronomicalDuskJd;
+	double astronomicalDawnJd;
+	double nauticalDawnJd;
+	double civilDawnJd;
+	double sunriseJd;
+} nightEvents;
+
+/************************************************************************
+* Class: 		visibilityPlanner
+* Purpose:		Solves a whole target list over one window. Sidereal time is the same for every target, so
+*				its sine and cosine are worked out once per sample of the window, and each target's curve is
+*				then only multiplies and adds: sin(alt) = sin(lat)sin(dec) + cos(lat)cos(dec)cos(LMST - RA).
+*				Horizon and meridian crossings are bracketed between samples, then refined with the full
+*				equatorialToLocal math at the exact time. Targets are split over a work pool.
+* Data members:	latLong				- Site, x = latitude, y = longitude (east positive) in degrees
+*				startJd / endJd		- Planned window
+*				horizonDeg			- Altitude a target has to be above to count as up
+*				pool				- Threads the targets are spread over
+*				sampleJd			- Time of each sample
+*				sinLmst / cosLmst	- Local sidereal time at each sample
+*				sunDark				- True at samples where the sun is below astronomical twilight
+*				sunSinAlt			- sin() of the sun's altitude at each sample
+*
+* Methods:		solve
+*				getNightEvents
+*				getSampleJd
+*				altitudeDeg
+*				sunRaDec
+*************************************************************************/
+class visibilityPlanner
+{
+	public:
+		visibilityPlanner(twoAxisDeg latLong, double startJd, double endJd, double horizonDeg, workPool *pool = workPool::instance());
+
+		//Events for every target, and if curves is not null, the altitude of target i at sample j in curves[i * samples + j]
+		std::vector<targetEvents> solve(const std::vector<twoAxisDeg> &raDec, std::vector<float> *curves = nullptr);
+		nightEvents getNightEvents();
+		const std::vector<double> &getSampleJd();
+
+		double altitudeDeg(twoAxisDeg raDec, double julianDate);
+		static twoAxisDeg sunRaDec(double julianDate);
+
+	private:
+		void solveTarget(twoAxisDeg raDec, targetEvents &events, float *curve);
+		double sinAltitude(double sinDec, double cosDec, double raRads, double julianDate);
+		double sinHourAngle(double raRads, double julianDate);
+		double sunSinAltitude(double julianDate);
+		double lmstRads(double julianDate);
+
+		twoAxisDeg latLong;
+		double startJd;
+		double endJd;
+		double horizonDeg;
+		double sinLat;
+		double cosLat;
+		workPool *pool;
+		std::vector<double> sampleJd;
+		std::vector<double> sinLmst;
+		std::vector<double> cosLmst;
+		std::vector<double> sunSinAlt;
+		std::vector<bool> sunDark;
+};
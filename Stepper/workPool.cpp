@@ -0,0 +1,203 @@
+/*************************************************************
+* Filename:			workPool.cpp
+* Purpose:			Spread a loop over every core with a work-stealing thread pool
+**************************************************************/
+#include "workPool.h"
+
+/**********************************************************************
+* Function:			workPool (constructor)
+* Purpose: 			Starts the worker threads
+* Precondition:		Pass in how many workers to start, 0 for one less than the number of cores
+* Postcondition:	Workers are sleeping until jobs are queued
+************************************************************************/
+workPool::workPool(unsigned threadCount)
+{
+	if (threadCount == 0)
+	{
+		unsigned cores = std::thread::hardware_concurrency();
+		threadCount = (cores > 1) ? cores - 1 : 1;
+	}
+
+	queued = 0;
+	stopping = false;
+
+	for (unsigned i = 0; i <= threadCount; i++)
+	{
+		queues.push_back(std::unique_ptr<workQueue>(new workQueue()));
+	}
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		threads.push_back(std::thread(&workPool::workerLoop, this, i));
+	}
+}
+
+/**********************************************************************
+* Function:			~workPool (destructor)
+* Purpose: 			Stops the worker threads
+* Precondition:		No parallelFor() may be running
+* Postcondition:	Every worker has been joined
+************************************************************************/
+workPool::~workPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (int i = 0; i < (int)threads.size(); i++)
+	{
+		threads[i].join();
+	}
+}
+
+/**********************************************************************
+* Function:			instance
+* Purpose: 			Shared pool for the whole program
+* Precondition:		None
+* Postcondition:	Returns the pool, started with one worker per spare core on first use
+************************************************************************/
+workPool *workPool::instance()
+{
+	static workPool pool;
+	return &pool;
+}
+
+/**********************************************************************
+* Function:			parallelFor
+* Purpose: 			Runs a loop body over a range on every thread of the pool
+* Precondition:		Pass in the range size, the chunk size, and the body. Chunks run in any order and on any
+*					thread, so the body may only write to what belongs to its own range.
+* Postcondition:	Returns once body has been called for every chunk
+************************************************************************/
+void workPool::parallelFor(int64_t count, int64_t grain, const std::function<void(int64_t begin, int64_t end)> &body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (grain < 1)
+	{
+		grain = 1;
+	}
+
+	int64_t chunks = (count + grain - 1) / grain;
+	std::atomic<int64_t> remaining(chunks);
+
+	//Counted before any are queued so a worker never takes one the count does not include yet
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		queued += chunks;
+	}
+
+	//Deal whole runs of chunks to each queue so neighbouring chunks start on the same thread
+	unsigned queueCount = (unsigned)queues.size();
+	for (int64_t chunk = 0; chunk < chunks; chunk++)
+	{
+		int64_t begin = chunk * grain;
+		int64_t end = (begin + grain < count) ? begin + grain : count;
+		unsigned owner = (unsigned)(chunk * queueCount / chunks);
+
+		std::lock_guard<std::mutex> guard(queues[owner]->lock);
+		queues[owner]->jobs.push_front([this, &body, &remaining, begin, end]()
+		{
+			body(begin, end);
+			if (remaining.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> guard(sleepLock);
+				finished.notify_all();
+			}
+		});
+	}
+
+	wake.notify_all();
+
+	//Work on the caller's own queue and steal until nothing is left, then wait for chunks still running
+	unsigned callerIndex = queueCount - 1;
+	while (remaining > 0)
+	{
+		if (!runOne(callerIndex))
+		{
+			std::unique_lock<std::mutex> lock(sleepLock);
+			finished.wait(lock, [&remaining]() { return remaining == 0; });
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			getThreadCount
+* Purpose: 			Returns how many threads parallelFor() runs on
+* Precondition:		None
+* Postcondition:	Returns the workers plus one, the caller works its own queue too
+************************************************************************/
+unsigned workPool::getThreadCount()
+{
+	return (unsigned)threads.size() + 1;
+}
+
+/**********************************************************************
+* Function:			workerLoop
+* Purpose: 			Body of one worker thread
+* Precondition:		Pass in the index of the worker's queue
+* Postcondition:	Runs jobs until the pool is stopped, sleeping whenever every queue is empty
+************************************************************************/
+void workPool::workerLoop(unsigned index)
+{
+	while (1)
+	{
+		if (runOne(index))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		wake.wait(lock, [this]() { return stopping || queued > 0; });
+		if (stopping)
+		{
+			return;
+		}
+	}
+}
+
+/**********************************************************************
+* Function:			runOne
+* Purpose: 			Runs one job, from a thread's own queue if it has any or else stolen from another
+* Precondition:		Pass in the index of the thread's queue
+* Postcondition:	Returns true if a job was run, false if every queue was empty
+************************************************************************/
+bool workPool::runOne(unsigned index)
+{
+	std::function<void()> job;
+	unsigned queueCount = (unsigned)queues.size();
+
+	for (unsigned offset = 0; offset < queueCount && !job; offset++)
+	{
+		workQueue &queue = *queues[(index + offset) % queueCount];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.jobs.empty())
+		{
+			continue;
+		}
+
+		//Own jobs from the back, stolen ones from the front
+		if (offset == 0)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+	}
+
+	if (!job)
+	{
+		return false;
+	}
+
+	queued--;
+	job();
+	return true;
+}
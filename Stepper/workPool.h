@@ -0,0 +1,71 @@
+/*************************************************************
+* Filename:			workPool.h
+* Purpose:			Spread a loop over every core with a work-stealing thread pool
+**************************************************************/
+#pragma once
+
+#include <stdint.h>				//int64_t
+#include <atomic>				//std::atomic
+#include <condition_variable>	//std::condition_variable
+#include <deque>				//std::deque
+#include <functional>			//std::function
+#include <memory>				//std::unique_ptr
+#include <mutex>				//std::mutex
+#include <thread>				//std::thread
+#include <vector>				//std::vector
+
+/************************************************************************
+* Struct: 		workQueue
+* Purpose:		Jobs waiting on one thread. The owner takes from the back, so it keeps working on the
+*				chunks it was handed in order of locality, other threads steal from the front.
+* Data members:	lock	- Guards jobs
+*				jobs	- Waiting jobs
+*************************************************************************/
+typedef struct workQueue
+{
+	std::mutex lock;
+	std::deque<std::function<void()>> jobs;
+} workQueue;
+
+/************************************************************************
+* Class: 		workPool
+* Purpose:		A fixed set of worker threads, each with its own queue. parallelFor() cuts a range into chunks,
+*				deals them out to the queues, and then works on them itself until all are done. A thread that
+*				runs out of its own jobs steals from the others, so uneven chunks still finish together.
+* Data members:	queues	- One per worker, plus the last one for the thread calling parallelFor()
+*				threads	- Workers
+*				queued	- Jobs in every queue, workers sleep while it is 0
+*				sleepLock	- Guards sleeping and waking
+*				wake	- Wakes workers when jobs are queued or the pool stops
+*				finished	- Wakes a parallelFor() caller when its last job is done
+*				stopping	- Set by the destructor
+*
+* Methods:		instance
+*				parallelFor
+*				getThreadCount
+*************************************************************************/
+class workPool
+{
+	public:
+		//0 threads uses one per core, the calling thread of parallelFor() always works too
+		workPool(unsigned threadCount = 0);
+		~workPool();
+
+		static workPool *instance();
+
+		//Runs body(begin, end) over [0, count) in chunks of about grain, returns once all have run
+		void parallelFor(int64_t count, int64_t grain, const std::function<void(int64_t begin, int64_t end)> &body);
+		unsigned getThreadCount();
+
+	private:
+		void workerLoop(unsigned index);
+		bool runOne(unsigned index);
+
+		std::vector<std::unique_ptr<workQueue>> queues;
+		std::vector<std::thread> threads;
+		std::atomic<int64_t> queued;
+		std::mutex sleepLock;
+		std::condition_variable wake;
+		std::condition_variable finished;
+		bool stopping;
+};